@@ -0,0 +1,104 @@
+//
+//  bla.cpp
+//  mandelbrot-explorer
+//
+//  Copyright (c) 2014 Sandstorm Software. All rights reserved.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "bla.h"
+
+void initBLATable(BLATable *table)
+{
+    memset(table, 0, sizeof(*table));
+}
+
+void freeBLATable(BLATable *table)
+{
+    delete [] table->storage;
+
+    initBLATable(table);
+}
+
+void buildBLATable(BLATable *table, const ReferenceOrbit *orbit, FloatExp dc_max, double epsilon)
+{
+    double      start = getSeconds();
+    unsigned    count = orbit->length > 2 ? orbit->length - 2 : 0;
+    size_t      needed = 0;
+
+    // level 0 has a step for n = 1 .. length - 2, each level above half as many
+    for(unsigned level_count=count; level_count; level_count/=2)
+    {
+        needed += level_count;
+    }
+
+    if(needed > table->capacity)
+    {
+        delete [] table->storage;
+
+        table->storage  = new BLAStep [needed];
+        table->capacity = needed;
+    }
+
+    table->levels = 0;
+
+    if(!count)
+    {
+        table->bytes    = 0;
+        table->elapsed  = getSeconds() - start;
+        return;
+    }
+
+    // single steps, Z_0 = 0 so n starts at 1
+    BLAStep *steps = table->storage;
+
+    for(unsigned i=0; i<count; i++)
+    {
+        double x = orbit->x[i + 1];
+        double y = orbit->y[i + 1];
+
+        steps[i].ax = 2.0 * x;
+        steps[i].ay = 2.0 * y;
+        steps[i].bx = 1.0;
+        steps[i].by = 0.0;
+        steps[i].r  = epsilon * sqrt(x*x + y*y);
+    }
+
+    table->steps[0] = steps;
+    table->count[0] = count;
+    table->levels   = 1;
+
+    // x then y is A = Ay Ax, B = Ay Bx + By, and d has to stay inside both
+    // radii, the radius of y is checked against Ax d + Bx dc
+    while(table->levels < kBLAMaxLevels && table->count[table->levels - 1] >= 2)
+    {
+        const BLAStep   *prev = table->steps[table->levels - 1];
+        unsigned        prev_count = table->count[table->levels - 1];
+        BLAStep         *next = table->steps[table->levels - 1] + prev_count;
+
+        for(unsigned i=0; i<prev_count/2; i++)
+        {
+            const BLAStep *x = &prev[2 * i];
+            const BLAStep *y = &prev[2 * i + 1];
+            double ax = sqrt(x->ax * x->ax + x->ay * x->ay);
+            double bx = sqrt(x->bx * x->bx + x->by * x->by);
+            double r  = ax > 0.0 ? (y->r - floatExpToDouble(floatExpMulDouble(dc_max, bx))) / ax : x->r;
+
+            next[i].ax = y->ax * x->ax - y->ay * x->ay;
+            next[i].ay = y->ax * x->ay + y->ay * x->ax;
+            next[i].bx = y->ax * x->bx - y->ay * x->by + y->bx;
+            next[i].by = y->ax * x->by + y->ay * x->bx + y->by;
+            next[i].r  = fmax(0.0, fmin(x->r, r));
+        }
+
+        table->steps[table->levels] = next;
+        table->count[table->levels] = prev_count / 2;
+        table->levels++;
+    }
+
+    table->bytes = (table->steps[table->levels - 1] + table->count[table->levels - 1] - table->storage) * sizeof(BLAStep);
+    table->elapsed = getSeconds() - start;
+}
@@ -0,0 +1,140 @@
+//
+//  bla.h
+//  mandelbrot-explorer
+//
+//  Copyright (c) 2014 Sandstorm Software. All rights reserved.
+//
+
+#ifndef mandelbrot_explorer_bla_h
+#define mandelbrot_explorer_bla_h
+
+#include "perturbation.h"
+#include "floatexp.h"
+
+// Bilinear approximation. While |d| is small against Z the d^2 term can be dropped
+// and a step is linear, d' = A d + B dc with A = 2Z and B = 1. Linear steps merge,
+// so level k of the table holds the step from n = 1 + j*2^k to n + 2^k and the
+// radius r that |d| has to be under for it to hold. A single step is good while
+// |d| < epsilon |Z|, merged radii also allow for the largest dc in the frame.
+// Level 0 is only there to build the others from, a single linear step saves nothing.
+#define kBLAMaxLevels           32
+#define kDefaultBLAEpsilon      0x1p-32
+
+typedef struct {
+    double      ax, ay;         // A, multiplies d
+    double      bx, by;         // B, multiplies dc
+    double      r;
+} BLAStep;
+
+typedef struct BLATable_t {
+    unsigned    levels;
+    unsigned    count[kBLAMaxLevels];
+    BLAStep     *steps[kBLAMaxLevels];
+    BLAStep     *storage;
+    size_t      capacity;       // steps allocated in storage
+    size_t      bytes;          // size of the steps in use
+    double      elapsed;        // seconds buildBLATable took
+} BLATable;
+
+void        initBLATable(BLATable *table);
+void        freeBLATable(BLATable *table);
+
+// dc_max is the largest |dc| of any pixel in the frame, a FloatExp as it is under
+// the double range past a zoom of 1e308
+void        buildBLATable(BLATable *table, const ReferenceOrbit *orbit, FloatExp dc_max, double epsilon);
+
+// Takes the largest valid steps from step n while it stays at or under limit,
+// returns the new n. Forced inline, the vector kernels call it from avx code.
+static inline __attribute__((always_inline)) unsigned skipBLA(const BLATable *table, double *dx, double *dy,
+                                                              double dcx, double dcy, unsigned n, unsigned limit,
+                                                              KernelStats *stats)
+{
+    while(n < limit)
+    {
+        unsigned    m = n - 1;
+        int         k = m ? __builtin_ctz(m) : kBLAMaxLevels;
+
+        if(k > (int)table->levels - 1)
+            k = table->levels - 1;
+
+        for(; k>=1; k--)
+        {
+            const BLAStep *step;
+
+            if((m >> k) >= table->count[k] || n + (1u << k) > limit)
+                continue;
+
+            step = &table->steps[k][m >> k];
+
+            if(*dx * *dx + *dy * *dy < step->r * step->r)
+            {
+                double x = step->ax * *dx - step->ay * *dy + step->bx * dcx - step->by * dcy;
+
+                *dy = step->ax * *dy + step->ay * *dx + step->bx * dcy + step->by * dcx;
+                *dx = x;
+                n += 1u << k;
+
+                stats->bla_steps++;
+                stats->bla_skipped += (1u << k) - 1;
+
+                break;
+            }
+        }
+
+        if(k < 1)
+            break;
+    }
+
+    return n;
+}
+
+// skipBLA for iteratePerturbationFloatExp, d and dc are FloatExp there
+static inline unsigned skipBLAFloatExp(const BLATable *table, FloatExp *dx, FloatExp *dy,
+                                       FloatExp dcx, FloatExp dcy, unsigned n, unsigned limit,
+                                       KernelStats *stats)
+{
+    while(n < limit)
+    {
+        unsigned    m = n - 1;
+        int         k = m ? __builtin_ctz(m) : kBLAMaxLevels;
+        FloatExp    mag = floatExpAdd(floatExpMul(*dx, *dx), floatExpMul(*dy, *dy));
+
+        if(k > (int)table->levels - 1)
+            k = table->levels - 1;
+
+        for(; k>=1; k--)
+        {
+            const BLAStep *step;
+
+            if((m >> k) >= table->count[k] || n + (1u << k) > limit)
+                continue;
+
+            step = &table->steps[k][m >> k];
+
+            FloatExp r = floatExpFromDouble(step->r);
+
+            if(floatExpCompare(mag, floatExpMul(r, r)) < 0)
+            {
+                FloatExp x = floatExpAdd(floatExpSub(floatExpMulDouble(*dx, step->ax), floatExpMulDouble(*dy, step->ay)),
+                                         floatExpSub(floatExpMulDouble(dcx, step->bx), floatExpMulDouble(dcy, step->by)));
+
+                *dy = floatExpAdd(floatExpAdd(floatExpMulDouble(*dy, step->ax), floatExpMulDouble(*dx, step->ay)),
+                                  floatExpAdd(floatExpMulDouble(dcy, step->bx), floatExpMulDouble(dcx, step->by)));
+                *dx = x;
+                n += 1u << k;
+
+                stats->bla_steps++;
+                stats->bla_skipped += (1u << k) - 1;
+
+                break;
+            }
+        }
+
+        if(k < 1)
+            break;
+    }
+
+    return n;
+}
+
+#endif
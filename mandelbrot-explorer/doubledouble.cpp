@@ -0,0 +1,581 @@
+//
+//  doubledouble.cpp
+//  mandelbrot-explorer
+//
+//  Copyright (c) 2014 Sandstorm Software. All rights reserved.
+//
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "doubledouble.h"
+#include "simd_kernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define USE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+// one step, z = z^2 + c, the vector loops do the same operations in the same order
+static inline __attribute__((always_inline)) void stepDoubleDouble(DoubleDouble *x, DoubleDouble *y,
+                                                                   DoubleDouble cx, DoubleDouble cy)
+{
+    DoubleDouble x2 = ddSquare(*x);
+    DoubleDouble y2 = ddSquare(*y);
+    DoubleDouble xy = ddMul(*x, *y);
+
+    xy.hi *= 2.0;
+    xy.lo *= 2.0;
+
+    *x = ddAdd(ddAdd(x2, ddNeg(y2)), cx);
+    *y = ddAdd(xy, cy);
+}
+
+static void iterateDoubleDoubleScalar(const KernelOptions *options, const double *cx, const double *cy,
+                                      const double *cx_lo, const double *cy_lo, unsigned count,
+                                      unsigned itermax, unsigned *pixels, KernelStats *stats)
+{
+    bool    check_period = options->flags & kKernelPeriodicityCheck;
+    double  epsilon = getPeriodicityEpsilon(options);
+    unsigned steps = 0;
+
+    for(unsigned i=0; i<count; i++)
+    {
+        bool            done = false;
+        bool            periodic = false;
+        unsigned        iteration;
+        unsigned        window = options->periodicity_interval, window_count = 0;
+        DoubleDouble    x, y, c_x, c_y;
+        DoubleDouble    saved_x = { 0.0, 0.0 }, saved_y = { 0.0, 0.0 };
+
+        if((options->flags & kKernelCardioidCheck) && inCardioidOrBulb(cx[i], cy[i]))
+        {
+            pixels[i] = 0;
+            stats->cardioid_skipped++;
+            continue;
+        }
+
+        c_x = makeDoubleDouble(cx[i], cx_lo[i]);
+        c_y = makeDoubleDouble(cy[i], cy_lo[i]);
+        x.hi = x.lo = 0.0;
+        y.hi = y.lo = 0.0;
+
+        for (iteration=1;!done && !periodic && iteration<itermax;iteration++)
+        {
+            if(isKernelCancelledAt(options, ++steps))
+                return;
+
+            stepDoubleDouble(&x, &y, c_x, c_y);
+
+            if (x.hi*x.hi+y.hi*y.hi>100.0)
+            {
+                done = true;
+            }
+            else if(check_period)
+            {
+                // Brent as in iterateDoubleScalar, with the low halves in the difference: the
+                // epsilon is far below ulp(hi) here, so the high halves alone only match exactly
+                if(fabs((x.hi - saved_x.hi) + (x.lo - saved_x.lo)) < epsilon &&
+                   fabs((y.hi - saved_y.hi) + (y.lo - saved_y.lo)) < epsilon)
+                {
+                    periodic = true;
+                    stats->periodic_pixels++;
+                    stats->periodicity_saved += itermax - 1 - iteration;
+                }
+                else if(++window_count == window)
+                {
+                    saved_x = x;
+                    saved_y = y;
+                    window_count = 0;
+                    window *= 2;
+                }
+            }
+        }
+
+        pixels[i] = done ? iteration : 0;
+    }
+}
+
+// Lanes are refilled as they finish the same way as the double kernels in
+// simd_kernel.cpp, the state just has a low half for z and c. Empty lanes are
+// masked out with live there too, z = 0 would pass the periodicity check.
+typedef struct {
+    unsigned        count;
+    unsigned        next;
+    unsigned        active;
+    unsigned        live;
+    unsigned        flags;
+    unsigned        itermax;
+    double          interval;
+    const double    *cx, *cy;
+    const double    *cx_lo, *cy_lo;
+    unsigned        *pixels;
+    KernelStats     *stats;
+} DDLaneFeed;
+
+typedef struct {
+    int     index[8];
+    double  x[8] __attribute__((aligned(64)));
+    double  x_lo[8] __attribute__((aligned(64)));
+    double  y[8] __attribute__((aligned(64)));
+    double  y_lo[8] __attribute__((aligned(64)));
+    double  cx[8] __attribute__((aligned(64)));
+    double  cx_lo[8] __attribute__((aligned(64)));
+    double  cy[8] __attribute__((aligned(64)));
+    double  cy_lo[8] __attribute__((aligned(64)));
+    double  n[8] __attribute__((aligned(64)));
+    double  sx[8] __attribute__((aligned(64)));
+    double  sx_lo[8] __attribute__((aligned(64)));
+    double  sy[8] __attribute__((aligned(64)));
+    double  sy_lo[8] __attribute__((aligned(64)));
+    double  wn[8] __attribute__((aligned(64)));
+    double  wl[8] __attribute__((aligned(64)));
+} DDLaneState;
+
+static inline __attribute__((always_inline)) void refillDDLane(DDLaneFeed *feed, DDLaneState *lanes, int lane)
+{
+    lanes->x[lane]      = 0.0;
+    lanes->x_lo[lane]   = 0.0;
+    lanes->y[lane]      = 0.0;
+    lanes->y_lo[lane]   = 0.0;
+    lanes->sx[lane]     = 0.0;
+    lanes->sx_lo[lane]  = 0.0;
+    lanes->sy[lane]     = 0.0;
+    lanes->sy_lo[lane]  = 0.0;
+    lanes->wn[lane]     = 0.0;
+    lanes->wl[lane]     = feed->interval;
+
+    while(feed->next < feed->count)
+    {
+        unsigned i = feed->next++;
+
+        if((feed->flags & kKernelCardioidCheck) && inCardioidOrBulb(feed->cx[i], feed->cy[i]))
+        {
+            feed->pixels[i] = 0;
+            feed->stats->cardioid_skipped++;
+            continue;
+        }
+
+        if(lanes->index[lane] < 0)
+        {
+            feed->active++;
+        }
+
+        DoubleDouble c_x = makeDoubleDouble(feed->cx[i], feed->cx_lo[i]);
+        DoubleDouble c_y = makeDoubleDouble(feed->cy[i], feed->cy_lo[i]);
+
+        lanes->index[lane]  = i;
+        lanes->cx[lane]     = c_x.hi;
+        lanes->cx_lo[lane]  = c_x.lo;
+        lanes->cy[lane]     = c_y.hi;
+        lanes->cy_lo[lane]  = c_y.lo;
+        lanes->n[lane]      = 0.0;
+        feed->live          |= 1 << lane;
+
+        return;
+    }
+
+    if(lanes->index[lane] >= 0)
+    {
+        feed->active--;
+    }
+
+    lanes->index[lane]  = -1;
+    lanes->cx[lane]     = 0.0;
+    lanes->cx_lo[lane]  = 0.0;
+    lanes->cy[lane]     = 0.0;
+    lanes->cy_lo[lane]  = 0.0;
+    lanes->n[lane]      = -INFINITY;
+    feed->live          &= ~(1 << lane);
+}
+
+static inline __attribute__((always_inline)) void retireDDLanes(DDLaneFeed *feed, DDLaneState *lanes, unsigned mask,
+                                                                unsigned escaped, unsigned periodic)
+{
+    while(mask)
+    {
+        int lane = __builtin_ctz(mask);
+        int index = lanes->index[lane];
+
+        mask &= mask - 1;
+
+        if(index >= 0)
+        {
+            if(escaped & (1 << lane))
+            {
+                feed->pixels[index] = (unsigned)lanes->n[lane] + 1;
+            }
+            else
+            {
+                feed->pixels[index] = 0;
+
+                if(periodic & (1 << lane))
+                {
+                    feed->stats->periodic_pixels++;
+                    feed->stats->periodicity_saved += feed->itermax - 1 - (unsigned)lanes->n[lane];
+                }
+            }
+        }
+
+        refillDDLane(feed, lanes, lane);
+    }
+}
+
+static void initDDLanes(DDLaneFeed *feed, DDLaneState *lanes, const KernelOptions *options,
+                        const double *cx, const double *cy, const double *cx_lo, const double *cy_lo,
+                        unsigned count, unsigned itermax, unsigned *pixels, KernelStats *stats, int width)
+{
+    feed->count     = count;
+    feed->next      = 0;
+    feed->active    = 0;
+    feed->live      = 0;
+    feed->flags     = options->flags;
+    feed->itermax   = itermax;
+    feed->interval  = options->periodicity_interval;
+    feed->cx        = cx;
+    feed->cy        = cy;
+    feed->cx_lo     = cx_lo;
+    feed->cy_lo     = cy_lo;
+    feed->pixels    = pixels;
+    feed->stats     = stats;
+
+    for(int lane=0; lane<width; lane++)
+    {
+        lanes->index[lane] = -1;
+        refillDDLane(feed, lanes, lane);
+    }
+}
+
+#ifdef USE_X86_SIMD
+// the helpers from doubledouble.h four and eight lanes wide
+#define AVX2_INLINE     static inline __attribute__((always_inline, target("avx2,fma")))
+#define AVX512_INLINE   static inline __attribute__((always_inline, target("avx512f")))
+
+AVX2_INLINE void quickTwoSum4(__m256d a, __m256d b, __m256d *hi, __m256d *lo)
+{
+    *hi = _mm256_add_pd(a, b);
+    *lo = _mm256_sub_pd(b, _mm256_sub_pd(*hi, a));
+}
+
+AVX2_INLINE void twoSum4(__m256d a, __m256d b, __m256d *hi, __m256d *lo)
+{
+    __m256d s  = _mm256_add_pd(a, b);
+    __m256d bb = _mm256_sub_pd(s, a);
+
+    *lo = _mm256_add_pd(_mm256_sub_pd(a, _mm256_sub_pd(s, bb)), _mm256_sub_pd(b, bb));
+    *hi = s;
+}
+
+AVX2_INLINE void ddAdd4(__m256d ahi, __m256d alo, __m256d bhi, __m256d blo, __m256d *hi, __m256d *lo)
+{
+    __m256d sh, sl, th, tl;
+
+    twoSum4(ahi, bhi, &sh, &sl);
+    twoSum4(alo, blo, &th, &tl);
+    quickTwoSum4(sh, _mm256_add_pd(sl, th), &sh, &sl);
+    quickTwoSum4(sh, _mm256_add_pd(sl, tl), hi, lo);
+}
+
+AVX2_INLINE void ddMul4(__m256d ahi, __m256d alo, __m256d bhi, __m256d blo, __m256d *hi, __m256d *lo)
+{
+    __m256d p = _mm256_mul_pd(ahi, bhi);
+    __m256d e = _mm256_fmsub_pd(ahi, bhi, p);
+    __m256d cross = _mm256_add_pd(_mm256_mul_pd(ahi, blo), _mm256_mul_pd(alo, bhi));
+
+    quickTwoSum4(p, _mm256_add_pd(e, cross), hi, lo);
+}
+
+AVX2_INLINE void ddSquare4(__m256d ahi, __m256d alo, __m256d *hi, __m256d *lo)
+{
+    __m256d p = _mm256_mul_pd(ahi, ahi);
+    __m256d e = _mm256_fmsub_pd(ahi, ahi, p);
+    __m256d cross = _mm256_mul_pd(_mm256_add_pd(ahi, ahi), alo);
+
+    quickTwoSum4(p, _mm256_add_pd(e, cross), hi, lo);
+}
+
+__attribute__((target("avx2,fma")))
+static void iterateDoubleDoubleAVX2(const KernelOptions *options, const double *cx, const double *cy,
+                                    const double *cx_lo, const double *cy_lo, unsigned count,
+                                    unsigned itermax, unsigned *pixels, KernelStats *stats)
+{
+    DDLaneFeed  feed;
+    DDLaneState lanes;
+    unsigned    steps = 0;
+    bool        check_period = options->flags & kKernelPeriodicityCheck;
+
+    initDDLanes(&feed, &lanes, options, cx, cy, cx_lo, cy_lo, count, itermax, pixels, stats, 4);
+
+    __m256d x       = _mm256_load_pd(lanes.x);
+    __m256d xl      = _mm256_load_pd(lanes.x_lo);
+    __m256d y       = _mm256_load_pd(lanes.y);
+    __m256d yl      = _mm256_load_pd(lanes.y_lo);
+    __m256d vcx     = _mm256_load_pd(lanes.cx);
+    __m256d vcxl    = _mm256_load_pd(lanes.cx_lo);
+    __m256d vcy     = _mm256_load_pd(lanes.cy);
+    __m256d vcyl    = _mm256_load_pd(lanes.cy_lo);
+    __m256d n       = _mm256_load_pd(lanes.n);
+    __m256d sx      = _mm256_load_pd(lanes.sx);
+    __m256d sxl     = _mm256_load_pd(lanes.sx_lo);
+    __m256d sy      = _mm256_load_pd(lanes.sy);
+    __m256d syl     = _mm256_load_pd(lanes.sy_lo);
+    __m256d wn      = _mm256_load_pd(lanes.wn);
+    __m256d wl      = _mm256_load_pd(lanes.wl);
+    __m256d one     = _mm256_set1_pd(1.0);
+    __m256d zero    = _mm256_setzero_pd();
+    __m256d bailout = _mm256_set1_pd(100.0);
+    __m256d limit   = _mm256_set1_pd((double)itermax - 1.0);
+    __m256d epsilon = _mm256_set1_pd(getPeriodicityEpsilon(options));
+    __m256d abs     = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+
+    while(feed.active)
+    {
+        if(isKernelCancelledAt(options, ++steps))
+            return;
+
+        // stepDoubleDouble
+        __m256d x2, x2l, y2, y2l, xy, xyl;
+
+        ddSquare4(x, xl, &x2, &x2l);
+        ddSquare4(y, yl, &y2, &y2l);
+        ddMul4(x, xl, y, yl, &xy, &xyl);
+
+        ddAdd4(x2, x2l, _mm256_sub_pd(zero, y2), _mm256_sub_pd(zero, y2l), &x2, &x2l);
+        ddAdd4(x2, x2l, vcx, vcxl, &x, &xl);
+        ddAdd4(_mm256_add_pd(xy, xy), _mm256_add_pd(xyl, xyl), vcy, vcyl, &y, &yl);
+        n = _mm256_add_pd(n, one);
+
+        __m256d mag     = _mm256_add_pd(_mm256_mul_pd(x, x), _mm256_mul_pd(y, y));
+        __m256d escaped = _mm256_cmp_pd(mag, bailout, _CMP_GT_OQ);
+        __m256d maxed   = _mm256_cmp_pd(n, limit, _CMP_GE_OQ);
+        __m256d periodic = _mm256_setzero_pd();
+
+        if(check_period)
+        {
+            // the full double-double difference, as in the scalar loop
+            __m256d dx = _mm256_and_pd(_mm256_add_pd(_mm256_sub_pd(x, sx), _mm256_sub_pd(xl, sxl)), abs);
+            __m256d dy = _mm256_and_pd(_mm256_add_pd(_mm256_sub_pd(y, sy), _mm256_sub_pd(yl, syl)), abs);
+
+            periodic = _mm256_and_pd(_mm256_cmp_pd(dx, epsilon, _CMP_LT_OQ), _mm256_cmp_pd(dy, epsilon, _CMP_LT_OQ));
+
+            wn = _mm256_add_pd(wn, one);
+
+            __m256d save = _mm256_cmp_pd(wn, wl, _CMP_GE_OQ);
+
+            sx = _mm256_blendv_pd(sx, x, save);
+            sxl = _mm256_blendv_pd(sxl, xl, save);
+            sy = _mm256_blendv_pd(sy, y, save);
+            syl = _mm256_blendv_pd(syl, yl, save);
+            wl = _mm256_add_pd(wl, _mm256_and_pd(save, wl));
+            wn = _mm256_andnot_pd(save, wn);
+        }
+
+        unsigned mask = _mm256_movemask_pd(_mm256_or_pd(_mm256_or_pd(escaped, maxed), periodic)) & feed.live;
+
+        if(mask)
+        {
+            _mm256_store_pd(lanes.x, x); _mm256_store_pd(lanes.x_lo, xl);
+            _mm256_store_pd(lanes.y, y); _mm256_store_pd(lanes.y_lo, yl);
+            _mm256_store_pd(lanes.cx, vcx); _mm256_store_pd(lanes.cx_lo, vcxl);
+            _mm256_store_pd(lanes.cy, vcy); _mm256_store_pd(lanes.cy_lo, vcyl);
+            _mm256_store_pd(lanes.n, n);
+            _mm256_store_pd(lanes.sx, sx); _mm256_store_pd(lanes.sx_lo, sxl);
+            _mm256_store_pd(lanes.sy, sy); _mm256_store_pd(lanes.sy_lo, syl);
+            _mm256_store_pd(lanes.wn, wn); _mm256_store_pd(lanes.wl, wl);
+
+            retireDDLanes(&feed, &lanes, mask, _mm256_movemask_pd(escaped), _mm256_movemask_pd(periodic));
+
+            x = _mm256_load_pd(lanes.x); xl = _mm256_load_pd(lanes.x_lo);
+            y = _mm256_load_pd(lanes.y); yl = _mm256_load_pd(lanes.y_lo);
+            vcx = _mm256_load_pd(lanes.cx); vcxl = _mm256_load_pd(lanes.cx_lo);
+            vcy = _mm256_load_pd(lanes.cy); vcyl = _mm256_load_pd(lanes.cy_lo);
+            n = _mm256_load_pd(lanes.n);
+            sx = _mm256_load_pd(lanes.sx); sxl = _mm256_load_pd(lanes.sx_lo);
+            sy = _mm256_load_pd(lanes.sy); syl = _mm256_load_pd(lanes.sy_lo);
+            wn = _mm256_load_pd(lanes.wn); wl = _mm256_load_pd(lanes.wl);
+        }
+    }
+}
+
+AVX512_INLINE void quickTwoSum8(__m512d a, __m512d b, __m512d *hi, __m512d *lo)
+{
+    *hi = _mm512_add_pd(a, b);
+    *lo = _mm512_sub_pd(b, _mm512_sub_pd(*hi, a));
+}
+
+AVX512_INLINE void twoSum8(__m512d a, __m512d b, __m512d *hi, __m512d *lo)
+{
+    __m512d s  = _mm512_add_pd(a, b);
+    __m512d bb = _mm512_sub_pd(s, a);
+
+    *lo = _mm512_add_pd(_mm512_sub_pd(a, _mm512_sub_pd(s, bb)), _mm512_sub_pd(b, bb));
+    *hi = s;
+}
+
+AVX512_INLINE void ddAdd8(__m512d ahi, __m512d alo, __m512d bhi, __m512d blo, __m512d *hi, __m512d *lo)
+{
+    __m512d sh, sl, th, tl;
+
+    twoSum8(ahi, bhi, &sh, &sl);
+    twoSum8(alo, blo, &th, &tl);
+    quickTwoSum8(sh, _mm512_add_pd(sl, th), &sh, &sl);
+    quickTwoSum8(sh, _mm512_add_pd(sl, tl), hi, lo);
+}
+
+AVX512_INLINE void ddMul8(__m512d ahi, __m512d alo, __m512d bhi, __m512d blo, __m512d *hi, __m512d *lo)
+{
+    __m512d p = _mm512_mul_pd(ahi, bhi);
+    __m512d e = _mm512_fmsub_pd(ahi, bhi, p);
+    __m512d cross = _mm512_add_pd(_mm512_mul_pd(ahi, blo), _mm512_mul_pd(alo, bhi));
+
+    quickTwoSum8(p, _mm512_add_pd(e, cross), hi, lo);
+}
+
+AVX512_INLINE void ddSquare8(__m512d ahi, __m512d alo, __m512d *hi, __m512d *lo)
+{
+    __m512d p = _mm512_mul_pd(ahi, ahi);
+    __m512d e = _mm512_fmsub_pd(ahi, ahi, p);
+    __m512d cross = _mm512_mul_pd(_mm512_add_pd(ahi, ahi), alo);
+
+    quickTwoSum8(p, _mm512_add_pd(e, cross), hi, lo);
+}
+
+__attribute__((target("avx512f")))
+static void iterateDoubleDoubleAVX512(const KernelOptions *options, const double *cx, const double *cy,
+                                      const double *cx_lo, const double *cy_lo, unsigned count,
+                                      unsigned itermax, unsigned *pixels, KernelStats *stats)
+{
+    DDLaneFeed  feed;
+    DDLaneState lanes;
+    unsigned    steps = 0;
+    bool        check_period = options->flags & kKernelPeriodicityCheck;
+
+    initDDLanes(&feed, &lanes, options, cx, cy, cx_lo, cy_lo, count, itermax, pixels, stats, 8);
+
+    __m512d x       = _mm512_load_pd(lanes.x);
+    __m512d xl      = _mm512_load_pd(lanes.x_lo);
+    __m512d y       = _mm512_load_pd(lanes.y);
+    __m512d yl      = _mm512_load_pd(lanes.y_lo);
+    __m512d vcx     = _mm512_load_pd(lanes.cx);
+    __m512d vcxl    = _mm512_load_pd(lanes.cx_lo);
+    __m512d vcy     = _mm512_load_pd(lanes.cy);
+    __m512d vcyl    = _mm512_load_pd(lanes.cy_lo);
+    __m512d n       = _mm512_load_pd(lanes.n);
+    __m512d sx      = _mm512_load_pd(lanes.sx);
+    __m512d sxl     = _mm512_load_pd(lanes.sx_lo);
+    __m512d sy      = _mm512_load_pd(lanes.sy);
+    __m512d syl     = _mm512_load_pd(lanes.sy_lo);
+    __m512d wn      = _mm512_load_pd(lanes.wn);
+    __m512d wl      = _mm512_load_pd(lanes.wl);
+    __m512d one     = _mm512_set1_pd(1.0);
+    __m512d zero    = _mm512_setzero_pd();
+    __m512d bailout = _mm512_set1_pd(100.0);
+    __m512d limit   = _mm512_set1_pd((double)itermax - 1.0);
+    __m512d epsilon = _mm512_set1_pd(getPeriodicityEpsilon(options));
+
+    while(feed.active)
+    {
+        if(isKernelCancelledAt(options, ++steps))
+            return;
+
+        // stepDoubleDouble
+        __m512d x2, x2l, y2, y2l, xy, xyl;
+
+        ddSquare8(x, xl, &x2, &x2l);
+        ddSquare8(y, yl, &y2, &y2l);
+        ddMul8(x, xl, y, yl, &xy, &xyl);
+
+        ddAdd8(x2, x2l, _mm512_sub_pd(zero, y2), _mm512_sub_pd(zero, y2l), &x2, &x2l);
+        ddAdd8(x2, x2l, vcx, vcxl, &x, &xl);
+        ddAdd8(_mm512_add_pd(xy, xy), _mm512_add_pd(xyl, xyl), vcy, vcyl, &y, &yl);
+        n = _mm512_add_pd(n, one);
+
+        __m512d     mag      = _mm512_add_pd(_mm512_mul_pd(x, x), _mm512_mul_pd(y, y));
+        __mmask8    escaped  = _mm512_cmp_pd_mask(mag, bailout, _CMP_GT_OQ);
+        __mmask8    maxed    = _mm512_cmp_pd_mask(n, limit, _CMP_GE_OQ);
+        __mmask8    periodic = 0;
+
+        if(check_period)
+        {
+            // the full double-double difference, as in the scalar loop
+            __m512d dx = _mm512_abs_pd(_mm512_add_pd(_mm512_sub_pd(x, sx), _mm512_sub_pd(xl, sxl)));
+            __m512d dy = _mm512_abs_pd(_mm512_add_pd(_mm512_sub_pd(y, sy), _mm512_sub_pd(yl, syl)));
+
+            periodic = _mm512_cmp_pd_mask(dx, epsilon, _CMP_LT_OQ) & _mm512_cmp_pd_mask(dy, epsilon, _CMP_LT_OQ);
+
+            wn = _mm512_add_pd(wn, one);
+
+            __mmask8 save = _mm512_cmp_pd_mask(wn, wl, _CMP_GE_OQ);
+
+            sx = _mm512_mask_blend_pd(save, sx, x);
+            sxl = _mm512_mask_blend_pd(save, sxl, xl);
+            sy = _mm512_mask_blend_pd(save, sy, y);
+            syl = _mm512_mask_blend_pd(save, syl, yl);
+            wl = _mm512_mask_add_pd(wl, save, wl, wl);
+            wn = _mm512_mask_blend_pd(save, wn, zero);
+        }
+
+        unsigned mask = (escaped | maxed | periodic) & feed.live;
+
+        if(mask)
+        {
+            _mm512_store_pd(lanes.x, x); _mm512_store_pd(lanes.x_lo, xl);
+            _mm512_store_pd(lanes.y, y); _mm512_store_pd(lanes.y_lo, yl);
+            _mm512_store_pd(lanes.cx, vcx); _mm512_store_pd(lanes.cx_lo, vcxl);
+            _mm512_store_pd(lanes.cy, vcy); _mm512_store_pd(lanes.cy_lo, vcyl);
+            _mm512_store_pd(lanes.n, n);
+            _mm512_store_pd(lanes.sx, sx); _mm512_store_pd(lanes.sx_lo, sxl);
+            _mm512_store_pd(lanes.sy, sy); _mm512_store_pd(lanes.sy_lo, syl);
+            _mm512_store_pd(lanes.wn, wn); _mm512_store_pd(lanes.wl, wl);
+
+            retireDDLanes(&feed, &lanes, mask, escaped, periodic);
+
+            x = _mm512_load_pd(lanes.x); xl = _mm512_load_pd(lanes.x_lo);
+            y = _mm512_load_pd(lanes.y); yl = _mm512_load_pd(lanes.y_lo);
+            vcx = _mm512_load_pd(lanes.cx); vcxl = _mm512_load_pd(lanes.cx_lo);
+            vcy = _mm512_load_pd(lanes.cy); vcyl = _mm512_load_pd(lanes.cy_lo);
+            n = _mm512_load_pd(lanes.n);
+            sx = _mm512_load_pd(lanes.sx); sxl = _mm512_load_pd(lanes.sx_lo);
+            sy = _mm512_load_pd(lanes.sy); syl = _mm512_load_pd(lanes.sy_lo);
+            wn = _mm512_load_pd(lanes.wn); wl = _mm512_load_pd(lanes.wl);
+        }
+    }
+}
+#endif // #ifdef USE_X86_SIMD
+
+void iterateDoubleDoubleLevel(unsigned level, const KernelOptions *options, const double *cx, const double *cy,
+                              const double *cx_lo, const double *cy_lo, unsigned count,
+                              unsigned itermax, unsigned *pixels, KernelStats *stats)
+{
+    // the vector loops count steps, so they need at least one to take
+    if(itermax < 2)
+    {
+        level = kSIMDLevelScalar;
+    }
+
+    switch(level)
+    {
+#ifdef USE_X86_SIMD
+        case kSIMDLevelAVX512:
+            iterateDoubleDoubleAVX512(options, cx, cy, cx_lo, cy_lo, count, itermax, pixels, stats);
+            break;
+
+        case kSIMDLevelAVX2:
+            iterateDoubleDoubleAVX2(options, cx, cy, cx_lo, cy_lo, count, itermax, pixels, stats);
+            break;
+#endif
+        // sse2 has no fma for the products, it takes the scalar loop
+        default:
+            iterateDoubleDoubleScalar(options, cx, cy, cx_lo, cy_lo, count, itermax, pixels, stats);
+            break;
+    }
+}
+
+void iterateDoubleDouble(const KernelOptions *options, const double *cx, const double *cy,
+                         const double *cx_lo, const double *cy_lo, unsigned count,
+                         unsigned itermax, unsigned *pixels, KernelStats *stats)
+{
+    iterateDoubleDoubleLevel(getSIMDLevel(), options, cx, cy, cx_lo, cy_lo, count, itermax, pixels, stats);
+}
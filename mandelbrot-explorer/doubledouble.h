@@ -0,0 +1,129 @@
+//
+//  doubledouble.h
+//  mandelbrot-explorer
+//
+//  Copyright (c) 2014 Sandstorm Software. All rights reserved.
+//
+
+#ifndef mandelbrot_explorer_doubledouble_h
+#define mandelbrot_explorer_doubledouble_h
+
+#include <math.h>
+
+#include "mandelbrot.h"
+
+// An unevaluated sum hi + lo of two doubles with |lo| <= ulp(hi)/2, about 106
+// bits of mantissa. Sums and products are built from the error free transforms
+// below, which give the rounding error of a double sum or product exactly.
+// Zooms up to about 1e28 at screen width fit, see kDoubleDoubleBits.
+typedef struct {
+    double      hi, lo;
+} DoubleDouble;
+
+// mantissa bits a double-double holds, frames that need more (getPrecisionBits) pixelate
+#define kDoubleDoubleBits       104
+
+// s + e = a + b exactly, for |a| >= |b|
+static inline DoubleDouble quickTwoSum(double a, double b)
+{
+    DoubleDouble r;
+
+    r.hi = a + b;
+    r.lo = b - (r.hi - a);
+
+    return r;
+}
+
+// s + e = a + b exactly
+static inline DoubleDouble twoSum(double a, double b)
+{
+    DoubleDouble    r;
+    double          bb;
+
+    r.hi = a + b;
+    bb   = r.hi - a;
+    r.lo = (a - (r.hi - bb)) + (b - bb);
+
+    return r;
+}
+
+// p + e = a * b exactly. Without a hardware fma the halves are multiplied out
+// after Dekker's split, the vector kernels always have one.
+static inline DoubleDouble twoProd(double a, double b)
+{
+    DoubleDouble r;
+
+    r.hi = a * b;
+#ifdef FP_FAST_FMA
+    r.lo = fma(a, b, -r.hi);
+#else
+    double t  = 134217729.0 * a;
+    double ah = t - (t - a);
+    double al = a - ah;
+
+    t = 134217729.0 * b;
+
+    double bh = t - (t - b);
+    double bl = b - bh;
+
+    r.lo = ((ah * bh - r.hi) + ah * bl + al * bh) + al * bl;
+#endif
+
+    return r;
+}
+
+static inline DoubleDouble makeDoubleDouble(double hi, double lo)
+{
+    return quickTwoSum(hi, lo);
+}
+
+static inline DoubleDouble ddNeg(DoubleDouble a)
+{
+    a.hi = -a.hi;
+    a.lo = -a.lo;
+
+    return a;
+}
+
+// the careful sum, x*x - y*y cancels and the quick one loses the low half there
+static inline DoubleDouble ddAdd(DoubleDouble a, DoubleDouble b)
+{
+    DoubleDouble s = twoSum(a.hi, b.hi);
+    DoubleDouble t = twoSum(a.lo, b.lo);
+
+    s = quickTwoSum(s.hi, s.lo + t.hi);
+
+    return quickTwoSum(s.hi, s.lo + t.lo);
+}
+
+static inline DoubleDouble ddAddDouble(DoubleDouble a, double b)
+{
+    DoubleDouble s = twoSum(a.hi, b);
+
+    return quickTwoSum(s.hi, s.lo + a.lo);
+}
+
+static inline DoubleDouble ddMul(DoubleDouble a, DoubleDouble b)
+{
+    DoubleDouble p = twoProd(a.hi, b.hi);
+
+    return quickTwoSum(p.hi, p.lo + (a.hi * b.lo + a.lo * b.hi));
+}
+
+static inline DoubleDouble ddSquare(DoubleDouble a)
+{
+    DoubleDouble p = twoProd(a.hi, a.hi);
+
+    return quickTwoSum(p.hi, p.lo + 2.0 * a.hi * a.lo);
+}
+
+// iterates c = (cx[i] + cx_lo[i], cy[i] + cy_lo[i]) for count points in double-double,
+// same values as iterateDouble otherwise
+void        iterateDoubleDouble(const KernelOptions *options, const double *cx, const double *cy,
+                                const double *cx_lo, const double *cy_lo, unsigned count,
+                                unsigned itermax, unsigned *pixels, KernelStats *stats);
+void        iterateDoubleDoubleLevel(unsigned level, const KernelOptions *options, const double *cx, const double *cy,
+                                     const double *cx_lo, const double *cy_lo, unsigned count,
+                                     unsigned itermax, unsigned *pixels, KernelStats *stats);
+
+#endif
@@ -0,0 +1,400 @@
+//
+//  fixedpoint.cpp
+//  mandelbrot-explorer
+//
+//  Copyright (c) 2014 Sandstorm Software. All rights reserved.
+//
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "gmp.h"
+
+#include "fixedpoint.h"
+#include "perturbation.h"
+
+// From this many limbs the products go to gmp's mpn routines, which have
+// assembly for every cpu, under it the inline loops win on call overhead.
+#define kFixedPointMPNLimbs     4
+
+// limb[0] is the least significant, the top limb holds the integer bits and the sign
+template<unsigned N> struct FixedPoint {
+    uint64_t    limb[N];
+};
+
+#define kFixedPointFractionBits(n)  (64 * (n) - kFixedPointIntegerBits)
+
+template<unsigned N> static inline bool fixedIsNegative(const FixedPoint<N> &a)
+{
+    return a.limb[N-1] >> 63;
+}
+
+template<unsigned N> static inline FixedPoint<N> fixedAdd(const FixedPoint<N> &a, const FixedPoint<N> &b)
+{
+    FixedPoint<N>   r;
+    uint64_t        carry = 0;
+
+    for(unsigned i=0; i<N; i++)
+    {
+        uint64_t s = a.limb[i] + b.limb[i];
+        uint64_t t = s + carry;
+
+        carry       = (s < a.limb[i]) | (t < s);
+        r.limb[i]   = t;
+    }
+
+    return r;
+}
+
+template<unsigned N> static inline FixedPoint<N> fixedSub(const FixedPoint<N> &a, const FixedPoint<N> &b)
+{
+    FixedPoint<N>   r;
+    uint64_t        borrow = 0;
+
+    for(unsigned i=0; i<N; i++)
+    {
+        uint64_t s = a.limb[i] - b.limb[i];
+        uint64_t t = s - borrow;
+
+        borrow      = (a.limb[i] < b.limb[i]) | (s < borrow);
+        r.limb[i]   = t;
+    }
+
+    return r;
+}
+
+template<unsigned N> static inline FixedPoint<N> fixedNeg(const FixedPoint<N> &a)
+{
+    FixedPoint<N>   r;
+    uint64_t        carry = 1;
+
+    for(unsigned i=0; i<N; i++)
+    {
+        r.limb[i]   = ~a.limb[i] + carry;
+        carry       = carry && !r.limb[i];
+    }
+
+    return r;
+}
+
+template<unsigned N> static inline FixedPoint<N> fixedAbs(const FixedPoint<N> &a)
+{
+    return fixedIsNegative(a) ? fixedNeg(a) : a;
+}
+
+// a * 2
+template<unsigned N> static inline FixedPoint<N> fixedShiftLeft(const FixedPoint<N> &a)
+{
+    FixedPoint<N> r;
+
+    for(unsigned i=N-1; i>0; i--)
+    {
+        r.limb[i] = (a.limb[i] << 1) | (a.limb[i-1] >> 63);
+    }
+
+    r.limb[0] = a.limb[0] << 1;
+
+    return r;
+}
+
+// the top N limbs of a 2N limb product, shifted back to the binary point
+template<unsigned N> static inline FixedPoint<N> fixedTruncate(const uint64_t *product)
+{
+    FixedPoint<N> r;
+
+    for(unsigned i=0; i<N; i++)
+    {
+        r.limb[i] = (product[i+N-1] >> (64 - kFixedPointIntegerBits)) | (product[i+N] << kFixedPointIntegerBits);
+    }
+
+    return r;
+}
+
+// products are of the magnitudes, the sign goes back on at the end
+template<unsigned N> static inline FixedPoint<N> fixedMul(const FixedPoint<N> &a, const FixedPoint<N> &b)
+{
+    FixedPoint<N>   ua = fixedAbs(a);
+    FixedPoint<N>   ub = fixedAbs(b);
+    uint64_t        product[2*N];
+
+    if(N >= kFixedPointMPNLimbs && sizeof(mp_limb_t) == sizeof(uint64_t))
+    {
+        mpn_mul_n((mp_limb_t *)product, (const mp_limb_t *)ua.limb, (const mp_limb_t *)ub.limb, N);
+
+        FixedPoint<N> r = fixedTruncate<N>(product);
+
+        return fixedIsNegative(a) != fixedIsNegative(b) ? fixedNeg(r) : r;
+    }
+
+    memset(product, 0, sizeof(product));
+
+    for(unsigned i=0; i<N; i++)
+    {
+        uint64_t carry = 0;
+
+        for(unsigned j=0; j<N; j++)
+        {
+            unsigned __int128 t = (unsigned __int128)ua.limb[i] * ub.limb[j] + product[i+j] + carry;
+
+            product[i+j]    = (uint64_t)t;
+            carry           = (uint64_t)(t >> 64);
+        }
+
+        product[i+N] = carry;
+    }
+
+    FixedPoint<N> r = fixedTruncate<N>(product);
+
+    return fixedIsNegative(a) != fixedIsNegative(b) ? fixedNeg(r) : r;
+}
+
+// the cross products a_i a_j appear twice, they are summed once and doubled
+template<unsigned N> static inline FixedPoint<N> fixedSquare(const FixedPoint<N> &a)
+{
+    FixedPoint<N>   ua = fixedAbs(a);
+    uint64_t        product[2*N];
+    uint64_t        carry;
+
+    if(N >= kFixedPointMPNLimbs && sizeof(mp_limb_t) == sizeof(uint64_t))
+    {
+        mpn_sqr((mp_limb_t *)product, (const mp_limb_t *)ua.limb, N);
+
+        return fixedTruncate<N>(product);
+    }
+
+    memset(product, 0, sizeof(product));
+
+    for(unsigned i=0; i<N; i++)
+    {
+        carry = 0;
+
+        for(unsigned j=i+1; j<N; j++)
+        {
+            unsigned __int128 t = (unsigned __int128)ua.limb[i] * ua.limb[j] + product[i+j] + carry;
+
+            product[i+j]    = (uint64_t)t;
+            carry           = (uint64_t)(t >> 64);
+        }
+
+        product[i+N] = carry;
+    }
+
+    for(unsigned i=2*N-1; i>0; i--)
+    {
+        product[i] = (product[i] << 1) | (product[i-1] >> 63);
+    }
+
+    product[0] <<= 1;
+    carry = 0;
+
+    for(unsigned i=0; i<N; i++)
+    {
+        unsigned __int128 t = (unsigned __int128)ua.limb[i] * ua.limb[i] + product[2*i] + carry;
+
+        product[2*i]    = (uint64_t)t;
+        t               = (t >> 64) + product[2*i+1];
+        product[2*i+1]  = (uint64_t)t;
+        carry           = (uint64_t)(t >> 64);
+    }
+
+    return fixedTruncate<N>(product);
+}
+
+// exact for any double the format can hold, bits under the last limb are dropped
+template<unsigned N> static inline FixedPoint<N> fixedFromDouble(double d)
+{
+    FixedPoint<N>   r;
+    int             exponent;
+    uint64_t        mantissa = (uint64_t)ldexp(frexp(fabs(d), &exponent), 53);
+    int             shift = exponent - 53 + kFixedPointFractionBits(N);
+
+    memset(&r, 0, sizeof(r));
+
+    if(mantissa && shift > -64)
+    {
+        if(shift < 0)
+        {
+            r.limb[0] = mantissa >> -shift;
+        }
+        else
+        {
+            unsigned limb = shift / 64, bit = shift % 64;
+
+            if(limb >= N)
+                return r;
+
+            r.limb[limb] = mantissa << bit;
+
+            if(bit && limb + 1 < N)
+                r.limb[limb+1] = mantissa >> (64 - bit);
+        }
+    }
+
+    return d < 0.0 ? fixedNeg(r) : r;
+}
+
+// |a| < b for b >= 0, compared a limb at a time from the top
+template<unsigned N> static inline bool fixedAbsLess(const FixedPoint<N> &a, const FixedPoint<N> &b)
+{
+    FixedPoint<N> ua = fixedAbs(a);
+
+    for(unsigned i=N; i>0; i--)
+    {
+        if(ua.limb[i-1] != b.limb[i-1])
+            return ua.limb[i-1] < b.limb[i-1];
+    }
+
+    return false;
+}
+
+// Only the integer part and the top fraction bits, enough for the bailout. It
+// is read straight off the top limb so it costs no normalization.
+template<unsigned N> static inline double fixedTop(const FixedPoint<N> &a)
+{
+    return (double)(int64_t)a.limb[N-1] * (1.0 / (1ull << (64 - kFixedPointIntegerBits)));
+}
+
+// calcPixelBigNUM with three multiplies a step, x^2 and y^2 are the squares the
+// bailout test needs and are reused by the next step
+template<unsigned N> static unsigned iterateFixedPoint(const FixedPointCenter *center, const KernelOptions *options,
+                                                       double offset_x, double offset_y, unsigned itermax,
+                                                       KernelStats *stats)
+{
+    FixedPoint<N>   cx, cy;
+
+    memcpy(cx.limb, center->x, sizeof(cx.limb));
+    memcpy(cy.limb, center->y, sizeof(cy.limb));
+
+    cx = fixedAdd(cx, fixedFromDouble<N>(offset_x));
+    cy = fixedAdd(cy, fixedFromDouble<N>(offset_y));
+
+    FixedPoint<N>   x, y, xx, yy;
+    FixedPoint<N>   saved_x, saved_y;
+    FixedPoint<N>   epsilon = fixedFromDouble<N>(getPeriodicityEpsilon(options));
+    unsigned        window = options->periodicity_interval, window_count = 0;
+
+    memset(&x, 0, sizeof(x));
+    memset(&y, 0, sizeof(y));
+
+    xx = saved_x = x;
+    yy = saved_y = y;
+
+    for(unsigned n=1; n<itermax; n++)
+    {
+        if(isKernelCancelledAt(options, n))
+            return 0;
+
+        // y = 2.0*x*y+cy; x = x*x-y*y+cx;
+        y = fixedAdd(fixedShiftLeft(fixedMul(x, y)), cy);
+        x = fixedAdd(fixedSub(xx, yy), cx);
+
+        xx = fixedSquare(x);
+        yy = fixedSquare(y);
+
+        if(fixedTop(xx) + fixedTop(yy) > 100.0)
+            return n + 1;
+
+        if(options->flags & kKernelPeriodicityCheck)
+        {
+            if(fixedAbsLess(fixedSub(x, saved_x), epsilon) && fixedAbsLess(fixedSub(y, saved_y), epsilon))
+            {
+                stats->periodic_pixels++;
+                stats->periodicity_saved += itermax - 1 - n;
+
+                return 0;
+            }
+
+            if(++window_count == window)
+            {
+                saved_x         = x;
+                saved_y         = y;
+                window_count    = 0;
+                window          *= 2;
+            }
+        }
+    }
+
+    return 0;
+}
+
+typedef unsigned (*FixedPointLoop)(const FixedPointCenter *center, const KernelOptions *options,
+                                   double offset_x, double offset_y, unsigned itermax, KernelStats *stats);
+
+static const FixedPointLoop kFixedPointLoops[kFixedPointMaxLimbs + 1] = {
+    NULL, NULL,
+    iterateFixedPoint<2>, iterateFixedPoint<3>, iterateFixedPoint<4>, iterateFixedPoint<5>,
+    iterateFixedPoint<6>, iterateFixedPoint<7>, iterateFixedPoint<8>, iterateFixedPoint<9>,
+    iterateFixedPoint<10>, iterateFixedPoint<11>, iterateFixedPoint<12>, iterateFixedPoint<13>,
+    iterateFixedPoint<14>, iterateFixedPoint<15>, iterateFixedPoint<16>,
+};
+
+unsigned getFixedPointLimbs(unsigned bits)
+{
+    unsigned limbs = (bits + kFixedPointIntegerBits + 63) / 64;
+
+    if(limbs < kFixedPointMinLimbs)
+        limbs = kFixedPointMinLimbs;
+
+    return limbs <= kFixedPointMaxLimbs ? limbs : 0;
+}
+
+// the magnitude scaled to the binary point and truncated, then negated in two's complement
+static void getFixedPointLimbs(uint64_t *limbs, unsigned count, mpf_srcptr value)
+{
+    mpf_t   scaled;
+    mpz_t   integer;
+    size_t  written = 0;
+
+    mpf_init2(scaled, mpf_get_prec(value) + 64);
+    mpz_init(integer);
+
+    mpf_mul_2exp(scaled, value, kFixedPointFractionBits(count));
+    mpz_set_f(integer, scaled);
+
+    memset(limbs, 0, kFixedPointMaxLimbs * sizeof(*limbs));
+
+    if(mpz_sizeinbase(integer, 2) < 64 * count)
+    {
+        mpz_export(limbs, &written, -1, sizeof(*limbs), 0, 0, integer);
+    }
+
+    if(mpz_sgn(integer) < 0)
+    {
+        uint64_t carry = 1;
+
+        for(unsigned i=0; i<count; i++)
+        {
+            limbs[i]    = ~limbs[i] + carry;
+            carry       = carry && !limbs[i];
+        }
+    }
+
+    mpz_clear(integer);
+    mpf_clear(scaled);
+}
+
+void setFixedPointCenter(FixedPointCenter *center, unsigned limbs, mpf_srcptr x, mpf_srcptr y)
+{
+    center->limbs   = limbs;
+    center->x_d     = mpf_get_d(x);
+    center->y_d     = mpf_get_d(y);
+
+    getFixedPointLimbs(center->x, limbs, x);
+    getFixedPointLimbs(center->y, limbs, y);
+}
+
+unsigned calcPixelFixedPoint(const FixedPointCenter *center, const KernelOptions *options,
+                             double offset_x, double offset_y, unsigned itermax, KernelStats *stats)
+{
+    // these frames are mostly past where the rounded center can place the boundary
+    if((options->flags & kKernelCardioidCheck) &&
+       isCardioidTestExact(options->pixel_spacing, center->x_d, center->y_d) &&
+       inCardioidOrBulb(center->x_d + offset_x, center->y_d + offset_y))
+    {
+        stats->cardioid_skipped++;
+        return 0;
+    }
+
+    return kFixedPointLoops[center->limbs](center, options, offset_x, offset_y, itermax, stats);
+}
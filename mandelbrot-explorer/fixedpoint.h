@@ -0,0 +1,43 @@
+//
+//  fixedpoint.h
+//  mandelbrot-explorer
+//
+//  Copyright (c) 2014 Sandstorm Software. All rights reserved.
+//
+
+#ifndef mandelbrot_explorer_fixedpoint_h
+#define mandelbrot_explorer_fixedpoint_h
+
+#include <stdint.h>
+
+#include "gmp.h"
+
+#include "mandelbrot.h"
+
+// Bignum iteration in two's complement fixed point, limbs 64 bit words with
+// kFixedPointIntegerBits of them in front of the binary point. Every count from
+// kFixedPointMinLimbs to kFixedPointMaxLimbs has its own loop so the numbers
+// live on the stack and the limb loops unroll.
+#define kFixedPointMinLimbs     2
+#define kFixedPointMaxLimbs     16
+#define kFixedPointIntegerBits  16
+
+// the frame center converted once, so the pixels only add their offset to it
+typedef struct {
+    unsigned    limbs;
+    uint64_t    x[kFixedPointMaxLimbs];
+    uint64_t    y[kFixedPointMaxLimbs];
+    double      x_d, y_d;                   // rounded, the cardioid test is only run while
+                                            // that is well under a pixel, see isCardioidTestExact
+} FixedPointCenter;
+
+// fewest limbs that hold bits from getPrecisionBits, 0 when it takes more than kFixedPointMaxLimbs
+unsigned    getFixedPointLimbs(unsigned bits);
+void        setFixedPointCenter(FixedPointCenter *center, unsigned limbs, mpf_srcptr x, mpf_srcptr y);
+
+// Same value as calcPixelBigNUM for c = center + offset, offset being the pixel's
+// 3.0*(hx/xres-0.5)/zoom
+unsigned    calcPixelFixedPoint(const FixedPointCenter *center, const KernelOptions *options,
+                                double offset_x, double offset_y, unsigned itermax, KernelStats *stats);
+
+#endif
@@ -0,0 +1,169 @@
+//
+//  floatexp.h
+//  mandelbrot-explorer
+//
+//  Copyright (c) 2014 Sandstorm Software. All rights reserved.
+//
+
+#ifndef mandelbrot_explorer_floatexp_h
+#define mandelbrot_explorer_floatexp_h
+
+#include <stdint.h>
+#include <string.h>
+
+// A double mantissa with its own int exponent, value = m * 2^e. Past a zoom of
+// about 1e300 pixel offsets go denormal and then to 0 as plain doubles, the
+// separate exponent keeps the full 53 bits at any depth. Values are kept
+// normalized with 1 <= |m| < 2, zero is m = 0 with e = kFloatExpZeroExponent.
+typedef struct {
+    double      m;
+    int         e;
+} FloatExp;
+
+#define kFloatExpZeroExponent   (-0x3fffffff)
+
+// Offsets further apart than this in exponent do not change each other in a sum
+#define kFloatExpAddRange       64
+
+static inline uint64_t getDoubleBits(double d)
+{
+    uint64_t bits;
+
+    memcpy(&bits, &d, sizeof(bits));
+
+    return bits;
+}
+
+static inline double makeDouble(uint64_t bits)
+{
+    double d;
+
+    memcpy(&d, &bits, sizeof(d));
+
+    return d;
+}
+
+// 2^e for e in the normal double range
+static inline double getPowerOfTwo(int e)
+{
+    return makeDouble((uint64_t)(e + 1023) << 52);
+}
+
+// m * 2^e as a FloatExp, m can be any finite double
+static inline FloatExp makeFloatExp(double m, int e)
+{
+    FloatExp    r;
+    uint64_t    bits = getDoubleBits(m);
+    int         exponent = (int)((bits >> 52) & 0x7ff);
+
+    if(m == 0.0)
+    {
+        r.m = 0.0;
+        r.e = kFloatExpZeroExponent;
+        return r;
+    }
+
+    // denormal, scale it into the normal range first
+    if(!exponent)
+    {
+        bits = getDoubleBits(m * 0x1p54);
+        exponent = (int)((bits >> 52) & 0x7ff) - 54;
+    }
+
+    r.m = makeDouble((bits & ~(0x7ffull << 52)) | (1023ull << 52));
+    r.e = e + exponent - 1023;
+
+    return r;
+}
+
+static inline FloatExp floatExpFromDouble(double d)
+{
+    return makeFloatExp(d, 0);
+}
+
+static inline double floatExpToDouble(FloatExp a)
+{
+    if(a.e > 1023)
+        return a.m * 0x1p1023 * getPowerOfTwo(a.e - 1023 > 1023 ? 1023 : a.e - 1023);
+
+    if(a.e < -1022)
+    {
+        // denormal or 0 as a double
+        if(a.e < -1022 - 54)
+            return 0.0;
+
+        return a.m * getPowerOfTwo(a.e + 54) * 0x1p-54;
+    }
+
+    return a.m * getPowerOfTwo(a.e);
+}
+
+static inline FloatExp floatExpNeg(FloatExp a)
+{
+    a.m = -a.m;
+
+    return a;
+}
+
+// a * 2^k
+static inline FloatExp floatExpScale(FloatExp a, int k)
+{
+    if(a.m != 0.0)
+        a.e += k;
+
+    return a;
+}
+
+static inline FloatExp floatExpMul(FloatExp a, FloatExp b)
+{
+    return makeFloatExp(a.m * b.m, a.e + b.e);
+}
+
+// a * d for a plain double d
+static inline FloatExp floatExpMulDouble(FloatExp a, double d)
+{
+    return makeFloatExp(a.m * d, a.e);
+}
+
+static inline FloatExp floatExpAdd(FloatExp a, FloatExp b)
+{
+    int shift = a.e - b.e;
+
+    if(b.m == 0.0 || shift > kFloatExpAddRange)
+        return a;
+
+    if(a.m == 0.0 || shift < -kFloatExpAddRange)
+        return b;
+
+    // line the smaller one up with the larger, the shift is well inside the double range
+    if(shift >= 0)
+        return makeFloatExp(a.m + b.m * getPowerOfTwo(-shift), a.e);
+
+    return makeFloatExp(a.m * getPowerOfTwo(shift) + b.m, b.e);
+}
+
+static inline FloatExp floatExpSub(FloatExp a, FloatExp b)
+{
+    return floatExpAdd(a, floatExpNeg(b));
+}
+
+// -1, 0 or 1 as a is less than, equal to or greater than b
+static inline int floatExpCompare(FloatExp a, FloatExp b)
+{
+    int sign_a = (a.m > 0.0) - (a.m < 0.0);
+    int sign_b = (b.m > 0.0) - (b.m < 0.0);
+
+    if(sign_a != sign_b)
+        return sign_a < sign_b ? -1 : 1;
+
+    if(!sign_a)
+        return 0;
+
+    // same sign, a larger exponent means a larger magnitude
+    if(a.e != b.e)
+        return (a.e > b.e) == (sign_a > 0) ? 1 : -1;
+
+    return (a.m > b.m) - (a.m < b.m);
+}
+
+#endif
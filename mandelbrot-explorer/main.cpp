@@ -8,6 +8,19 @@
 
 #include <iostream>
 #include <pthread.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#ifdef __APPLE__
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#include <mach/vm_statistics.h>
+#endif
 
 //Using SDL and standard IO
 #include <SDL2/SDL.h>
@@ -16,8 +29,12 @@
 #include <OpenCL/cl.h>
 
 #include <stdio.h>
+#include <errno.h>
 #include <string>
 #include <assert.h>
+#include <algorithm>
+#include <functional>
+#include <vector>
 
 #define USE_BIGNUM
 
@@ -25,45 +42,194 @@
 #include "gmp.h"
 #endif
 
+#include "simd_kernel.h"
+#include "perturbation.h"
+#include "bla.h"
+#include "fixedpoint.h"
+#include "doubledouble.h"
+#include "tilenet.h"
+
 //Screen dimension constants
 const int SCREEN_WIDTH = 1024;
 const int SCREEN_HEIGHT = 1024;
 const int PALETTE_COUNT = 32;
 
+// x0,y0 - x1,y1 are inclusive, the border pixels belong to the rectangle
 typedef struct {
-    int             done;
-    double          center_x, center_y;
-    unsigned        hy;
+    unsigned        x0, y0;
+    unsigned        x1, y1;
+} Rect;
+
+// Double pixels that neither escaped nor turned out interior by itermax, with
+// where their orbits stopped, so raising itermax carries them on instead of
+// starting every pixel over at z = 0. The rectangles subdivision filled from a
+// border of such pixels are kept as well, their insides are no more final than
+// the border. A view keeps what its last frame left, just as many as there
+// are, see resumeFrame.
+typedef struct {
+    unsigned        count;
+    unsigned        capacity;
+    unsigned        itermax;        // of the frame they ran out in, 0 for none
+    unsigned        *offsets;       // y * xres + x
+    OrbitState      state;          // z and steps taken
+    Rect            *filled;
+    unsigned        filled_count;
+    unsigned        filled_capacity;
+    unsigned char   *running;       // by offset, 1 for the pixels in the list, render side only
+} OrbitList;
+
+// one per frame, shared by every tile of the render
+typedef struct {
+    double          center_x, center_y;     // rounded from the mpf ones, for the double kernels
+    double          center_x_lo;            // what the rounding left, kUSE_DOUBLEDOUBLE adds it back
+    double          center_y_lo;
+    mpf_srcptr      center_x_mp;            // the exact center for bignum and the reference orbits
+    mpf_srcptr      center_y_mp;
+    FloatExp        zoom;
+    unsigned        xres, yres;
     unsigned        itermax;
-    unsigned        xres;
-    unsigned        yres;
-    float           zoom;
     unsigned        flags;
     unsigned        *pixels;
-} ScanLineInfo;
+    const ReferenceOrbit *reference;    // kUSE_PERTURBATION only
+    const BLATable  *bla;               // optional with kUSE_PERTURBATION
+    int             dc_exponent;        // kUSE_FLOATEXP only, set by renderFrameCPU
+    double          reference_x;        // where the reference is as a fraction of the frame,
+    double          reference_y;        // 0.5 for the center
+    unsigned        precision;          // mpf bits from getPrecisionBits, set by renderFrameCPU
+    FixedPointCenter fixed;             // kUSE_BIGNUM, fixed.limbs 0 for mpf, set by renderFrameCPU
+    unsigned        generation;         // g_render_generation the frame was started at, see cancelRender
+    const float     *cost;              // kCostColumns x kCostRows from estimateViewCost, NULL for none
+    unsigned        tile_count;         // tiles the frame was cut into, set by renderFrameCPU
+    OrbitList       *orbits;            // kUSE_ORBITS, the pixels still running at itermax go here
+} FrameInfo;
+
+// one task, renderFrameCPU fills them from an array the caller keeps
+typedef struct {
+    FrameInfo       *frame;
+    Rect            rect;
+    double          started;        // getSeconds, for the tail latency in benchmarkTiles
+    double          finished;
+    double          cost;           // iterations frame->cost predicts for the tile, 0 without
+} TileInfo;
+
+#define kUSE_BIGNUM         0x1
+#define kUSE_SUBDIVISION    0x2
+#define kUSE_PERTURBATION   0x4
+#define kUSE_FLOATEXP       0x8     // with kUSE_PERTURBATION, past kFloatExpZoom
+#define kUSE_GLITCH_CORRECTION  0x10    // with kUSE_PERTURBATION, see correctGlitches
+#define kUSE_DOUBLEDOUBLE   0x20    // double-double c and z, see doubledouble.h
+#define kUSE_ESCALATION     0x40    // double pixels the kernel can not trust are redone in bignum
+#define kUSE_TILE_QUEUE     0x80    // finished tiles go to g_tile_queue for the event loop to show
+#define kUSE_FOCUS          0x100   // nearest tile to g_render_focus first, see calcFocusTile
+#define kUSE_ORBITS         0x200   // double pixels still running at itermax are kept, see keepOrbits
+
+// The frame is cut into square tiles of g_tile_size, one task each, pushed in
+// g_tile_order so tiles done close in time are close on screen as well. A row
+// through the valleys can cost a thousand exterior rows, a tile spreads that.
+// Frames are at most SCREEN_WIDTH x SCREEN_HEIGHT, kMaxTileCount covers them.
+#define kDefaultTileSize        64
+#define kMinTileSize            8
+#define kMaxTileSize            128
+#define kMaxTileCount           ((SCREEN_WIDTH / kMinTileSize) * (SCREEN_HEIGHT / kMinTileSize))
+
+// The cost map of a frame is the iterations a pixel is expected to take in each
+// kCostCell square, read off the last frame of the view or its parent. Tiles it
+// says cost more than a 1/kCostSplitShare of a calc thread's part of the frame
+// are quartered down to kMinTileSize, and the tiles are taken longest first.
+#define kCostCell               kMinTileSize
+#define kCostColumns            (SCREEN_WIDTH / kCostCell)
+#define kCostRows               (SCREEN_HEIGHT / kCostCell)
+#define kCostSplitShare         4
+
+// with kUSE_FOCUS the tiles this close to the focus go nearest first, ahead of the cost order
+#define kFocusRadius            256
+
+enum {
+    kTileOrderRows,
+    kTileOrderMorton,
+    kTileOrderHilbert
+};
+
+// Mariani-Silver: rectangles at or under kSubdivisionMinSize are iterated outright.
+// Quarters of a tile overlap by a pixel so a level never holds more than kSubdivisionMaxRects.
+#define kSubdivisionMinSize     6
+#define kSubdivisionMaxRects    (kMaxTileSize * kMaxTileSize / 4)
+
+// per thread scratch, long enough for every pixel of a tile
+typedef struct {
+    double          *cx, *cy;
+    double          *cx_lo, *cy_lo;     // kUSE_DOUBLEDOUBLE only
+    unsigned        *pixels;
+    unsigned        *offsets;
+    OrbitState      orbits;         // kUSE_ORBITS only
+    unsigned        batch_count;
+    Rect            *rects;         // two levels of kSubdivisionMaxRects
+} WorkerContext;
+
+typedef void (*WorkFunc)(void *arg, WorkerContext *worker);
+
+// the pool is as big as the cpus online unless -threads or MANDELBROT_THREADS say otherwise
+#define kMaxCalcThreads     256
+typedef struct {
+    WorkFunc        func;
+    void            *arg;
+} WorkItem;
 
-#define kUSE_BIGNUM 0x1
+// Every calc thread has a deque of its own. It pushes and pops at the bottom,
+// newest first like the one list this replaced, and when it runs dry it steals
+// the oldest task off another thread's top. The ring is a power of two, top and
+// bottom run free and only grow, and a full ring is doubled under its lock.
+typedef struct {
+    pthread_mutex_t lock;
+    WorkItem        *items;
+    unsigned        size;
+    unsigned        top, bottom;
+} WorkDeque;
 
-typedef struct WorkQueueEntry_t {
-    volatile struct  WorkQueueEntry_t   *next;
-    ScanLineInfo                        *scan_info;
-} WorkQueueEntry;
+#define kWorkDequeSize      256     // starting ring size, as many as a frame of 64 pixel tiles
 
+// Tasks pushed from outside the pool are dealt round robin over the deques.
+// pending counts tasks pushed and not finished yet, waitForWork sleeps on done
+// until it drops to 0. An idle thread notes wake_count before it looks for work
+// and only sleeps while it has not moved, every push moves it. quit has the
+// threads return once they run out, see stopCalcThreads.
 struct {
-    volatile unsigned           count;
-    volatile WorkQueueEntry     *next;
-    pthread_mutex_t             queue_lock;
-    pthread_cond_t              cond;
-} g_work_queue;
+    WorkDeque       deques[kMaxCalcThreads];
+    pthread_t       threads[kMaxCalcThreads];
+    unsigned        thread_count;
+    unsigned        quit;
+    unsigned        next_deque;
+    unsigned        pending;
+    unsigned        wake_count;
+    unsigned        sleeping;
+    pthread_mutex_t sleep_lock;
+    pthread_cond_t  wake;
+    pthread_mutex_t done_lock;
+    pthread_cond_t  done;
+    unsigned long long  steals;
+    unsigned long long  sleeps;
+} g_work_pool;
+
+// index of the calc thread's own deque, -1 off the pool
+static __thread int t_worker_index = -1;
+
+// room for Z held all the way to 2^kMaxZoomExponent, it doubles the zoom each view
+#define kMaxZoomViews       (2 * kMaxZoomExponent)
 
 typedef struct ZoomView_t {
     struct ZoomView_t   *next;
-    double              center_x, center_y, zoom;
+    mpf_t               center_x_mp;    // grows with the zoom, see pushZoomView
+    mpf_t               center_y_mp;
+    double              center_x, center_y;
+    FloatExp            zoom;
     unsigned            use_histogram;
     unsigned            itermax;
     unsigned            flags;
     unsigned            xres, yres;
     unsigned            *pixels;
+    unsigned            pixels_itermax; // itermax of the frame in pixels, 0 before the first
+    unsigned            pixels_mode;    // the kRenderMode it was rendered in, see getPanShift
+    OrbitList           orbits;         // the pixels of that frame still running, see canResumeView
 } ZoomView;
 
 typedef struct {
@@ -73,6 +239,9 @@ typedef struct {
     unsigned        itermax;
     unsigned        sample_count;
     int             pitch;
+    unsigned        flags;
+    double          periodicity_epsilon;
+    unsigned        periodicity_interval;
 } CLWorkInfo;
 
 typedef struct {
@@ -95,767 +264,5950 @@ typedef struct {
 
 enum {
     kRenderModeDouble,
+    kRenderModeDoubleDouble,
 #ifdef USE_BIGNUM
     kRenderModeBigNUM,
+    kRenderModePerturbation,
 #endif
-    kRenderModeOpenCL
+    kRenderModeOpenCL,
+    kRenderModeHybrid,              // double, the OpenCL device and the calc threads share the frame
+    kRenderModeAuto                 // one of the cpu modes per frame, see chooseRenderMode
 };
 
 
 unsigned            render_mode;
+KernelOptions       g_kernel_options = {
+    kKernelCardioidCheck | kKernelPeriodicityCheck,
+    kDefaultPeriodicityTolerance,
+    kDefaultPeriodicityInterval,
+    0.0,
+    NULL,
+    0
+};
+KernelStats         g_frame_stats;
+bool                g_use_subdivision = true;
+bool                g_use_bla = true;
+double              g_bla_epsilon = kDefaultBLAEpsilon;
+bool                g_use_glitch_correction = true;
+bool                g_start_auto = false;
+bool                g_use_escalation = false;
+unsigned            g_calc_threads = 0;                 // 0 for one per cpu, see getCalcThreadCount
+bool                g_pin_threads = false;
+unsigned            g_render_generation = 0;
+void                (*g_render_poll)(void) = NULL;     // called while a cpu frame renders, can cancel it
+double              g_cancel_time = 0.0;                // getSeconds when the last frame was cancelled, 0 once reported
+unsigned            g_tile_size = kDefaultTileSize;
+unsigned            g_tile_order = kTileOrderHilbert;
+bool                g_use_focus = true;
+bool                g_use_cost_model = true;
+bool                g_use_speculation = true;           // render likely next views while idle, see speculateNextView
+bool                g_use_resume = true;                // a higher itermax carries the last frame's orbits on, see resumeFrame
+bool                g_use_pan_reuse = true;             // a click copies what the last frame has of the new one, see getPanShift
+double              g_hybrid_share = 0.5;               // OpenCL's part of a hybrid frame, see renderFrameHybrid
+bool                g_log_tile_cost = false;            // predicted and actual cost of every tile, see logTileCosts
+unsigned            g_render_focus = 0;                 // frame pixel looked at, x << 16 | y, see setRenderFocus
 cl_device_id        device = NULL;
 cl_context          context = 0;
 cl_command_queue    queue = 0;
+cl_kernel           kernel = 0;
 
-void *calcThread(void *ctx)
+void pushWork(WorkFunc func, void *arg)
 {
-    while(1)
+    assert(g_work_pool.thread_count > 0); // startCalcThreads first
+    
+    unsigned    index = t_worker_index >= 0 ? t_worker_index :
+                        __atomic_fetch_add(&g_work_pool.next_deque, 1, __ATOMIC_RELAXED) % g_work_pool.thread_count;
+    WorkDeque   *deque = &g_work_pool.deques[index];
+    
+    // counted before anyone can take it, so pending never drops to 0 early
+    __atomic_fetch_add(&g_work_pool.pending, 1, __ATOMIC_SEQ_CST);
+    
+    pthread_mutex_lock(&deque->lock);
     {
-        volatile WorkQueueEntry *entry = NULL;
-        
-        pthread_mutex_lock(&g_work_queue.queue_lock);
-        pthread_cond_wait(&g_work_queue.cond, &g_work_queue.queue_lock);
+        if(deque->bottom - deque->top == deque->size)
         {
-            if(g_work_queue.next)
+            WorkItem *items = (WorkItem *)malloc(2 * deque->size * sizeof(WorkItem));
+            
+            for(unsigned i=deque->top; i!=deque->bottom; i++)
             {
-                entry = g_work_queue.next;
-                
-                g_work_queue.next = entry->next;
+                items[i & (2 * deque->size - 1)] = deque->items[i & (deque->size - 1)];
             }
+            
+            free(deque->items);
+            deque->items = items;
+            deque->size *= 2;
         }
-        pthread_mutex_unlock(&g_work_queue.queue_lock);
         
-        if(entry)
+        deque->items[deque->bottom & (deque->size - 1)].func    = func;
+        deque->items[deque->bottom & (deque->size - 1)].arg     = arg;
+        __atomic_store_n(&deque->bottom, deque->bottom + 1, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&deque->lock);
+    
+    // the sleeper checks wake_count after it counts itself in, so one of the two sees the other
+    __atomic_fetch_add(&g_work_pool.wake_count, 1, __ATOMIC_SEQ_CST);
+    
+    if(__atomic_load_n(&g_work_pool.sleeping, __ATOMIC_SEQ_CST))
+    {
+        pthread_mutex_lock(&g_work_pool.sleep_lock);
+        pthread_cond_signal(&g_work_pool.wake);
+        pthread_mutex_unlock(&g_work_pool.sleep_lock);
+    }
+}
+
+// own deque from the bottom, then the others from the top
+static bool popWork(unsigned index, WorkItem *item)
+{
+    for(unsigned i=0; i<g_work_pool.thread_count; i++)
+    {
+        WorkDeque   *deque = &g_work_pool.deques[(index + i) % g_work_pool.thread_count];
+        bool        found = false;
+        
+        // a look without the lock skips the empty ones, it is checked again under it
+        if(__atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE) == __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE))
+            continue;
+        
+        pthread_mutex_lock(&deque->lock);
         {
-            ScanLineInfo *scan_info = entry->scan_info;
-            
-            double      cx, cy;
-            double      x, xx;
-            int         iteration;
-            int         hx;
-            double      zoom        = scan_info->zoom;
-            double      center_x    = scan_info->center_x;
-            double      center_y    = scan_info->center_y;
-            double      xres        = scan_info->xres;
-            double      yres        = scan_info->yres;
-            double      hy          = scan_info->hy;
-            unsigned    itermax     = scan_info->itermax;
-            unsigned    *pixels     = scan_info->pixels;
-#ifdef USE_BIGNUM
-            bool        useBignum   = scan_info->flags & kUSE_BIGNUM;
-#endif
-            for (hx=0; hx<xres; hx++)
+            if(deque->top != deque->bottom)
             {
-                bool    done = false;
-                double  y;
-                
-                cx = center_x + 3.0*((double)hx/xres-0.5)/zoom;
-                cy = center_y + 3.0*(hy/yres-0.5)/zoom;
-                x = 0.0; y=0.0;
-                
-#ifdef USE_BIGNUM
-                if(useBignum)
+                if(i == 0)
                 {
-                    mpf_t   _x, _y;
-                    mpf_t   _xx;
-                    mpf_t   _cx, _cy;
-                    mpf_t   _two, _tmp1, _tmp2;
-                    
-                    mpf_init(_x);
-                    mpf_init(_y);
-                    mpf_init(_xx);
-                    mpf_init(_cx);
-                    mpf_init(_cy);
-                    mpf_init(_two);
-                    mpf_init(_tmp1);
-                    mpf_init(_tmp2);
-                    
-                    // cx = center_x + ((double)hx/xres-0.5)/zoom*3.0;
-                    // cy = center_y + (hy/yres-0.5)/zoom*3.0;
-                    // x = 0.0; y=0.0;
-                    
-                    mpf_set_d(_cx, center_x);
-                    mpf_set_d(_tmp1, ((double)hx/xres-0.5)*3.0);
-                    mpf_set_d(_tmp2, zoom);
-                    mpf_div(_tmp1, _tmp1, _tmp2);
-                    mpf_add(_cx, _cx, _tmp1);
-                    
-                    mpf_set_d(_cy, center_y);
-                    mpf_set_d(_tmp1, ((double)hy/yres-0.5)*3.0);
-                    mpf_set_d(_tmp2, zoom);
-                    mpf_div(_tmp1, _tmp1, _tmp2);
-                    mpf_add(_cy, _cy, _tmp1);
-                    
-                    mpf_set_d(_x, x);
-                    mpf_set_d(_y, y);
-                    mpf_set_d(_two, 2.0);
-                    
-                    for (iteration=1;!done && iteration<itermax;iteration++)
-                    {
-                        // xx = x*x-y*y+cx;
-                        mpf_mul(_tmp1, _x, _x);
-                        mpf_mul(_tmp2, _y, _y);
-                        mpf_sub(_tmp1, _tmp1, _tmp2);
-                        mpf_add(_xx, _tmp1, _cx);
-                        
-                        // y = 2.0*x*y+cy;
-                        mpf_mul(_tmp1, _two, _x);
-                        mpf_mul(_tmp1, _tmp1, _y);
-                        mpf_add(_y, _tmp1, _cy);
-                        
-                        // x = xx;
-                        mpf_set(_x, _xx);
-                        
-                        // x*x+y*y>100.0
-                        mpf_mul(_tmp1, _x, _x);
-                        mpf_mul(_tmp2, _y, _y);
-                        mpf_add(_tmp1, _tmp1, _tmp2);
-                        
-                        if (mpf_get_d(_tmp1)>100.0)
-                        {
-                            done = true;
-                        }
-                    }
-                    
-                    if(done)
-                    {
-                        pixels[hx] = iteration;
-                    }
-                    else
-                    {
-                        pixels[hx] = 0;
-                    }
+                    *item = deque->items[(deque->bottom - 1) & (deque->size - 1)];
+                    __atomic_store_n(&deque->bottom, deque->bottom - 1, __ATOMIC_RELEASE);
                 }
                 else
-#endif // #ifdef USE_BIGNUM
                 {
-                    for (iteration=1;!done && iteration<itermax;iteration++)
-                    {
-                        xx = x*x-y*y+cx;
-                        y = 2.0*x*y+cy;
-                        x = xx;
-                        
-                        if (x*x+y*y>100.0)
-                        {
-                            done = true;
-                        }
-                    }
-                    
-                    if(done)
-                    {
-                        pixels[hx] = iteration;
-                    }
-                    else
-                    {
-                        pixels[hx] = 0;
-                    }
+                    *item = deque->items[deque->top & (deque->size - 1)];
+                    __atomic_store_n(&deque->top, deque->top + 1, __ATOMIC_RELEASE);
                 }
+                
+                found = true;
             }
+        }
+        pthread_mutex_unlock(&deque->lock);
+        
+        if(found)
+        {
+            if(i)
+                __atomic_fetch_add(&g_work_pool.steals, 1, __ATOMIC_RELAXED);
             
-            scan_info->done = 1;
-            
-            pthread_mutex_lock(&g_work_queue.queue_lock);
-            {
-                g_work_queue.count--;
-                free((void *)entry);
-            }
-            pthread_mutex_unlock(&g_work_queue.queue_lock);
+            return true;
         }
     }
     
-    return NULL;
+    return false;
 }
 
-cl_device_id getCLDevice()
+static void finishWork(void)
 {
-    cl_platform_id platforms[100];
-    cl_uint platforms_n = 0;
-    
-    clGetPlatformIDs(100, platforms, &platforms_n);
-    
-    cl_device_id devices[100];
-    cl_uint devices_n = 0;
-    clGetDeviceIDs(platforms[0], CL_DEVICE_TYPE_GPU, 100, devices, &devices_n);
-    
-    char buffer[1024];
-    for (int i=0; i<devices_n; i++)
+    if(__atomic_sub_fetch(&g_work_pool.pending, 1, __ATOMIC_ACQ_REL) == 0)
     {
-        clGetDeviceInfo(devices[i], CL_DEVICE_VENDOR, sizeof(buffer), buffer, NULL);
-        
-        if(!strcmp("NVIDIA", buffer))
-        {
-            clGetDeviceInfo(devices[i], CL_DEVICE_VENDOR, sizeof(buffer), buffer, NULL);
-            
-            return devices[i];
-        }
+        pthread_mutex_lock(&g_work_pool.done_lock);
+        pthread_cond_broadcast(&g_work_pool.done);
+        pthread_mutex_unlock(&g_work_pool.done_lock);
     }
-    
-    return devices[0];
 }
 
-void cl_notify(const char *errinfo, const void *private_info, size_t cb, void *user_data)
+// blocks until every task pushed so far is done, including the ones the tasks push
+void waitForWork(void)
 {
-    fprintf(stderr, "OpenCL Error (via pfn_notify): %s\n", errinfo);
+    pthread_mutex_lock(&g_work_pool.done_lock);
+    
+    while(__atomic_load_n(&g_work_pool.pending, __ATOMIC_ACQUIRE))
+    {
+        pthread_cond_wait(&g_work_pool.done, &g_work_pool.done_lock);
+    }
+    
+    pthread_mutex_unlock(&g_work_pool.done_lock);
 }
 
-HSV_Color RGB2HSV(RGB_Color in)
+// waitForWork for at most seconds, true when the work is done
+bool waitForWorkFor(double seconds)
 {
-    HSV_Color   out;
-    double      min, max, delta;
+    struct timespec deadline;
+    double          end = getSeconds() + seconds;   // gettimeofday, the same clock as the condition's
+    bool            done;
     
-    min = in.r < in.g ? in.r : in.g;
-    min = min  < in.b ? min  : in.b;
+    deadline.tv_sec     = (time_t)end;
+    deadline.tv_nsec    = (long)((end - deadline.tv_sec) * 1e9);
     
-    max = in.r > in.g ? in.r : in.g;
-    max = max  > in.b ? max  : in.b;
+    pthread_mutex_lock(&g_work_pool.done_lock);
     
-    out.v = max;                                // v
-    delta = max - min;
-    if( max > 0.0 ) { // NOTE: if Max is == 0, this divide would cause a crash
-        out.s = (delta / max);                  // s
-    } else {
-        // if max is 0, then r = g = b = 0
-        // s = 0, v is undefined
-        out.s = 0.0;
-        out.h = NAN;                            // its now undefined
-        return out;
+    while(__atomic_load_n(&g_work_pool.pending, __ATOMIC_ACQUIRE))
+    {
+        if(pthread_cond_timedwait(&g_work_pool.done, &g_work_pool.done_lock, &deadline) == ETIMEDOUT)
+            break;
     }
-    if( in.r >= max )                           // > is bogus, just keeps compilor happy
-        out.h = ( in.g - in.b ) / delta;        // between yellow & magenta
-    else
-        if( in.g >= max )
-            out.h = 2.0 + ( in.b - in.r ) / delta;  // between cyan & yellow
-        else
-            out.h = 4.0 + ( in.r - in.g ) / delta;  // between magenta & cyan
     
-    out.h *= 60.0;                              // degrees
+    done = !__atomic_load_n(&g_work_pool.pending, __ATOMIC_ACQUIRE);
     
-    if( out.h < 0.0 )
-        out.h += 360.0;
+    pthread_mutex_unlock(&g_work_pool.done_lock);
     
-    return out;
+    return done;
 }
 
-RGB_Color HSV2RGB(HSV_Color in)
+// Every frame is stamped with g_render_generation when it starts and its tiles
+// and kernels give up as soon as the counter has moved on, see isKernelCancelled.
+// The frame waits with g_render_poll every kRenderPollInterval, which is how a
+// benchmark gets a look at it in the middle of a render.
+#define kRenderPollInterval     0.005
+
+void cancelRender(void)
 {
-    double      hh, p, q, t, ff;
-    long        i;
-    RGB_Color   out;
-    
-    if(in.s <= 0.0)
+    __atomic_fetch_add(&g_render_generation, 1, __ATOMIC_RELAXED);
+}
+
+static inline bool isFrameCancelled(const FrameInfo *frame)
+{
+    return __atomic_load_n(&g_render_generation, __ATOMIC_RELAXED) != frame->generation;
+}
+
+static void waitForFrame(void)
+{
+    if(!g_render_poll)
     {
-        out.r = in.v;
-        out.g = in.v;
-        out.b = in.v;
-        return out;
+        waitForWork();
+        return;
     }
-    hh = in.h;
-    if(hh >= 360.0) hh = 0.0;
-    hh /= 60.0;
-    i = (long)hh;
-    ff = hh - i;
-    p = in.v * (1.0 - in.s);
-    q = in.v * (1.0 - (in.s * ff));
-    t = in.v * (1.0 - (in.s * (1.0 - ff)));
     
-    switch(i)
+    while(!waitForWorkFor(kRenderPollInterval))
     {
-        case 0:
-            out.r = in.v;
-            out.g = t;
-            out.b = p;
-            break;
-        case 1:
-            out.r = q;
-            out.g = in.v;
-            out.b = p;
-            break;
-        case 2:
-            out.r = p;
-            out.g = in.v;
-            out.b = t;
-            break;
-        case 3:
-            out.r = p;
-            out.g = q;
-            out.b = in.v;
-            break;
-        case 4:
-            out.r = t;
-            out.g = p;
-            out.b = in.v;
-            break;
-        case 5:
-        default:
-            out.r = in.v;
-            out.g = p;
-            out.b = q;
-            break;
+        g_render_poll();
     }
-    
-    return out;
 }
 
-HSV_Color genBezierColor(float u, HSV_Color *cpts)
+// the options a frame's tasks hand to the kernels
+static inline void setFrameOptions(KernelOptions *options, const FrameInfo *frame)
 {
-    HSV_Color   hsv;
-    float       b0, b1, b2, b3;
-    
-    b0 = pow(1.0 - u, 3);
-    b1 = 3.0 * u * pow(1.0 - u, 2);
-    b2 = 3.0 * pow(u, 2) * (1.0 - u);
-    b3 = pow(u, 3);
+    *options = g_kernel_options;
     
-    hsv.h = b0 * cpts[0].h + b1 * cpts[1].h + b2 * cpts[2].h + b3 * cpts[3].h;
-    hsv.s = b0 * cpts[0].s + b1 * cpts[1].s + b2 * cpts[2].s + b3 * cpts[3].s;
-    hsv.v = b0 * cpts[0].v + b1 * cpts[1].v + b2 * cpts[2].v + b3 * cpts[3].v;
+    options->pixel_spacing      = getPixelSpacing(frame->zoom, frame->xres);
+    options->cancel_generation  = &g_render_generation;
+    options->generation         = frame->generation;
     
-    return hsv;
+    // c finer than a double, the test on the rounded one misplaces the boundary. A
+    // perturbation kernel tests the reference plus dc and a double-double one the
+    // hi part, which are no finer.
+    if((frame->flags & (kUSE_BIGNUM | kUSE_ESCALATION | kUSE_PERTURBATION | kUSE_DOUBLEDOUBLE)) &&
+       !isCardioidTestExact(options->pixel_spacing, frame->center_x, frame->center_y))
+    {
+        options->flags &= ~kKernelCardioidCheck;
+    }
 }
 
-RGB_Color genColorFromPalette(unsigned index, unsigned max, Palette *palette)
+// Tiles of a kUSE_TILE_QUEUE frame are handed to the event loop as they finish,
+// any calc thread pushes and only the event loop pops. Each slot's sequence says
+// whose turn it is (Vyukov's bounded queue) so neither side takes a lock. When
+// the event loop is a whole queue behind a tile is dropped, the finished frame
+// is drawn whole anyway.
+#define kTileQueueSize          16384   // a power of two, at least kMaxTileCount
+
+typedef struct {
+    unsigned        sequence;       // pos + 1 once slot pos is pushed, pos + kTileQueueSize once popped
+    unsigned        generation;     // the frame's, the event loop skips the stale ones
+    Rect            rect;
+} TileQueueSlot;
+
+struct {
+    TileQueueSlot   slots[kTileQueueSize];
+    unsigned        head __attribute__((aligned(64)));  // next to pop, the event loop's own
+    unsigned        tail __attribute__((aligned(64)));  // next to push
+    Uint32          event;          // SDL user event that wakes the event loop, 0 for none
+    unsigned        wake_pending;   // set while a wake event sits unread in the SDL queue
+} g_tile_queue;
+
+static void initTileQueue(void)
 {
-    if(index == 0)
+    for(unsigned i=0; i<kTileQueueSize; i++)
     {
-        RGB_Color   zero;
-        
-        zero.r = 0;
-        zero.g = 0;
-        zero.b = 0;
-        
-        return zero;
+        g_tile_queue.slots[i].sequence = i;
     }
     
-    // deferred creation of palette if count is larger
-    if(max > palette->count)
+    g_tile_queue.head = 0;
+    g_tile_queue.tail = 0;
+}
+
+static bool pushTileQueue(unsigned generation, const Rect *rect)
+{
+    unsigned        pos = __atomic_load_n(&g_tile_queue.tail, __ATOMIC_RELAXED);
+    TileQueueSlot   *slot;
+    
+    for(;;)
     {
-        free(palette->c);
+        slot = &g_tile_queue.slots[pos & (kTileQueueSize - 1)];
         
-        palette->c = new RGB_Color [max];
-        palette->count = max;
+        int diff = (int)(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) - pos);
         
-        for(int i=0; i<max; i++)
+        if(diff == 0)
         {
-            float u = (float)i / (float)max;
-            HSV_Color hsv = genBezierColor(u, palette->control_colors);
-            RGB_Color rgb = HSV2RGB(hsv);
-            
-            palette->c[i].r = rgb.r * 255.0;
-            palette->c[i].g = rgb.g * 255.0;
-            palette->c[i].b = rgb.b * 255.0;
+            if(__atomic_compare_exchange_n(&g_tile_queue.tail, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        }
+        else if(diff < 0)
+        {
+            return false;
+        }
+        else
+        {
+            pos = __atomic_load_n(&g_tile_queue.tail, __ATOMIC_RELAXED);
         }
     }
-    else if (max < palette->count)
+    
+    slot->generation    = generation;
+    slot->rect          = *rect;
+    
+    __atomic_store_n(&slot->sequence, pos + 1, __ATOMIC_RELEASE);
+    
+    return true;
+}
+
+// event loop only
+static bool popTileQueue(unsigned *generation, Rect *rect)
+{
+    unsigned        pos = g_tile_queue.head;
+    TileQueueSlot   *slot = &g_tile_queue.slots[pos & (kTileQueueSize - 1)];
+    
+    if(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != pos + 1)
+        return false;
+    
+    *generation = slot->generation;
+    *rect       = slot->rect;
+    
+    g_tile_queue.head = pos + 1;
+    
+    __atomic_store_n(&slot->sequence, pos + kTileQueueSize, __ATOMIC_RELEASE);
+    
+    return true;
+}
+
+// Posts the wake event unless one is still unread. The event loop clears
+// wake_pending with an exchange before it looks at the queue, so whatever was
+// pushed before a skipped post is seen then.
+static void wakeEventLoop(void)
+{
+    if(g_tile_queue.event && !__atomic_exchange_n(&g_tile_queue.wake_pending, 1, __ATOMIC_ACQ_REL))
     {
-        float scale = (float)palette->count / (float)max;
+        SDL_Event event;
         
-        index = scale * index;
+        memset(&event, 0, sizeof(event));
+        event.type = g_tile_queue.event;
+        
+        SDL_PushEvent(&event);
     }
-    
-    return palette->c[index];
 }
 
-int createPalettes(Palette *palettes)
+#ifdef USE_BIGNUM
+// c = center + offset * 2^offset_exponent at bits of precision, offset being the
+// pixel's 3.0*(hx/xres-0.5)/zoom
+unsigned calcPixelBigNUM(const KernelOptions *options, mpf_srcptr center_x, mpf_srcptr center_y, unsigned bits,
+                         double offset_x, double offset_y, int offset_exponent, unsigned itermax,
+                         KernelStats *stats)
 {
-    unsigned        palette_index;
+    unsigned iteration;
+    bool    done = false;
+    bool    periodic = false;
     
-    HSV_Color   zero;
-    zero.h = 0.0;
-    zero.s = 0.0;
-    zero.v = 0.0;
+    if((options->flags & kKernelCardioidCheck) &&
+       inCardioidOrBulb(mpf_get_d(center_x) + ldexp(offset_x, offset_exponent),
+                        mpf_get_d(center_y) + ldexp(offset_y, offset_exponent)))
+    {
+        stats->cardioid_skipped++;
+        return 0;
+    }
     
-    // greyscale
-    palette_index = 0;
+    mpf_t   _x, _y;
+    mpf_t   _xx;
+    mpf_t   _cx, _cy;
+    mpf_t   _tmp1, _tmp2;
+    mpf_t   _saved_x, _saved_y;
+    unsigned window = options->periodicity_interval, window_count = 0;
     
-    for(int i=0; i<4; i++)
+    mpf_init2(_saved_x, bits);
+    mpf_init2(_saved_y, bits);
+    mpf_init2(_x, bits);
+    mpf_init2(_y, bits);
+    mpf_init2(_xx, bits);
+    mpf_init2(_cx, bits);
+    mpf_init2(_cy, bits);
+    mpf_init2(_tmp1, bits);
+    mpf_init2(_tmp2, bits);
+    
+    // cx = center_x + offset_x;
+    // cy = center_y + offset_y;
+    // x = 0.0; y=0.0;
+    
+    setScaledOffset(_cx, offset_x, offset_exponent);
+    mpf_add(_cx, _cx, center_x);
+    
+    setScaledOffset(_cy, offset_y, offset_exponent);
+    mpf_add(_cy, _cy, center_y);
+    
+    for (iteration=1;!done && !periodic && iteration<itermax;iteration++)
     {
-        palettes[palette_index].control_colors[i] = zero;
+        if(isKernelCancelledAt(options, iteration))
+            break;
+        
+        // xx = x*x-y*y+cx;
+        mpf_mul(_tmp1, _x, _x);
+        mpf_mul(_tmp2, _y, _y);
+        mpf_sub(_tmp1, _tmp1, _tmp2);
+        mpf_add(_xx, _tmp1, _cx);
+        
+        // y = 2.0*x*y+cy;
+        mpf_mul(_tmp1, _x, _y);
+        mpf_mul_2exp(_tmp1, _tmp1, 1);
+        mpf_add(_y, _tmp1, _cy);
+        
+        // x = xx;
+        mpf_set(_x, _xx);
+        
+        // x*x+y*y>100.0
+        mpf_mul(_tmp1, _x, _x);
+        mpf_mul(_tmp2, _y, _y);
+        mpf_add(_tmp1, _tmp1, _tmp2);
+        
+        if (mpf_get_d(_tmp1)>100.0)
+        {
+            done = true;
+        }
+        else if(options->flags & kKernelPeriodicityCheck)
+        {
+            // same Brent check as the double kernels, see mandelbrot.h
+            mpf_sub(_tmp1, _x, _saved_x);
+            mpf_sub(_tmp2, _y, _saved_y);
+            
+            if(fabs(mpf_get_d(_tmp1)) < getPeriodicityEpsilon(options) &&
+               fabs(mpf_get_d(_tmp2)) < getPeriodicityEpsilon(options))
+            {
+                periodic = true;
+                stats->periodic_pixels++;
+                stats->periodicity_saved += itermax - 1 - iteration;
+            }
+            else if(++window_count == window)
+            {
+                mpf_set(_saved_x, _x);
+                mpf_set(_saved_y, _y);
+                window_count = 0;
+                window *= 2;
+            }
+        }
     }
     
-    palettes[palette_index].control_colors[0].v = 0.0;
-    palettes[palette_index].control_colors[1].v = 1.0/3.0;
-    palettes[palette_index].control_colors[2].v = 2.0/3.0;
-    palettes[palette_index].control_colors[3].v = 1.0;
+    mpf_clear(_saved_x);
+    mpf_clear(_saved_y);
+    mpf_clear(_x);
+    mpf_clear(_y);
+    mpf_clear(_xx);
+    mpf_clear(_cx);
+    mpf_clear(_cy);
+    mpf_clear(_tmp1);
+    mpf_clear(_tmp2);
     
-    palettes[palette_index].count = 256;
-    palettes[palette_index].c     = new RGB_Color [256];
+    return done ? iteration : 0;
+}
+
+// bignum pixel hx,hy of the frame, fixed point when the zoom fits kFixedPointMaxLimbs
+static inline unsigned calcFramePixelBigNUM(const FrameInfo *frame, const KernelOptions *options,
+                                            unsigned hx, unsigned hy, KernelStats *stats)
+{
+    // the mantissas of the offsets, they are under the double range past a zoom of 1e308
+    double offset_x = 3.0*((double)hx/frame->xres-0.5)/frame->zoom.m;
+    double offset_y = 3.0*((double)hy/frame->yres-0.5)/frame->zoom.m;
     
-    for(int i=0; i<256; i++)
+    if(frame->fixed.limbs)
     {
-        float u = (float)i / 255.0;
-        HSV_Color hsv = genBezierColor(u, palettes[palette_index].control_colors);
-        RGB_Color rgb = HSV2RGB(hsv);
-        
-        palettes[palette_index].c[i].r = rgb.r * 255.0;
-        palettes[palette_index].c[i].g = rgb.g * 255.0;
-        palettes[palette_index].c[i].b = rgb.b * 255.0;
+        return calcPixelFixedPoint(&frame->fixed, options, ldexp(offset_x, -frame->zoom.e),
+                                   ldexp(offset_y, -frame->zoom.e), frame->itermax, stats);
     }
     
-    palette_index++;
+    return calcPixelBigNUM(options, frame->center_x_mp, frame->center_y_mp, frame->precision,
+                           offset_x, offset_y, -frame->zoom.e, frame->itermax, stats);
+}
+#endif // #ifdef USE_BIGNUM
+
+// c of pixel x,y, or its offset from the reference for perturbation, where
+// adding the center back would round the offset away at depth. With floatexp
+// the offset is scaled by 2^-dc_exponent, the zoom's exponent, so it stays near 1.
+static inline void getPixelC(const FrameInfo *frame, unsigned x, unsigned y, double *cx, double *cy)
+{
+    if(frame->flags & kUSE_FLOATEXP)
+    {
+        *cx = 3.0*((double)x/frame->xres-frame->reference_x)/frame->zoom.m;
+        *cy = 3.0*((double)y/frame->yres-frame->reference_y)/frame->zoom.m;
+        return;
+    }
     
-    // remaining
-    for(int j=palette_index; j<PALETTE_COUNT; j++)
+    if(frame->flags & kUSE_PERTURBATION)
     {
-        palettes[palette_index].count = 0;
-        palette_index++;
+        *cx = getZoomOffset(3.0*((double)x/frame->xres-frame->reference_x), frame->zoom);
+        *cy = getZoomOffset(3.0*((double)y/frame->yres-frame->reference_y), frame->zoom);
+        return;
     }
     
-    palette_index = 0;
+    *cx = frame->center_x + getZoomOffset(3.0*((double)x/frame->xres-0.5), frame->zoom);
+    *cy = frame->center_y + getZoomOffset(3.0*((double)y/frame->yres-0.5), frame->zoom);
+}
+
+// c of pixel x,y as a double-double, the offset is added to the center's two halves
+static inline void getPixelCDoubleDouble(const FrameInfo *frame, unsigned x, unsigned y,
+                                         double *cx, double *cy, double *cx_lo, double *cy_lo)
+{
+    DoubleDouble c_x = ddAddDouble(makeDoubleDouble(frame->center_x, frame->center_x_lo),
+                                   getZoomOffset(3.0*((double)x/frame->xres-0.5), frame->zoom));
+    DoubleDouble c_y = ddAddDouble(makeDoubleDouble(frame->center_y, frame->center_y_lo),
+                                   getZoomOffset(3.0*((double)y/frame->yres-0.5), frame->zoom));
     
-    return palette_index;
+    *cx     = c_x.hi;
+    *cx_lo  = c_x.lo;
+    *cy     = c_y.hi;
+    *cy_lo  = c_y.lo;
 }
 
-void drawFractalImage(SDL_Window* window, SDL_Surface *draw_surface, ZoomView *current_view, Palette *current_palette)
+// largest |dc| getPixelC hands out, the corners of the frame
+static inline FloatExp getMaxPixelOffset(FloatExp zoom)
 {
-    SDL_Surface *screen_surface;
-    unsigned    *histogram = NULL;
-    unsigned    histogram_max = 0;
+    return makeFloatExp(1.5 * sqrt(2.0) / zoom.m, -zoom.e);
+}
+
+// runs the double or perturbation kernel over count points from getPixelC
+// cx_lo / cy_lo are only read with kUSE_DOUBLEDOUBLE
+void iterateFrame(const FrameInfo *frame, const KernelOptions *options, const double *cx, const double *cy,
+                  const double *cx_lo, const double *cy_lo, unsigned count, unsigned *pixels, KernelStats *stats)
+{
+    KernelOptions perturbation_options = *options;
     
-    if(current_view->use_histogram)
+    if(frame->flags & kUSE_GLITCH_CORRECTION)
     {
-        unsigned    *src_pixels = current_view->pixels;
-        size_t      len = current_view->xres * current_view->yres;
+        perturbation_options.flags |= kKernelGlitchCheck;
+    }
+    
+    if(frame->flags & kUSE_FLOATEXP)
+    {
+        iteratePerturbationFloatExp(&perturbation_options, frame->reference, frame->bla, cx, cy, frame->dc_exponent,
+                                    count, frame->itermax, pixels, stats);
+    }
+    else if(frame->flags & kUSE_PERTURBATION)
+    {
+        iteratePerturbation(&perturbation_options, frame->reference, frame->bla, cx, cy, count, frame->itermax,
+                            pixels, stats);
+    }
+    else if(frame->flags & kUSE_DOUBLEDOUBLE)
+    {
+        iterateDoubleDouble(options, cx, cy, cx_lo, cy_lo, count, frame->itermax, pixels, stats);
+    }
+    else if(frame->flags & kUSE_ESCALATION)
+    {
+        KernelOptions checked_options = *options;
         
-        histogram = new unsigned [len];
+        checked_options.flags |= kKernelErrorCheck;
         
-        for(int i=0; i<len; i++)
-        {
-            histogram[i] = 0;
-        }
+        iterateDouble(&checked_options, cx, cy, count, frame->itermax, pixels, stats);
+    }
+    else
+    {
+        iterateDouble(options, cx, cy, count, frame->itermax, pixels, stats);
+    }
+}
 
-        for(int i=0; i<len; i++)
-        {
-            unsigned index = src_pixels[i];
-            
-            histogram[index]++;
-        }
+#ifdef USE_BIGNUM
+// kUSE_ESCALATION, a pixel the double kernel flagged kUnreliablePixel again in bignum
+static inline void escalatePixel(const FrameInfo *frame, const KernelOptions *options, unsigned *value,
+                                 unsigned x, unsigned y, KernelStats *stats)
+{
+    if(*value & kUnreliablePixel)
+    {
+        *value = calcFramePixelBigNUM(frame, options, x, y, stats);
+        stats->escalated_pixels++;
+    }
+}
+#endif
 
-        for(int i=0; i<len; i++)
-        {
-            if(histogram[i] > histogram_max)
-                histogram_max = histogram[i];
-        }
+// queues pixel x,y of the frame for the next calcBatch
+static inline void addBatchPixel(const FrameInfo *frame, WorkerContext *worker, unsigned x, unsigned y)
+{
+    unsigned i = worker->batch_count++;
+    
+    if(frame->flags & kUSE_DOUBLEDOUBLE)
+        getPixelCDoubleDouble(frame, x, y, &worker->cx[i], &worker->cy[i], &worker->cx_lo[i], &worker->cy_lo[i]);
+    else
+        getPixelC(frame, x, y, &worker->cx[i], &worker->cy[i]);
+    worker->offsets[i] = y * frame->xres + x;
+    
+    if(frame->flags & kUSE_ORBITS)
+        worker->orbits.iterations[i] = 0;
+}
+
+// kUSE_ORBITS, the pixels of the batch still running at itermax go to the
+// frame's list, one reservation a batch so the threads fill in runs of their own
+static void keepOrbits(const FrameInfo *frame, WorkerContext *worker, unsigned count)
+{
+    OrbitList   *list = frame->orbits;
+    unsigned    kept = 0;
+    
+    for(unsigned i=0; i<count; i++)
+    {
+        if(worker->orbits.iterations[i] != kOrbitFinal)
+            kept++;
     }
     
-    SDL_LockSurface(draw_surface);
+    if(!kept)
+        return;
     
-    for (int hy=0; hy<current_view->yres; hy++)
+    unsigned j = __atomic_fetch_add(&list->count, kept, __ATOMIC_RELAXED);
+    
+    for(unsigned i=0; i<count && j<list->capacity; i++)
     {
-        unsigned *dst_pixels = (unsigned *)draw_surface->pixels + (draw_surface->pitch >> 2) * hy;
+        if(worker->orbits.iterations[i] == kOrbitFinal)
+            continue;
         
-        if(histogram)
+        list->offsets[j]            = worker->offsets[i];
+        list->state.x[j]            = worker->orbits.x[i];
+        list->state.y[j]            = worker->orbits.y[i];
+        list->state.iterations[j]   = worker->orbits.iterations[i];
+        list->running[worker->offsets[i]] = 1;
+        j++;
+    }
+}
+
+// Iterates every queued pixel in one call so the vector kernel keeps its lanes
+// full, a call per short row or column spends most of its time waiting on the
+// slowest lane. c is the same with and without subdivision so both modes agree.
+void calcBatch(const FrameInfo *frame, const KernelOptions *options, WorkerContext *worker, KernelStats *stats)
+{
+    unsigned    count = worker->batch_count;
+
+#ifdef USE_BIGNUM
+    if(frame->flags & kUSE_BIGNUM)
+    {
+        for(unsigned i=0; i<count && !isKernelCancelled(options); i++)
         {
-            unsigned *src_pixels = &histogram[hy * current_view->xres];
+            unsigned offset = worker->offsets[i];
             
-            for (int hx=0; hx<current_view->xres; hx++)
-            {
-                RGB_Color rgb = genColorFromPalette(src_pixels[hx], histogram_max, current_palette);
-                
-                dst_pixels[hx] = SDL_MapRGBA(draw_surface->format,
-                                             rgb.r,
-                                             rgb.g,
-                                             rgb.b,
-                                             0);
-            }
+            frame->pixels[offset] = calcFramePixelBigNUM(frame, options, offset % frame->xres, offset / frame->xres,
+                                                         stats);
         }
-        else
+        
+        worker->batch_count = 0;
+        
+        return;
+    }
+#endif
+    
+    if(frame->flags & kUSE_ORBITS)
+    {
+        iterateDoubleOrbits(options, worker->cx, worker->cy, &worker->orbits, count, frame->itermax, worker->pixels, stats);
+        keepOrbits(frame, worker, count);
+    }
+    else
+    {
+        iterateFrame(frame, options, worker->cx, worker->cy, worker->cx_lo, worker->cy_lo, count, worker->pixels, stats);
+    }
+    
+#ifdef USE_BIGNUM
+    if(frame->flags & kUSE_ESCALATION)
+    {
+        for(unsigned i=0; i<count && !isKernelCancelled(options); i++)
         {
-            unsigned *src_pixels = &current_view->pixels[hy * current_view->xres];
-
-            for (int hx=0; hx<current_view->xres; hx++)
-            {
-                RGB_Color rgb = genColorFromPalette(src_pixels[hx], current_view->itermax, current_palette);
-                
-                dst_pixels[hx] = SDL_MapRGBA(draw_surface->format,
-                                             rgb.r,
-                                             rgb.g,
-                                             rgb.b,
-                                             0);
-            }
+            unsigned offset = worker->offsets[i];
+            
+            escalatePixel(frame, options, &worker->pixels[i], offset % frame->xres, offset / frame->xres, stats);
         }
     }
+#endif
     
-    SDL_UnlockSurface(draw_surface);
+    for(unsigned i=0; i<count; i++)
+    {
+        frame->pixels[worker->offsets[i]] = worker->pixels[i];
+    }
     
-    screen_surface = SDL_GetWindowSurface( window );
+    worker->batch_count = 0;
+}
+
+bool isBorderUniform(const FrameInfo *frame, const Rect *r)
+{
+    unsigned    xres    = frame->xres;
+    unsigned    *top    = &frame->pixels[r->y0 * xres];
+    unsigned    *bottom = &frame->pixels[r->y1 * xres];
+    unsigned    value   = top[r->x0];
     
-    SDL_SetSurfaceBlendMode(screen_surface, SDL_BLENDMODE_NONE);
+    for(unsigned x=r->x0; x<=r->x1; x++)
+    {
+        if(top[x] != value || bottom[x] != value)
+            return false;
+    }
     
-    SDL_BlitSurface(draw_surface, NULL,
-                    screen_surface, NULL);
+    for(unsigned y=r->y0+1; y<r->y1; y++)
+    {
+        if(frame->pixels[y * xres + r->x0] != value || frame->pixels[y * xres + r->x1] != value)
+            return false;
+    }
+    
+    return true;
 }
 
-bool runPaletteDialog(SDL_Window* window, SDL_Surface *draw_surface, ZoomView *current_view, Palette *current_palette)
+// kUSE_ORBITS, whether any pixel on the border of r was still running at itermax
+static bool isBorderRunning(const FrameInfo *frame, const Rect *r)
 {
-    SDL_Surface     *screen_surface;
-    SDL_Event       event;
-    bool            finished;
-    bool            update;
-    float           value[4];
-    unsigned        control_color;
+    const unsigned char *running = frame->orbits->running;
+    unsigned            xres = frame->xres;
     
-    finished        = false;
-    update          = true;
-    control_color   = 0;
+    for(unsigned x=r->x0; x<=r->x1; x++)
+    {
+        if(running[r->y0 * xres + x] || running[r->y1 * xres + x])
+            return true;
+    }
     
-    for(int i=0; i<4; i++)
+    for(unsigned y=r->y0+1; y<r->y1; y++)
     {
-        value[i] = current_palette->control_colors[i].v;
+        if(running[y * xres + r->x0] || running[y * xres + r->x1])
+            return true;
     }
     
-    while(!finished)
+    return false;
+}
+
+// r was filled with 0 from a border that was still running, once itermax goes
+// up its inside is subdivided again from the new border
+static void keepFilledRect(const FrameInfo *frame, const Rect *r)
+{
+    OrbitList   *list = frame->orbits;
+    unsigned    j = __atomic_fetch_add(&list->filled_count, 1, __ATOMIC_RELAXED);
+    
+    if(j < list->filled_capacity)
+        list->filled[j] = *r;
+}
+
+// Mariani-Silver: iterate the border of a rectangle, if every border pixel has the same
+// count fill the inside with it, otherwise iterate a cross through the middle and
+// handle the four quarters the same way. The set is connected so a border of
+// interior pixels always holds interior, for escape counts it is the usual heuristic.
+// A rectangle is done a level at a time so each level is a single calcBatch.
+// subdivideRect takes one whose border is done, at most a tile.
+static void subdivideRect(FrameInfo *frame, const Rect *rect, const KernelOptions *options, WorkerContext *worker,
+                          KernelStats *stats)
+{
+    Rect            *rects = worker->rects;
+    Rect            *next_rects = worker->rects + kSubdivisionMaxRects;
+    unsigned        rect_count = 1;
+    Rect            *r;
+    
+    rects[0] = *rect;
+    
+    while(rect_count && !isKernelCancelled(options))
     {
-        while(SDL_PollEvent(&event))
+        unsigned next_count = 0;
+        
+        for(unsigned i=0; i<rect_count; i++)
         {
-            switch(event.type)
+            r = &rects[i];
+            
+            unsigned w = r->x1 - r->x0 + 1;
+            unsigned h = r->y1 - r->y0 + 1;
+            
+            // nothing inside the border
+            if(w <= 2 || h <= 2)
+                continue;
+            
+            if(isBorderUniform(frame, r))
             {
-                case SDL_KEYDOWN:
+                unsigned value = frame->pixels[r->y0 * frame->xres + r->x0];
+                
+                for(unsigned y=r->y0+1; y<r->y1; y++)
                 {
-                    if(event.key.keysym.scancode == SDL_SCANCODE_P)
+                    unsigned *dst = &frame->pixels[y * frame->xres];
+                    
+                    for(unsigned x=r->x0+1; x<r->x1; x++)
                     {
-                        finished = 1;
+                        dst[x] = value;
                     }
-                    else if(event.key.keysym.scancode == SDL_SCANCODE_RIGHT)
-                    {
-                        value[control_color] += 0.1;
-                        
-                        if(value[control_color] > 1.0)
-                        {
-                            value[control_color] = 1.0;
-                        }
-                        
-                        current_palette->control_colors[control_color].v = value[control_color];
-                        update = true;
-                    }
-                    else if(event.key.keysym.scancode == SDL_SCANCODE_LEFT)
-                    {
-                        value[control_color] -= 0.1;
-                        
-                        if(value[control_color] < 0.0)
-                        {
-                            value[control_color] = 0.0;
-                        }
-                        
-                        current_palette->control_colors[control_color].v = value[control_color];
-                        update = true;
-                    }
-                    else if(event.key.keysym.scancode == SDL_SCANCODE_1)
-                    {
-                        control_color = 0;
-                        update = true;
-                    }
-                    else if(event.key.keysym.scancode == SDL_SCANCODE_2)
-                    {
-                        control_color = 1;
-                        update = true;
-                    }
-                    else if(event.key.keysym.scancode == SDL_SCANCODE_3)
-                    {
-                        control_color = 2;
-                        update = true;
-                    }
-                    else if(event.key.keysym.scancode == SDL_SCANCODE_4)
-                    {
-                        control_color = 3;
-                        update = true;
-                    }
-                    
-                    break;
-                }
-                    
-                case SDL_MOUSEMOTION:
-                    if(event.motion.state != SDL_PRESSED)
-                    {
-                        break;
-                    }
-                    
-                case SDL_MOUSEBUTTONDOWN:
-                {
-                    float mouse_x = (double)event.button.x;
-                    float mouse_y = (double)event.button.y;
-                    
-                    // figure out which circle it was in
-                    update = true;
-                    for(int control_circle=0; control_circle<4; control_circle++)
-                    {
-                        float cx = (2 * control_circle + 1) * current_view->xres / 8.0f;
-                        float cy = current_view->yres / 8.0f;
-                        
-                        float x = cx - mouse_x;
-                        float y = cy - mouse_y;
-                        
-                        float radius = current_view->xres / 12;
-                        float dist = sqrtf(x*x + y*y);
-                        
-                        if(dist <= radius)
-                        {
-                            if(control_color != control_circle)
-                            {
-                                control_color = control_circle;
-                                update = false;
-                            }
-                        }
-                    }
-                    
-                    if(update)
-                    {
-                        float cx = (2 * control_color + 1) * current_view->xres / 8.0f;
-                        float cy = current_view->yres / 8.0f;
-                        
-                        float x = cx - mouse_x;
-                        float y = cy - mouse_y;
-                        
-                        float radius = current_view->xres / 12;
-                        float dist = sqrtf(x*x + y*y);
-                        
-                        if(dist <= radius)
-                        {
-                            x /= dist;
-                            y /= dist;
-                            
-                            float theta = acosf(x) * 180.0 / M_PI;
-                            
-                            if (y < 0)
-                            {
-                                theta = 360 - theta;
-                            }
-                            
-                            current_palette->control_colors[control_color].h = theta;
-                            current_palette->control_colors[control_color].s = dist / radius;
-                            current_palette->control_colors[control_color].v = value[control_color];
-                        }
-                    }
-                    
-                    break;
                 }
-                    
-                case SDL_QUIT:
+                
+                if(!value && (frame->flags & kUSE_ORBITS) && isBorderRunning(frame, r))
                 {
-                    return true;
+                    keepFilledRect(frame, r);
                 }
-            }
-        }
-        
-        // draw base surface
-        if(update)
-        {
-            SDL_LockSurface(draw_surface);
-            
-            HSV_Color   hsv;
-            RGB_Color   rgb;
-            float       dist;
-            float       radius = current_view->xres / 12;
-            
-            current_palette->count = 256;
-            for (int i=0; i<256; i++)
-            {
-                float   u = (float)i / 255.0;
-                
-                hsv = genBezierColor(u, current_palette->control_colors);
-                rgb = HSV2RGB(hsv);
                 
-                current_palette->c[i].r = rgb.r * 255.0;
-                current_palette->c[i].g = rgb.g * 255.0;
-                current_palette->c[i].b = rgb.b * 255.0;
+                stats->subdivision_filled += (w - 2) * (h - 2);
             }
-            
-            // draw image
-            drawFractalImage(window, draw_surface, current_view, current_palette);
-            
-            // draw HSV palette
-            for (int hy=0; hy<32; hy++)
+            else if(w <= kSubdivisionMinSize || h <= kSubdivisionMinSize)
             {
-                unsigned *dst_pixels = (unsigned *)draw_surface->pixels + (draw_surface->pitch >> 2) * hy;
-                
-                for (int hx=0; hx<current_view->xres; hx++)
+                for(unsigned y=r->y0+1; y<r->y1; y++)
                 {
-                    float   u = (float)hx / (float)current_view->xres;
-                    HSV_Color hsv = genBezierColor(u, current_palette->control_colors);
-                    RGB_Color rgb = HSV2RGB(hsv);
-                    
-                    dst_pixels[hx] = SDL_MapRGBA(draw_surface->format,
-                                                 rgb.r * 255.0,
-                                                 rgb.g * 255.0,
-                                                 rgb.b * 255.0,
-                                                 0);
+                    for(unsigned x=r->x0+1; x<r->x1; x++)
+                    {
+                        addBatchPixel(frame, worker, x, y);
+                    }
                 }
             }
-            
-            // draw HSV control circles
-            for(int control_circle=0; control_circle<4; control_circle++)
+            else
             {
-                float   cx = (2 * control_circle + 1) * current_view->xres / 8.0f;
-                float   cy = current_view->yres / 8.0f;
+                unsigned xm = (r->x0 + r->x1) / 2;
+                unsigned ym = (r->y0 + r->y1) / 2;
                 
-                for (int hy=0; hy<current_view->yres; hy++)
+                // the cross through the middle, the column skips the pixel the row already has
+                for(unsigned x=r->x0+1; x<r->x1; x++)
                 {
-                    unsigned *dst_pixels = (unsigned *)draw_surface->pixels + (draw_surface->pitch >> 2) * hy;
-                    
-                    for (int hx=0; hx<current_view->xres; hx++)
-                    {
-                        float  x = cx - hx;
-                        float  y = cy - hy;
-                        
-                        dist = sqrtf(x*x + y*y);
-                        
-                        if(dist <= radius)
-                        {
-                            x /= dist;
-                            y /= dist;
-                            
-                            float theta = acosf(x) * 180.0 / M_PI;
-                            
-                            if (y < 0)
-                            {
-                                theta = 360 - theta;
-                            }
-                            
-                            hsv.h = theta;
-                            hsv.s = dist / radius;
-                            hsv.v = value[control_circle];
-                            
-                            rgb = HSV2RGB(hsv);
-                            
-                            dst_pixels[hx] = SDL_MapRGBA(draw_surface->format,
-                                                         rgb.r * 255.0,
-                                                         rgb.g * 255.0,
-                                                         rgb.b * 255.0,
-                                                         0);
-                        }
-                    }
+                    addBatchPixel(frame, worker, x, ym);
                 }
                 
+                for(unsigned y=r->y0+1; y<r->y1; y++)
+                {
+                    if(y != ym)
+                        addBatchPixel(frame, worker, xm, y);
+                }
                 
-                // draw hsv value in circle
-                hsv = current_palette->control_colors[control_circle];
-                
-                float x = cx + radius * cos(hsv.h / (180.0 / M_PI)) * hsv.s;
-                float y = cy + radius * sin(hsv.h / (180.0 / M_PI)) * hsv.s;
-                
-                unsigned *dst_pixels = (unsigned *)draw_surface->pixels + (draw_surface->pitch >> 2) * (int)y;
-                
-                dst_pixels[(int)x] = SDL_MapRGBA(draw_surface->format,
-                                                 0,
-                                                 0,
-                                                 0,
-                                                 0);
-                
-                SDL_UnlockSurface(draw_surface);
-                
-                SDL_SetSurfaceBlendMode(draw_surface, SDL_BLENDMODE_NONE);
-                
-                // blt the draw surface to the screen
-                screen_surface = SDL_GetWindowSurface( window );
-                SDL_SetSurfaceBlendMode(screen_surface, SDL_BLENDMODE_NONE);
-                
-                SDL_BlitSurface(draw_surface, NULL,
-                                screen_surface, NULL);
+                Rect quarters[4] = {
+                    { r->x0, r->y0, xm, ym },
+                    { xm, r->y0, r->x1, ym },
+                    { r->x0, ym, xm, r->y1 },
+                    { xm, ym, r->x1, r->y1 },
+                };
                 
-                update = false;
+                for(int q=0; q<4; q++)
+                {
+                    next_rects[next_count++] = quarters[q];
+                }
+            }
+        }
+        
+        calcBatch(frame, options, worker, stats);
+        
+        std::swap(rects, next_rects);
+        rect_count = next_count;
+    }
+}
+
+// a tile's border, then subdivideRect
+static void subdivideTile(TileInfo *tile, const KernelOptions *options, WorkerContext *worker, KernelStats *stats)
+{
+    FrameInfo       *frame = tile->frame;
+    Rect            *r = &tile->rect;
+    
+    // the tile border
+    for(unsigned x=r->x0; x<=r->x1; x++)
+    {
+        addBatchPixel(frame, worker, x, r->y0);
+        
+        if(r->y1 > r->y0)
+            addBatchPixel(frame, worker, x, r->y1);
+    }
+    
+    for(unsigned y=r->y0+1; y<r->y1; y++)
+    {
+        addBatchPixel(frame, worker, r->x0, y);
+        
+        if(r->x1 > r->x0)
+            addBatchPixel(frame, worker, r->x1, y);
+    }
+    
+    calcBatch(frame, options, worker, stats);
+    
+    subdivideRect(frame, &tile->rect, options, worker, stats);
+}
+
+void calcTile(void *arg, WorkerContext *worker)
+{
+    TileInfo        *tile = (TileInfo *)arg;
+    FrameInfo       *frame = tile->frame;
+    KernelOptions   options;
+    KernelStats     stats;
+    
+    tile->started = getSeconds();
+    
+    // stale, the frame was cancelled before the tile got its turn
+    if(isFrameCancelled(frame))
+    {
+        tile->finished = tile->started;
+        return;
+    }
+    
+    memset(&stats, 0, sizeof(stats));
+    
+    setFrameOptions(&options, frame);
+    
+    if(frame->flags & kUSE_SUBDIVISION)
+    {
+        subdivideTile(tile, &options, worker, &stats);
+    }
+    else
+    {
+        // the whole tile goes to the vector kernel in one batch, see simd_kernel.cpp
+        for(unsigned y=tile->rect.y0; y<=tile->rect.y1; y++)
+        {
+            for(unsigned x=tile->rect.x0; x<=tile->rect.x1; x++)
+            {
+                addBatchPixel(frame, worker, x, y);
+            }
+        }
+        
+        calcBatch(frame, &options, worker, &stats);
+    }
+    
+    addKernelStats(&g_frame_stats, &stats);
+    
+    tile->finished = getSeconds();
+    
+    if((frame->flags & kUSE_TILE_QUEUE) && !isFrameCancelled(frame) && pushTileQueue(frame->generation, &tile->rect))
+    {
+        wakeEventLoop();
+    }
+}
+
+// The part of the frame looked at comes first: with kUSE_FOCUS every task takes
+// whichever tile left is nearest g_render_focus when it runs, not one of its own.
+// The tiles are kept sorted farthest first so a task pops the last one, and the
+// rest are sorted again when the focus has moved since, so a mouse move reorders
+// the tiles still queued as well. With a cost map the tiles past kFocusRadius,
+// or all of them without kUSE_FOCUS, go longest first instead (LPT), so no long
+// tile is started late and holds up the end of the frame.
+typedef struct {
+    pthread_mutex_t lock;
+    TileInfo        *tiles;
+    unsigned        *order;         // indices into tiles, the next to take last
+    unsigned        count;          // tiles not taken yet
+    unsigned        focus;          // g_render_focus order was sorted for
+    bool            use_focus;
+    bool            use_cost;
+} TileSchedule;
+
+typedef struct {
+    unsigned        tier;           // 0 near the focus, 1 the rest
+    double          key;            // taken smallest first within a tier
+    unsigned        index;
+} TileRank;
+
+// greater first, so the tile to take next ends up last
+static bool compareTileRank(const TileRank &a, const TileRank &b)
+{
+    if(a.tier != b.tier)
+        return a.tier > b.tier;
+    if(a.key != b.key)
+        return a.key > b.key;
+    
+    return a.index > b.index;
+}
+
+static inline void setRenderFocus(unsigned x, unsigned y)
+{
+    __atomic_store_n(&g_render_focus, (std::min(x, 0xffffu) << 16) | std::min(y, 0xffffu), __ATOMIC_RELAXED);
+}
+
+static void sortTileSchedule(TileSchedule *schedule, unsigned focus)
+{
+    std::vector<TileRank>   ranks(schedule->count);
+    double                  focus_x = focus >> 16;
+    double                  focus_y = focus & 0xffff;
+    
+    for(unsigned i=0; i<schedule->count; i++)
+    {
+        const TileInfo  *tile = &schedule->tiles[schedule->order[i]];
+        double          dx = 0.5 * (tile->rect.x0 + tile->rect.x1) - focus_x;
+        double          dy = 0.5 * (tile->rect.y0 + tile->rect.y1) - focus_y;
+        double          distance = dx * dx + dy * dy;
+        TileRank        *rank = &ranks[i];
+        
+        rank->index = schedule->order[i];
+        
+        if(schedule->use_focus && (!schedule->use_cost || distance <= (double)kFocusRadius * kFocusRadius))
+        {
+            rank->tier  = 0;
+            rank->key   = distance;
+        }
+        else
+        {
+            rank->tier  = 1;
+            rank->key   = -tile->cost;
+        }
+    }
+    
+    // ties keep the curve order of getFrameTiles
+    std::sort(ranks.begin(), ranks.end(), compareTileRank);
+    
+    for(unsigned i=0; i<schedule->count; i++)
+    {
+        schedule->order[i] = ranks[i].index;
+    }
+    
+    schedule->focus = focus;
+}
+
+void calcFocusTile(void *arg, WorkerContext *worker)
+{
+    TileSchedule    *schedule = (TileSchedule *)arg;
+    unsigned        focus = __atomic_load_n(&g_render_focus, __ATOMIC_RELAXED);
+    TileInfo        *tile;
+    
+    pthread_mutex_lock(&schedule->lock);
+    
+    if(schedule->use_focus && focus != schedule->focus)
+    {
+        sortTileSchedule(schedule, focus);
+    }
+    
+    tile = &schedule->tiles[schedule->order[--schedule->count]];
+    
+    pthread_mutex_unlock(&schedule->lock);
+    
+    calcTile(tile, worker);
+}
+
+// Keeps the calling thread on cpu index, wrapped around when there are more threads
+// than cpus. Linux pins it outright, macOS only takes affinity tags as a hint to
+// keep threads with different tags on different L2s.
+static void pinCalcThread(unsigned index)
+{
+#if defined(__linux__)
+    cpu_set_t   set;
+    
+    CPU_ZERO(&set);
+    CPU_SET(index % std::min(sysconf(_SC_NPROCESSORS_ONLN), (long)CPU_SETSIZE), &set);
+    
+    if(pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+        printf("Could not pin calc thread %u\n", index);
+#elif defined(__APPLE__)
+    thread_affinity_policy_data_t policy = { (integer_t)index + 1 };
+    
+    thread_policy_set(pthread_mach_thread_np(pthread_self()), THREAD_AFFINITY_POLICY,
+                      (thread_policy_t)&policy, THREAD_AFFINITY_POLICY_COUNT);
+#endif
+}
+
+void *calcThread(void *ctx)
+{
+    WorkerContext   worker;
+    unsigned        index = (unsigned)(uintptr_t)ctx;
+    unsigned        len = kMaxTileSize * kMaxTileSize;
+    
+    worker.cx           = new double [len];
+    worker.cy           = new double [len];
+    worker.cx_lo        = new double [len];
+    worker.cy_lo        = new double [len];
+    worker.pixels       = new unsigned [len];
+    worker.offsets      = new unsigned [len];
+    worker.orbits.x     = new double [len];
+    worker.orbits.y     = new double [len];
+    worker.orbits.iterations = new unsigned [len];
+    worker.batch_count  = 0;
+    worker.rects        = new Rect [2 * kSubdivisionMaxRects];
+    
+    t_worker_index = index;
+    
+    if(g_pin_threads)
+        pinCalcThread(index);
+    
+    while(1)
+    {
+        unsigned    wake_count = __atomic_load_n(&g_work_pool.wake_count, __ATOMIC_SEQ_CST);
+        WorkItem    item;
+        
+        if(popWork(index, &item))
+        {
+            item.func(item.arg, &worker);
+            finishWork();
+            
+            continue;
+        }
+        
+        if(__atomic_load_n(&g_work_pool.quit, __ATOMIC_ACQUIRE))
+            break;
+        
+        // nothing anywhere, sleep unless something was pushed since the look
+        pthread_mutex_lock(&g_work_pool.sleep_lock);
+        __atomic_fetch_add(&g_work_pool.sleeping, 1, __ATOMIC_SEQ_CST);
+        
+        while(__atomic_load_n(&g_work_pool.wake_count, __ATOMIC_SEQ_CST) == wake_count)
+        {
+            pthread_cond_wait(&g_work_pool.wake, &g_work_pool.sleep_lock);
+        }
+        
+        __atomic_fetch_sub(&g_work_pool.sleeping, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&g_work_pool.sleep_lock);
+        
+        __atomic_fetch_add(&g_work_pool.sleeps, 1, __ATOMIC_RELAXED);
+    }
+    
+    delete [] worker.cx;
+    delete [] worker.cy;
+    delete [] worker.cx_lo;
+    delete [] worker.cy_lo;
+    delete [] worker.pixels;
+    delete [] worker.offsets;
+    delete [] worker.orbits.x;
+    delete [] worker.orbits.y;
+    delete [] worker.orbits.iterations;
+    delete [] worker.rects;
+    
+    return NULL;
+}
+
+// -threads, then MANDELBROT_THREADS, then one per cpu online
+unsigned getCalcThreadCount(void)
+{
+    long count = g_calc_threads;
+    
+    if(!count && getenv("MANDELBROT_THREADS"))
+        count = atoi(getenv("MANDELBROT_THREADS"));
+    
+    if(count <= 0)
+        count = sysconf(_SC_NPROCESSORS_ONLN);
+    
+    return (unsigned)std::min(std::max(count, 1L), (long)kMaxCalcThreads);
+}
+
+void startCalcThreads(unsigned count)
+{
+    for(unsigned i=0; i<count; i++)
+    {
+        WorkDeque *deque = &g_work_pool.deques[i];
+        
+        pthread_mutex_init(&deque->lock, NULL);
+        deque->items    = (WorkItem *)malloc(kWorkDequeSize * sizeof(WorkItem));
+        deque->size     = kWorkDequeSize;
+        deque->top      = 0;
+        deque->bottom   = 0;
+    }
+    
+    g_work_pool.thread_count = count;
+    g_work_pool.quit        = 0;
+    g_work_pool.next_deque  = 0;
+    g_work_pool.pending     = 0;
+    g_work_pool.wake_count  = 0;
+    g_work_pool.sleeping    = 0;
+    g_work_pool.steals      = 0;
+    g_work_pool.sleeps      = 0;
+    
+    pthread_mutex_init(&g_work_pool.sleep_lock, NULL);
+    pthread_cond_init(&g_work_pool.wake, NULL);
+    pthread_mutex_init(&g_work_pool.done_lock, NULL);
+    pthread_cond_init(&g_work_pool.done, NULL);
+    
+    for(unsigned i=0; i<count; i++)
+    {
+        pthread_create(&g_work_pool.threads[i], NULL, calcThread, (void *)(uintptr_t)i);
+    }
+}
+
+// lets the queued work finish and joins the threads, startCalcThreads can run again after
+void stopCalcThreads(void)
+{
+    waitForWork();
+    
+    pthread_mutex_lock(&g_work_pool.sleep_lock);
+    __atomic_store_n(&g_work_pool.quit, 1, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&g_work_pool.wake_count, 1, __ATOMIC_SEQ_CST);
+    pthread_cond_broadcast(&g_work_pool.wake);
+    pthread_mutex_unlock(&g_work_pool.sleep_lock);
+    
+    for(unsigned i=0; i<g_work_pool.thread_count; i++)
+    {
+        pthread_join(g_work_pool.threads[i], NULL);
+        
+        pthread_mutex_destroy(&g_work_pool.deques[i].lock);
+        free(g_work_pool.deques[i].items);
+    }
+    
+    pthread_mutex_destroy(&g_work_pool.sleep_lock);
+    pthread_cond_destroy(&g_work_pool.wake);
+    pthread_mutex_destroy(&g_work_pool.done_lock);
+    pthread_cond_destroy(&g_work_pool.done);
+    
+    g_work_pool.thread_count = 0;
+}
+
+// Frame buffers come straight from mmap, 2MB aligned and on huge pages where the
+// system has them. Nothing touches the pages here, so the first write, from the
+// calc thread that owns the tile, is what places them on its NUMA node.
+#define kHugePageSize           (2 * 1024 * 1024)
+
+unsigned *allocPixels(size_t count)
+{
+    size_t  size = (count * sizeof(unsigned) + kHugePageSize - 1) & ~(size_t)(kHugePageSize - 1);
+    void    *pixels = MAP_FAILED;
+    
+#ifdef __APPLE__
+    // superpages are x86 only and can run out, plain pages otherwise
+    pixels = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, VM_FLAGS_SUPERPAGE_SIZE_2MB, 0);
+#endif
+    
+    if(pixels == MAP_FAILED)
+        pixels = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+    
+    if(pixels == MAP_FAILED)
+        return NULL;
+    
+#ifdef MADV_HUGEPAGE
+    madvise(pixels, size, MADV_HUGEPAGE);
+#endif
+    
+    return (unsigned *)pixels;
+}
+
+void freePixels(unsigned *pixels, size_t count)
+{
+    size_t  size = (count * sizeof(unsigned) + kHugePageSize - 1) & ~(size_t)(kHugePageSize - 1);
+    
+    if(pixels)
+        munmap(pixels, size);
+}
+
+static void initOrbitList(OrbitList *list)
+{
+    memset(list, 0, sizeof(*list));
+}
+
+static void freeOrbitList(OrbitList *list)
+{
+    delete [] list->offsets;
+    delete [] list->state.x;
+    delete [] list->state.y;
+    delete [] list->state.iterations;
+    delete [] list->filled;
+    delete [] list->running;
+    
+    initOrbitList(list);
+}
+
+// room for count pixels and filled rectangles, what was in the list is dropped when it grows
+static void reserveOrbitList(OrbitList *list, unsigned count, unsigned filled)
+{
+    if(count > list->capacity)
+    {
+        delete [] list->offsets;
+        delete [] list->state.x;
+        delete [] list->state.y;
+        delete [] list->state.iterations;
+        
+        list->offsets           = new unsigned [count];
+        list->state.x           = new double [count];
+        list->state.y           = new double [count];
+        list->state.iterations  = new unsigned [count];
+        list->capacity          = count;
+        list->count             = 0;
+    }
+    
+    if(filled > list->filled_capacity)
+    {
+        delete [] list->filled;
+        
+        list->filled            = new Rect [filled];
+        list->filled_capacity   = filled;
+        list->filled_count      = 0;
+    }
+}
+
+static void copyOrbitList(OrbitList *dst, const OrbitList *src)
+{
+    reserveOrbitList(dst, src->count, src->filled_count);
+    
+    dst->count          = src->count;
+    dst->filled_count   = src->filled_count;
+    dst->itermax        = src->itermax;
+    
+    if(src->count)
+    {
+        memcpy(dst->offsets, src->offsets, src->count * sizeof(unsigned));
+        memcpy(dst->state.x, src->state.x, src->count * sizeof(double));
+        memcpy(dst->state.y, src->state.y, src->count * sizeof(double));
+        memcpy(dst->state.iterations, src->state.iterations, src->count * sizeof(unsigned));
+    }
+    
+    if(src->filled_count)
+    {
+        memcpy(dst->filled, src->filled, src->filled_count * sizeof(Rect));
+    }
+}
+
+// A frame's list starts empty, for a frame of xres x yres at itermax. Filled
+// rectangles are at least 3 x 3 and share no more than their borders.
+static void startOrbitList(OrbitList *list, unsigned xres, unsigned yres, unsigned itermax)
+{
+    reserveOrbitList(list, xres * yres, xres * yres / 4);
+    
+    if(!list->running)
+    {
+        list->running = new unsigned char [SCREEN_WIDTH * SCREEN_HEIGHT];
+    }
+    
+    memset(list->running, 0, xres * yres);
+    
+    list->count         = 0;
+    list->filled_count  = 0;
+    list->itermax       = itermax;
+}
+
+#ifdef USE_BIGNUM
+// each pass gives at most kGlitchReferences of the largest groups a reference,
+// and correctGlitches gives up after kGlitchPasses
+#define kGlitchPasses       16
+#define kGlitchReferences   32
+
+// secondary references, kept from frame to frame so their buffers are reused
+ReferenceOrbit      g_glitch_orbits[kGlitchReferences];
+BLATable            g_glitch_tables[kGlitchReferences];
+
+typedef struct {
+    FrameInfo       frame;          // the frame with a secondary reference
+    const unsigned  *offsets;       // at most a tile of pixels
+    unsigned        count;
+} PixelListInfo;
+
+void calcPixelList(void *arg, WorkerContext *worker)
+{
+    PixelListInfo   *list = (PixelListInfo *)arg;
+    FrameInfo       *frame = &list->frame;
+    KernelOptions   options;
+    KernelStats     stats;
+    
+    if(isFrameCancelled(frame))
+    {
+        free(list);
+        return;
+    }
+    
+    memset(&stats, 0, sizeof(stats));
+    
+    setFrameOptions(&options, frame);
+    
+    for(unsigned i=0; i<list->count; i++)
+    {
+        addBatchPixel(frame, worker, list->offsets[i] % frame->xres, list->offsets[i] / frame->xres);
+    }
+    
+    calcBatch(frame, &options, worker, &stats);
+    
+    addKernelStats(&g_frame_stats, &stats);
+    
+    free(list);
+}
+
+// The perturbation kernels flag pixels whose offset lost its precision against
+// the reference with kGlitchedPixel and the step they were found at. The pixels
+// of one glitch share that step, so they are grouped by it. Each of the largest
+// groups gets a reference at the member nearest its middle and only its pixels
+// are iterated again. That member can not glitch against itself, so a pass
+// always makes progress, whatever is left after kGlitchPasses keeps its step.
+// Only the count tiles just rendered are looked at, a worker's job is a small
+// part of its frame.
+void correctGlitches(FrameInfo *frame, const TileInfo *tiles, unsigned count)
+{
+    std::vector<unsigned>               glitched;
+    std::vector<unsigned long long>     keys;
+    std::vector<unsigned>               offsets;
+    unsigned                            passes = 0;
+    
+    for(unsigned t=0; t<count; t++)
+    {
+        const Rect *r = &tiles[t].rect;
+        
+        for(unsigned y=r->y0; y<=r->y1; y++)
+        {
+            for(unsigned x=r->x0; x<=r->x1; x++)
+            {
+                if(frame->pixels[y * frame->xres + x] & kGlitchedPixel)
+                    glitched.push_back(y * frame->xres + x);
+            }
+        }
+    }
+    
+    while(!glitched.empty() && passes < kGlitchPasses && !isFrameCancelled(frame))
+    {
+        std::vector<std::pair<unsigned, unsigned> > groups;    // size, start in keys
+        
+        // sorted by value and then offset every group is a run
+        keys.clear();
+        
+        for(size_t i=0; i<glitched.size(); i++)
+        {
+            keys.push_back((unsigned long long)frame->pixels[glitched[i]] << 32 | glitched[i]);
+        }
+        
+        std::sort(keys.begin(), keys.end());
+        
+        for(size_t i=0, start=0; i<=keys.size(); i++)
+        {
+            if(i == keys.size() || (keys[i] >> 32) != (keys[start] >> 32))
+            {
+                groups.push_back(std::make_pair((unsigned)(i - start), (unsigned)start));
+                start = i;
+            }
+        }
+        
+        std::sort(groups.begin(), groups.end(), std::greater<std::pair<unsigned, unsigned> >());
+        
+        unsigned references = std::min((unsigned)groups.size(), (unsigned)kGlitchReferences);
+        
+        // the pixel lists have to stay put until the pass is done
+        offsets.resize(keys.size());
+        
+        for(unsigned r=0; r<references; r++)
+        {
+            unsigned    size = groups[r].first;
+            unsigned    *members = &offsets[groups[r].second];
+            double      mid_x = 0.0, mid_y = 0.0;
+            unsigned    best = 0;
+            double      best_distance = INFINITY;
+            
+            for(unsigned i=0; i<size; i++)
+            {
+                members[i] = (unsigned)keys[groups[r].second + i];
+                mid_x += members[i] % frame->xres;
+                mid_y += members[i] / frame->xres;
+            }
+            
+            mid_x /= size;
+            mid_y /= size;
+            
+            for(unsigned i=0; i<size; i++)
+            {
+                double x = members[i] % frame->xres - mid_x;
+                double y = members[i] / frame->xres - mid_y;
+                
+                if(x*x+y*y < best_distance)
+                {
+                    best_distance = x*x+y*y;
+                    best = members[i];
+                }
+            }
+            
+            // the reference at pixel best, its orbit is added up in gmp like calcPixelBigNUM
+            FrameInfo   group = *frame;
+            double      fx = (double)(best % frame->xres)/frame->xres;
+            double      fy = (double)(best / frame->xres)/frame->yres;
+            
+            computeReferenceOrbit(&g_glitch_orbits[r], frame->center_x_mp, frame->center_y_mp,
+                                  3.0*(fx-0.5)/frame->zoom.m, 3.0*(fy-0.5)/frame->zoom.m, -frame->zoom.e,
+                                  frame->precision, frame->itermax);
+            
+            group.reference     = &g_glitch_orbits[r];
+            group.reference_x   = fx;
+            group.reference_y   = fy;
+            
+            // offsets from a reference off center reach across the whole frame
+            if(frame->bla)
+            {
+                buildBLATable(&g_glitch_tables[r], group.reference, floatExpScale(getMaxPixelOffset(frame->zoom), 1),
+                              g_bla_epsilon);
+                
+                group.bla = &g_glitch_tables[r];
+            }
+            
+            for(unsigned i=0; i<size; i+=kDefaultTileSize*kDefaultTileSize)
+            {
+                PixelListInfo *list = (PixelListInfo *)malloc(sizeof(PixelListInfo));
+                
+                list->frame     = group;
+                list->offsets   = members + i;
+                list->count     = std::min(size - i, (unsigned)(kDefaultTileSize*kDefaultTileSize));
+                
+                pushWork(calcPixelList, list);
+            }
+        }
+        
+        waitForFrame();
+        
+        g_frame_stats.glitch_references += references;
+        g_frame_stats.glitch_passes++;
+        passes++;
+        
+        // the groups left out this pass are still flagged as well
+        offsets.clear();
+        
+        for(size_t i=0; i<glitched.size(); i++)
+        {
+            if(frame->pixels[glitched[i]] & kGlitchedPixel)
+                offsets.push_back(glitched[i]);
+        }
+        
+        glitched.swap(offsets);
+    }
+    
+    for(size_t i=0; i<glitched.size(); i++)
+    {
+        frame->pixels[glitched[i]] &= ~kGlitchedPixel;
+    }
+    
+    g_frame_stats.glitch_unresolved += glitched.size();
+}
+#endif
+
+// frame center from the view's mpf one, the doubles are rounded from it
+static void setFrameCenter(FrameInfo *frame, mpf_srcptr center_x, mpf_srcptr center_y)
+{
+    frame->center_x_mp  = center_x;
+    frame->center_y_mp  = center_y;
+    frame->center_x     = mpf_get_d(center_x);
+    frame->center_y     = mpf_get_d(center_y);
+    
+    mpf_t rest;
+    
+    mpf_init2(rest, mpf_get_prec(center_x) + mpf_get_prec(center_y));
+    
+    mpf_set_d(rest, frame->center_x);
+    mpf_sub(rest, center_x, rest);
+    frame->center_x_lo  = mpf_get_d(rest);
+    
+    mpf_set_d(rest, frame->center_y);
+    mpf_sub(rest, center_y, rest);
+    frame->center_y_lo  = mpf_get_d(rest);
+    
+    mpf_clear(rest);
+}
+
+// cell d of a Hilbert curve filling an n x n grid, n a power of two
+static void getHilbertCell(unsigned n, unsigned d, unsigned *x, unsigned *y)
+{
+    *x = 0;
+    *y = 0;
+    
+    for(unsigned s=1; s<n; s*=2)
+    {
+        unsigned rx = 1 & (d / 2);
+        unsigned ry = 1 & (d ^ rx);
+        
+        // rotate the quadrant so the curve comes in where the last one left
+        if(ry == 0)
+        {
+            if(rx == 1)
+            {
+                *x = s - 1 - *x;
+                *y = s - 1 - *y;
+            }
+            
+            std::swap(*x, *y);
+        }
+        
+        *x += s * rx;
+        *y += s * ry;
+        d /= 4;
+    }
+}
+
+// cell d of the Z curve, x from the even bits of d and y from the odd ones
+static void getMortonCell(unsigned d, unsigned *x, unsigned *y)
+{
+    *x = 0;
+    *y = 0;
+    
+    for(unsigned bit=0; d; bit++, d/=4)
+    {
+        *x |= (d & 1) << bit;
+        *y |= ((d >> 1) & 1) << bit;
+    }
+}
+
+// fills tiles with the frame's tiles in order, the curves run over the next power
+// of two square and skip the cells past the frame
+static unsigned getFrameTiles(FrameInfo *frame, unsigned size, unsigned order, TileInfo *tiles)
+{
+    unsigned    columns = (frame->xres + size - 1) / size;
+    unsigned    rows = (frame->yres + size - 1) / size;
+    unsigned    n = 1;
+    unsigned    count = 0;
+    
+    while(n < columns || n < rows)
+        n *= 2;
+    
+    for(unsigned d=0; d<(order == kTileOrderRows ? columns * rows : n * n); d++)
+    {
+        unsigned x, y;
+        
+        if(order == kTileOrderHilbert)
+            getHilbertCell(n, d, &x, &y);
+        else if(order == kTileOrderMorton)
+            getMortonCell(d, &x, &y);
+        else
+            x = d % columns, y = d / columns;
+        
+        if(x >= columns || y >= rows)
+            continue;
+        
+        TileInfo *tile = &tiles[count++];
+        
+        tile->frame     = frame;
+        tile->rect.x0   = x * size;
+        tile->rect.y0   = y * size;
+        tile->rect.x1   = std::min((x + 1) * size, frame->xres) - 1;
+        tile->rect.y1   = std::min((y + 1) * size, frame->yres) - 1;
+        tile->started   = 0.0;
+        tile->finished  = 0.0;
+        tile->cost      = 0.0;
+    }
+    
+    return count;
+}
+
+// iterations frame->cost predicts for the pixels of r
+static double getRectCost(const FrameInfo *frame, const Rect *r)
+{
+    double cost = 0.0;
+    
+    for(unsigned y=r->y0; y<=r->y1; y++)
+    {
+        const float *row = &frame->cost[(y / kCostCell) * kCostColumns];
+        
+        for(unsigned x=r->x0; x<=r->x1; x++)
+        {
+            cost += row[x / kCostCell];
+        }
+    }
+    
+    return cost;
+}
+
+// Quarters the tiles frame->cost says are heavy until they are not or are down to
+// kMinTileSize, the extra quarters go on the end. There is room: tiles cover the
+// frame once and kMaxTileCount of the smallest do that. Returns the new count.
+static unsigned splitHeavyTiles(FrameInfo *frame, TileInfo *tiles, unsigned count, unsigned threads)
+{
+    double total = 0.0;
+    
+    for(unsigned i=0; i<count; i++)
+    {
+        tiles[i].cost = getRectCost(frame, &tiles[i].rect);
+        total += tiles[i].cost;
+    }
+    
+    double limit = total / (threads * kCostSplitShare);
+    
+    for(unsigned i=0; i<count; i++)
+    {
+        while(tiles[i].cost > limit && tiles[i].rect.x1 - tiles[i].rect.x0 + 1 >= 2 * kMinTileSize &&
+              tiles[i].rect.y1 - tiles[i].rect.y0 + 1 >= 2 * kMinTileSize)
+        {
+            Rect        r = tiles[i].rect;
+            unsigned    mx = r.x0 + (r.x1 - r.x0 + 1) / 2;
+            unsigned    my = r.y0 + (r.y1 - r.y0 + 1) / 2;
+            Rect        quarters[4] = {
+                { r.x0, r.y0, mx - 1, my - 1 }, { mx, r.y0, r.x1, my - 1 },
+                { r.x0, my, mx - 1, r.y1 },     { mx, my, r.x1, r.y1 }
+            };
+            
+            for(unsigned q=0; q<4; q++)
+            {
+                TileInfo *tile = q ? &tiles[count++] : &tiles[i];
+                
+                *tile       = tiles[i];
+                tile->rect  = quarters[q];
+                tile->cost  = getRectCost(frame, &quarters[q]);
+            }
+        }
+    }
+    
+    return count;
+}
+
+// offset * zoom * res / 3.0, an mpf offset in pixels of a frame res across at
+// zoom, the exponents are added apart so neither runs out of the double range
+static double getOffsetPixels(mpf_srcptr offset, FloatExp zoom, unsigned res)
+{
+    long    exponent;
+    double  mantissa = mpf_get_d_2exp(&exponent, offset);
+    
+    return floatExpToDouble(makeFloatExp(mantissa * zoom.m * res / 3.0, zoom.e + (int)exponent));
+}
+
+// Fills cost with what a pixel of view should take in each kCostCell square, from
+// the last frame of source: the view itself if it has one, else the view it was
+// zoomed in or moved from. A square is sampled at 2x2 points mapped into source,
+// escaped pixels cost their count and the rest view's itermax. Squares source
+// does not cover get the average of those it does. False when there is nothing
+// to go on.
+bool estimateViewCost(const ZoomView *view, const ZoomView *source, float *cost)
+{
+    if(!source || !source->pixels_itermax)
+        return false;
+    
+    mpf_t       offset;
+    double      offset_x, offset_y;
+    double      scale = floatExpToDouble(makeFloatExp(source->zoom.m * source->xres / (view->zoom.m * view->xres),
+                                                      source->zoom.e - view->zoom.e));
+    double      known = 0.0;
+    unsigned    known_count = 0;
+    
+    // view's center in source pixels from source's, the mpf difference keeps it at depth
+    mpf_init2(offset, mpf_get_prec(view->center_x_mp));
+    mpf_sub(offset, view->center_x_mp, source->center_x_mp);
+    offset_x = getOffsetPixels(offset, source->zoom, source->xres) + 0.5 * source->xres;
+    mpf_sub(offset, view->center_y_mp, source->center_y_mp);
+    offset_y = getOffsetPixels(offset, source->zoom, source->yres) + 0.5 * source->yres;
+    mpf_clear(offset);
+    
+    for(unsigned cy=0; cy<kCostRows; cy++)
+    {
+        for(unsigned cx=0; cx<kCostColumns; cx++)
+        {
+            double      sum = 0.0;
+            unsigned    samples = 0;
+            
+            for(unsigned s=0; s<4; s++)
+            {
+                double  x = cx * kCostCell + (s & 1 ? 0.75 : 0.25) * kCostCell;
+                double  y = cy * kCostCell + (s & 2 ? 0.75 : 0.25) * kCostCell;
+                double  sx = offset_x + (x - 0.5 * view->xres) * scale;
+                double  sy = offset_y + (y - 0.5 * view->yres) * scale;
+                
+                if(sx < 0.0 || sy < 0.0 || sx >= source->xres || sy >= source->yres)
+                    continue;
+                
+                unsigned count = source->pixels[(unsigned)sy * source->xres + (unsigned)sx];
+                
+                sum += count ? std::min(count, view->itermax) : view->itermax;
+                samples++;
+            }
+            
+            cost[cy * kCostColumns + cx] = samples ? sum / samples : -1.0f;
+            
+            if(samples)
+            {
+                known += sum / samples;
+                known_count++;
+            }
+        }
+    }
+    
+    if(!known_count)
+        return false;
+    
+    for(unsigned i=0; i<kCostColumns * kCostRows; i++)
+    {
+        if(cost[i] < 0.0f)
+            cost[i] = known / known_count;
+    }
+    
+    return true;
+}
+
+// iterations the pixels of r add up to, interior ones at itermax
+static double getRectIterations(const FrameInfo *frame, const Rect *r)
+{
+    double iterations = 0.0;
+    
+    for(unsigned y=r->y0; y<=r->y1; y++)
+    {
+        for(unsigned x=r->x0; x<=r->x1; x++)
+        {
+            unsigned count = frame->pixels[y * frame->xres + x];
+            
+            iterations += count ? count : frame->itermax;
+        }
+    }
+    
+    return iterations;
+}
+
+// Pearson's r of n pairs from their sums into dst, "n/a" when either side is the
+// same for every pair, a single tile or a parent frame that predicts them all alike
+static void formatCorrelation(char *dst, size_t size, unsigned n, double sum_a, double sum_b, double sum_aa,
+                              double sum_bb, double sum_ab)
+{
+    double var_a = n * sum_aa - sum_a * sum_a;
+    double var_b = n * sum_bb - sum_b * sum_b;
+    
+    // what is left of a zero variance after the rounding of the sums
+    if(!(var_a > 1e-9 * n * sum_aa) || !(var_b > 1e-9 * n * sum_bb))
+        snprintf(dst, size, "n/a");
+    else
+        snprintf(dst, size, "%.2f", (n * sum_ab - sum_a * sum_b) / sqrt(var_a * var_b));
+}
+
+// Predicted against actual for the tiles of a finished frame. The actual cost is
+// the tile's time and the iterations its pixels add up to, which leaves out what
+// periodicity and subdivision saved. The correlation is over all the tiles, every
+// tile is listed with -log-tile-cost.
+static void logTileCosts(const FrameInfo *frame, const TileInfo *tiles, unsigned count, unsigned unsplit)
+{
+    double      sum_p = 0.0, sum_i = 0.0, sum_t = 0.0;
+    double      sum_pp = 0.0, sum_ii = 0.0, sum_tt = 0.0, sum_pi = 0.0, sum_pt = 0.0;
+    
+    for(unsigned i=0; i<count; i++)
+    {
+        const Rect  *r = &tiles[i].rect;
+        double      predicted = tiles[i].cost;
+        double      seconds = tiles[i].finished - tiles[i].started;
+        double      iterations = getRectIterations(frame, r);
+        
+        if(g_log_tile_cost)
+        {
+            printf("    tile %4u,%-4u %3ux%-3u predicted %12.0f iterations, pixels add up to %12.0f, %8.3fms\n",
+                   r->x0, r->y0, r->x1 - r->x0 + 1, r->y1 - r->y0 + 1, predicted, iterations, 1e3 * seconds);
+        }
+        
+        sum_p += predicted, sum_i += iterations, sum_t += seconds;
+        sum_pp += predicted * predicted, sum_ii += iterations * iterations, sum_tt += seconds * seconds;
+        sum_pi += predicted * iterations, sum_pt += predicted * seconds;
+    }
+    
+    char    r_i[16], r_t[16];
+    
+    formatCorrelation(r_i, sizeof(r_i), count, sum_p, sum_i, sum_pp, sum_ii, sum_pi);
+    formatCorrelation(r_t, sizeof(r_t), count, sum_p, sum_t, sum_pp, sum_tt, sum_pt);
+    
+    printf("Cost model: %u tiles split from %u, predicted %.3g iterations against %.3g in the pixels, "
+           "correlation %s with the pixels and %s with the tile times\n", count, unsplit, sum_p, sum_i, r_i, r_t);
+}
+
+// Renders the count tiles of frame on the calc threads one tile a task, tiles
+// holds kMaxTileCount. False when the frame was cancelled, its pixels are then
+// only partly written. generation is g_render_generation when the frame was
+// asked for, if a cancel came in since then the tiles are skipped and it returns
+// false straight away.
+bool renderTilesCPU(FrameInfo *frame, TileInfo *tiles, unsigned count, unsigned generation)
+{
+    frame->generation  = generation;
+    frame->dc_exponent = (frame->flags & kUSE_FLOATEXP) ? -frame->zoom.e : 0;
+    frame->precision   = getPrecisionBits(frame->zoom, frame->xres);
+#ifdef USE_BIGNUM
+    frame->fixed.limbs = 0;
+    
+    if((frame->flags & (kUSE_BIGNUM | kUSE_ESCALATION)) && getFixedPointLimbs(frame->precision))
+    {
+        setFixedPointCenter(&frame->fixed, getFixedPointLimbs(frame->precision), frame->center_x_mp, frame->center_y_mp);
+    }
+#endif
+    
+    unsigned        unsplit = count;
+    TileSchedule    schedule;
+    
+    if(frame->cost)
+    {
+        count = splitHeavyTiles(frame, tiles, count, g_work_pool.thread_count);
+    }
+    
+    frame->tile_count = count;
+    
+    if(frame->flags & kUSE_FOCUS || frame->cost)
+    {
+        pthread_mutex_init(&schedule.lock, NULL);
+        schedule.tiles      = tiles;
+        schedule.order      = new unsigned [count];
+        schedule.count      = count;
+        schedule.use_focus  = frame->flags & kUSE_FOCUS;
+        schedule.use_cost   = frame->cost != NULL;
+        
+        for(unsigned i=0; i<count; i++)
+        {
+            schedule.order[i] = i;
+        }
+        
+        sortTileSchedule(&schedule, __atomic_load_n(&g_render_focus, __ATOMIC_RELAXED));
+        
+        // one task a tile, which tile is up to calcFocusTile
+        for(unsigned i=0; i<count; i++)
+        {
+            pushWork(calcFocusTile, &schedule);
+        }
+    }
+    else
+    {
+        // backwards, the threads pop their newest first and so walk the curve forwards
+        for(unsigned i=count; i>0; i--)
+        {
+            pushWork(calcTile, &tiles[i - 1]);
+        }
+    }
+    
+    waitForFrame();
+    
+    if(frame->flags & kUSE_FOCUS || frame->cost)
+    {
+        pthread_mutex_destroy(&schedule.lock);
+        delete [] schedule.order;
+    }
+    
+    if(frame->cost && !isFrameCancelled(frame))
+    {
+        logTileCosts(frame, tiles, count, unsplit);
+    }
+    
+#ifdef USE_BIGNUM
+    if((frame->flags & kUSE_GLITCH_CORRECTION) && !isFrameCancelled(frame))
+    {
+        correctGlitches(frame, tiles, count);
+    }
+#endif
+    
+    return !isFrameCancelled(frame);
+}
+
+// all of frame in getFrameTiles order
+bool renderFrameCPUAt(FrameInfo *frame, TileInfo *tiles, unsigned generation)
+{
+    return renderTilesCPU(frame, tiles, getFrameTiles(frame, g_tile_size, g_tile_order, tiles), generation);
+}
+
+bool renderFrameCPU(FrameInfo *frame, TileInfo *tiles)
+{
+    return renderFrameCPUAt(frame, tiles, __atomic_load_n(&g_render_generation, __ATOMIC_RELAXED));
+}
+
+// A frame whose view moved shift_x,shift_y whole pixels from the one of from, at
+// the same zoom: pixel x,y is pixel x + shift_x, y + shift_y of from. What both
+// cover is copied into frame->pixels and overlap says where. tiles gets the
+// getFrameTiles tiles that are not all copied, cut down to the rows or columns
+// the move exposed, a corner tile stays whole. Returns the tile count.
+static unsigned setPanFrame(FrameInfo *frame, const unsigned *from, int shift_x, int shift_y, unsigned size,
+                            unsigned order, TileInfo *tiles, Rect *overlap)
+{
+    unsigned    xres = frame->xres, yres = frame->yres;
+    unsigned    dx = abs(shift_x), dy = abs(shift_y);
+    unsigned    count = getFrameTiles(frame, size, order, tiles);
+    unsigned    kept = 0;
+    
+    overlap->x0 = shift_x < 0 ? dx : 0;
+    overlap->y0 = shift_y < 0 ? dy : 0;
+    overlap->x1 = overlap->x0 + xres - dx - 1;
+    overlap->y1 = overlap->y0 + yres - dy - 1;
+    
+    for(unsigned y=overlap->y0; y<=overlap->y1; y++)
+    {
+        memcpy(&frame->pixels[y * xres + overlap->x0], &from[(y + shift_y) * xres + overlap->x0 + shift_x],
+               (xres - dx) * sizeof(unsigned));
+    }
+    
+    // the overlap reaches two edges of the frame, what is past it is on one side
+    for(unsigned i=0; i<count; i++)
+    {
+        Rect    *r = &tiles[i].rect;
+        bool    inside_x = r->x0 >= overlap->x0 && r->x1 <= overlap->x1;
+        bool    inside_y = r->y0 >= overlap->y0 && r->y1 <= overlap->y1;
+        
+        if(inside_x && inside_y)
+            continue;
+        
+        if(inside_x)
+        {
+            if(r->y0 < overlap->y0)
+                r->y1 = std::min(r->y1, overlap->y0 - 1);
+            else
+                r->y0 = std::max(r->y0, overlap->y1 + 1);
+        }
+        else if(inside_y)
+        {
+            if(r->x0 < overlap->x0)
+                r->x1 = std::min(r->x1, overlap->x0 - 1);
+            else
+                r->x0 = std::max(r->x0, overlap->x1 + 1);
+        }
+        
+        tiles[kept++] = tiles[i];
+    }
+    
+    return kept;
+}
+
+// a run of a resumed list, at most a tile of pixels or of filled rectangles
+typedef struct {
+    FrameInfo       *frame;
+    const OrbitList *list;
+    unsigned        start, count;
+} OrbitChunk;
+
+#define kOrbitChunkSize     (kDefaultTileSize * kDefaultTileSize)
+
+void calcOrbitChunk(void *arg, WorkerContext *worker)
+{
+    OrbitChunk      *chunk = (OrbitChunk *)arg;
+    FrameInfo       *frame = chunk->frame;
+    const OrbitList *list = chunk->list;
+    KernelOptions   options;
+    KernelStats     stats;
+    
+    if(isFrameCancelled(frame))
+        return;
+    
+    memset(&stats, 0, sizeof(stats));
+    
+    setFrameOptions(&options, frame);
+    
+    for(unsigned i=0; i<chunk->count; i++)
+    {
+        unsigned j = chunk->start + i;
+        
+        addBatchPixel(frame, worker, list->offsets[j] % frame->xres, list->offsets[j] / frame->xres);
+        
+        worker->orbits.x[i]             = list->state.x[j];
+        worker->orbits.y[i]             = list->state.y[j];
+        worker->orbits.iterations[i]    = list->state.iterations[j];
+    }
+    
+    calcBatch(frame, &options, worker, &stats);
+    
+    addKernelStats(&g_frame_stats, &stats);
+}
+
+void calcFilledChunk(void *arg, WorkerContext *worker)
+{
+    OrbitChunk      *chunk = (OrbitChunk *)arg;
+    FrameInfo       *frame = chunk->frame;
+    const OrbitList *list = chunk->list;
+    KernelOptions   options;
+    KernelStats     stats;
+    
+    if(isFrameCancelled(frame))
+        return;
+    
+    memset(&stats, 0, sizeof(stats));
+    
+    setFrameOptions(&options, frame);
+    
+    for(unsigned i=0; i<chunk->count; i++)
+    {
+        const Rect *r = &list->filled[chunk->start + i];
+        
+        if(frame->flags & kUSE_SUBDIVISION)
+        {
+            subdivideRect(frame, r, &options, worker, &stats);
+            continue;
+        }
+        
+        for(unsigned y=r->y0+1; y<r->y1; y++)
+        {
+            for(unsigned x=r->x0+1; x<r->x1; x++)
+            {
+                addBatchPixel(frame, worker, x, y);
+            }
+        }
+        
+        calcBatch(frame, &options, worker, &stats);
+    }
+    
+    addKernelStats(&g_frame_stats, &stats);
+}
+
+// Carries the pixels of list on from where they stopped at a lower itermax to
+// the frame's. Only their offsets in frame->pixels are written, every other
+// pixel escaped or was interior and is final, it stays what the view has. The
+// rectangles subdivision filled with interior are done again from their new
+// borders. The pixels still running after that go to frame->orbits, which has
+// kUSE_ORBITS.
+bool resumeFrame(FrameInfo *frame, const OrbitList *list, unsigned generation)
+{
+    unsigned    count = (list->count + kOrbitChunkSize - 1) / kOrbitChunkSize;
+    OrbitChunk  *chunks = new OrbitChunk [count + list->filled_count];
+    unsigned    filled = 0;
+    
+    frame->generation = generation;
+    
+    for(unsigned i=0; i<count; i++)
+    {
+        chunks[i].frame = frame;
+        chunks[i].list  = list;
+        chunks[i].start = i * kOrbitChunkSize;
+        chunks[i].count = std::min(list->count - chunks[i].start, (unsigned)kOrbitChunkSize);
+        
+        pushWork(calcOrbitChunk, &chunks[i]);
+    }
+    
+    // the borders of the filled rectangles are among the pixels above
+    waitForFrame();
+    
+    for(unsigned i=0; i<list->filled_count && !isFrameCancelled(frame); filled++)
+    {
+        OrbitChunk  *chunk = &chunks[count + filled];
+        unsigned    area = 0;
+        
+        chunk->frame = frame;
+        chunk->list  = list;
+        chunk->start = i;
+        
+        for(; i<list->filled_count && area < kOrbitChunkSize; i++)
+        {
+            const Rect *r = &list->filled[i];
+            
+            area += (r->x1 - r->x0 + 1) * (r->y1 - r->y0 + 1);
+        }
+        
+        chunk->count = i - chunk->start;
+        
+        pushWork(calcFilledChunk, chunk);
+    }
+    
+    waitForFrame();
+    
+    frame->tile_count = count + filled;
+    
+    delete [] chunks;
+    
+    return !isFrameCancelled(frame);
+}
+
+#ifdef USE_BIGNUM
+// bignum vs perturbation renders of a few deep views, the bignum frames are
+// small to keep the run short. The last view is past the double range, at the
+// spiral around c = i, which is on the boundary however deep and exact in a
+// double, and takes floatexp offsets throughout.
+void benchmarkPerturbation(void)
+{
+    static const struct {
+        const char  *name;
+        double      center_x, center_y, zoom;
+        int         zoom_exponent;      // zoom is times 2^zoom_exponent
+        unsigned    itermax;
+    } views[] = {
+        { "seahorse 1e6",   -0.743643887037151, 0.131825904205330,  1e6,    0,      2048 },
+        { "seahorse 1e10",  -0.743643887037151, 0.131825904205330,  1e10,   0,      4096 },
+        { "elephant 1e8",   0.2925755,          -0.0149977,         1e8,    0,      4096 },
+        { "seahorse 1e20",  -0.743643887037151, 0.131825904205330,  1e20,   0,      16384 },
+        { "i 1.4e331",      0.0,                1.0,                1.0,    1100,   2048 },
+    };
+    const unsigned  bignum_res = 128;
+    TileInfo        *tiles = new TileInfo [kMaxTileCount];
+    unsigned        *reference = new unsigned [SCREEN_WIDTH * SCREEN_HEIGHT];
+    unsigned        *pixels = new unsigned [SCREEN_WIDTH * SCREEN_HEIGHT];
+    ReferenceOrbit  orbit;
+    BLATable        bla;
+    mpf_t           center_x, center_y;
+    
+    initReferenceOrbit(&orbit);
+    initBLATable(&bla);
+    mpf_init2(center_x, 64);
+    mpf_init2(center_y, 64);
+    
+    printf("Perturbation benchmark, %s kernel\n", getSIMDLevelName(getSIMDLevel()));
+    
+    for(unsigned i=0; i<sizeof(views)/sizeof(*views); i++)
+    {
+        FrameInfo   frame;
+        unsigned    floatexp;
+        
+        mpf_set_d(center_x, views[i].center_x);
+        mpf_set_d(center_y, views[i].center_y);
+        
+        setFrameCenter(&frame, center_x, center_y);
+        frame.zoom      = makeFloatExp(views[i].zoom, views[i].zoom_exponent);
+        frame.itermax   = views[i].itermax;
+        frame.reference = &orbit;
+        frame.bla       = NULL;
+        frame.cost      = NULL;
+        frame.reference_x = frame.reference_y = 0.5;
+        
+        // past kFloatExpZoom even the plain perturbation frames need it
+        floatexp = floatExpCompare(frame.zoom, floatExpFromDouble(kFloatExpZoom)) > 0 ? kUSE_FLOATEXP : 0;
+        
+        // at the bits of the full size frame, the small ones need fewer
+        computeReferenceOrbit(&orbit, center_x, center_y, 0.0, 0.0, 0,
+                              getPrecisionBits(frame.zoom, SCREEN_WIDTH), frame.itermax);
+        buildBLATable(&bla, &orbit, getMaxPixelOffset(frame.zoom), g_bla_epsilon);
+        
+        printf("    %-14s reference %u iterations at %u bits in %.3fs, BLA table %u levels %zu bytes in %.3fs\n",
+               views[i].name, orbit.length, orbit.precision, orbit.elapsed, bla.levels, bla.bytes, bla.elapsed);
+        
+        for(int res=0; res<2; res++)
+        {
+            double  elapsed[2] = { 0.0, 0.0 };
+            
+            frame.xres = frame.yres = res ? SCREEN_WIDTH : bignum_res;
+            
+            // the full size frame is only timed with perturbation
+            for(int perturb=res; perturb<2; perturb++)
+            {
+                memset(&g_frame_stats, 0, sizeof(g_frame_stats));
+                
+                frame.flags     = kUSE_SUBDIVISION | (perturb ? kUSE_PERTURBATION | floatexp : kUSE_BIGNUM);
+                frame.pixels    = perturb ? pixels : reference;
+                
+                // the full size frames are compared with each other, corrected
+                if(res)
+                {
+                    frame.flags |= kUSE_GLITCH_CORRECTION;
+                }
+                
+                double start = getSeconds();
+                
+                renderFrameCPU(&frame, tiles);
+                
+                elapsed[perturb] = getSeconds() - start;
+            }
+            
+            if(res)
+            {
+                unsigned count = frame.xres * frame.yres;
+                unsigned mismatches = 0;
+                
+                memset(&g_frame_stats, 0, sizeof(g_frame_stats));
+                
+                frame.pixels    = reference;
+                frame.bla       = &bla;
+                
+                double start = getSeconds();
+                
+                renderFrameCPU(&frame, tiles);
+                
+                double bla_elapsed = getSeconds() - start;
+                
+                frame.bla       = NULL;
+                frame.cost      = NULL;
+                
+                for(unsigned j=0; j<count; j++)
+                {
+                    if(pixels[j] != reference[j])
+                        mismatches++;
+                }
+                
+                printf("        %4ux%-4u perturbation %.3fs, with BLA %.3fs %5.2fx skipping %llu iterations in %llu steps, "
+                       "%llu references in %llu passes, %llu unresolved, %u pixels differ\n", frame.xres, frame.yres,
+                       elapsed[1], bla_elapsed, elapsed[1] / bla_elapsed, g_frame_stats.bla_skipped,
+                       g_frame_stats.bla_steps, g_frame_stats.glitch_references, g_frame_stats.glitch_passes,
+                       g_frame_stats.glitch_unresolved, mismatches);
+            }
+            else
+            {
+                unsigned count = frame.xres * frame.yres;
+                unsigned mismatches = 0;
+                
+                for(unsigned j=0; j<count; j++)
+                {
+                    if(pixels[j] != reference[j])
+                        mismatches++;
+                }
+                
+                printf("        %4ux%-4u perturbation %.3fs vs bignum %.3fs  %6.1fx, %u pixels differ\n",
+                       frame.xres, frame.yres, elapsed[1], elapsed[0], elapsed[0] / elapsed[1], mismatches);
+                
+                // again with the glitched pixels found and redone
+                memset(&g_frame_stats, 0, sizeof(g_frame_stats));
+                
+                frame.flags     = kUSE_SUBDIVISION | kUSE_PERTURBATION | kUSE_GLITCH_CORRECTION | floatexp;
+                mismatches      = 0;
+                
+                double start = getSeconds();
+                
+                renderFrameCPU(&frame, tiles);
+                
+                double corrected_elapsed = getSeconds() - start;
+                
+                for(unsigned j=0; j<count; j++)
+                {
+                    if(pixels[j] != reference[j])
+                        mismatches++;
+                }
+                
+                printf("        %4ux%-4u corrected %.3fs, %llu pixels glitched, %llu references in %llu passes, "
+                       "%llu unresolved, %u pixels differ\n", frame.xres, frame.yres, corrected_elapsed,
+                       g_frame_stats.glitched_pixels, g_frame_stats.glitch_references, g_frame_stats.glitch_passes,
+                       g_frame_stats.glitch_unresolved, mismatches);
+                
+                // the same frame with floatexp offsets, which only deep zooms need, if it
+                // did not have them already
+                if(floatexp)
+                    continue;
+                
+                frame.flags     = kUSE_SUBDIVISION | kUSE_PERTURBATION | kUSE_GLITCH_CORRECTION | kUSE_FLOATEXP;
+                frame.pixels    = reference;
+                mismatches      = 0;
+                
+                start = getSeconds();
+                
+                renderFrameCPU(&frame, tiles);
+                
+                double floatexp_elapsed = getSeconds() - start;
+                
+                for(unsigned j=0; j<count; j++)
+                {
+                    if(pixels[j] != reference[j])
+                        mismatches++;
+                }
+                
+                printf("        %4ux%-4u floatexp %.3fs, %.1fx the time of doubles, %u pixels differ\n",
+                       frame.xres, frame.yres, floatexp_elapsed, floatexp_elapsed / corrected_elapsed, mismatches);
+            }
+        }
+    }
+    
+    freeReferenceOrbit(&orbit);
+    freeBLATable(&bla);
+    mpf_clear(center_x);
+    mpf_clear(center_y);
+    
+    delete [] tiles;
+    delete [] reference;
+    delete [] pixels;
+}
+
+// Fixed point vs mpf on one thread at zooms that take a range of limb counts,
+// mpf gets the same bits as the fixed point numbers
+void benchmarkFixedPoint(void)
+{
+    static const double zooms[] = { 1e10, 1e30, 1e60, 1e120, 1e250 };
+    const unsigned      res = 32, itermax = 1024;
+    unsigned            *reference = new unsigned [res * res];
+    unsigned            *pixels = new unsigned [res * res];
+    KernelOptions       options = g_kernel_options;
+    KernelStats         stats;
+    FixedPointCenter    center;
+    mpf_t               center_x, center_y;
+    
+    mpf_init2(center_x, 64);
+    mpf_init2(center_y, 64);
+    mpf_set_d(center_x, -0.743643887037151);
+    mpf_set_d(center_y, 0.131825904205330);
+    
+    printf("Fixed point benchmark, %ux%u itermax %u\n", res, res, itermax);
+    
+    for(unsigned i=0; i<sizeof(zooms)/sizeof(*zooms); i++)
+    {
+        unsigned    limbs = getFixedPointLimbs(getPrecisionBits(floatExpFromDouble(zooms[i]), res));
+        double      elapsed[2];
+        unsigned    mismatches = 0;
+        
+        options.pixel_spacing = 3.0/(zooms[i]*res);
+        setFixedPointCenter(&center, limbs, center_x, center_y);
+        
+        for(int fixed=0; fixed<2; fixed++)
+        {
+            unsigned    *dst = fixed ? pixels : reference;
+            double      start = getSeconds();
+            
+            memset(&stats, 0, sizeof(stats));
+            
+            for(unsigned hy=0; hy<res; hy++)
+            {
+                for(unsigned hx=0; hx<res; hx++)
+                {
+                    double offset_x = 3.0*((double)hx/res-0.5)/zooms[i];
+                    double offset_y = 3.0*((double)hy/res-0.5)/zooms[i];
+                    
+                    if(fixed)
+                    {
+                        dst[hy * res + hx] = calcPixelFixedPoint(&center, &options, offset_x, offset_y, itermax, &stats);
+                    }
+                    else
+                    {
+                        dst[hy * res + hx] = calcPixelBigNUM(&options, center_x, center_y, limbs * 64,
+                                                             offset_x, offset_y, 0, itermax, &stats);
+                    }
+                }
+            }
+            
+            elapsed[fixed] = getSeconds() - start;
+        }
+        
+        for(unsigned j=0; j<res*res; j++)
+        {
+            if(pixels[j] != reference[j])
+                mismatches++;
+        }
+        
+        printf("    zoom %-6g %2u limbs  fixed %.3fs vs mpf %.3fs  %5.2fx, %u pixels differ\n",
+               zooms[i], limbs, elapsed[1], elapsed[0], elapsed[0] / elapsed[1], mismatches);
+    }
+    
+    mpf_clear(center_x);
+    mpf_clear(center_y);
+    
+    delete [] reference;
+    delete [] pixels;
+}
+
+// Doubles with and without escalation against bignum around the zooms where
+// doubles start to fail, how many pixels each gets wrong and at what cost
+void benchmarkEscalation(void)
+{
+    static const double zooms[] = { 1e9, 1e10, 1e11, 1e12 };
+    const unsigned  res = 256, itermax = 4096;
+    TileInfo        *tiles = new TileInfo [kMaxTileCount];
+    unsigned        *reference = new unsigned [res * res];
+    unsigned        *pixels = new unsigned [res * res];
+    mpf_t           center_x, center_y;
+    
+    mpf_init2(center_x, 64);
+    mpf_init2(center_y, 64);
+    mpf_set_d(center_x, -0.743643887037151);
+    mpf_set_d(center_y, 0.131825904205330);
+    
+    printf("Escalation benchmark %ux%u itermax %u, %s kernel\n", res, res, itermax, getSIMDLevelName(getSIMDLevel()));
+    
+    for(unsigned i=0; i<sizeof(zooms)/sizeof(*zooms); i++)
+    {
+        static const unsigned modes[] = { kUSE_BIGNUM, 0, kUSE_ESCALATION };
+        FrameInfo   frame;
+        double      elapsed[3];
+        unsigned    mismatches[3] = { 0, 0, 0 };
+        
+        setFrameCenter(&frame, center_x, center_y);
+        frame.zoom      = floatExpFromDouble(zooms[i]);
+        frame.xres      = res;
+        frame.yres      = res;
+        frame.itermax   = itermax;
+        frame.reference = NULL;
+        frame.bla       = NULL;
+        frame.cost      = NULL;
+        
+        for(int mode=0; mode<3; mode++)
+        {
+            memset(&g_frame_stats, 0, sizeof(g_frame_stats));
+            
+            frame.flags     = kUSE_SUBDIVISION | modes[mode];
+            frame.pixels    = mode ? pixels : reference;
+            
+            double start = getSeconds();
+            
+            renderFrameCPU(&frame, tiles);
+            
+            elapsed[mode] = getSeconds() - start;
+            
+            for(unsigned j=0; mode && j<res*res; j++)
+            {
+                if(pixels[j] != reference[j])
+                    mismatches[mode]++;
+            }
+        }
+        
+        printf("    zoom %-6g doubles %.3fs %5u pixels differ, escalated %.3fs %5llu pixels redone %5u differ, "
+               "bignum %.3fs\n", zooms[i], elapsed[1], mismatches[1], elapsed[2], g_frame_stats.escalated_pixels,
+               mismatches[2], elapsed[0]);
+    }
+    
+    mpf_clear(center_x);
+    mpf_clear(center_y);
+    
+    delete [] tiles;
+    delete [] reference;
+    delete [] pixels;
+}
+
+// Double-double vs bignum renders of views between the double and the bignum
+// zooms, and how many pixels plain doubles get wrong there. The last view sits
+// on the boundary at 1e20, where a periodicity check on the high halves alone
+// took orbits a whole ulp apart for cycles.
+void benchmarkDoubleDouble(void)
+{
+    static const struct {
+        const char  *x, *y;
+        double      zoom;
+        unsigned    itermax;
+    } views[] = {
+        { "-0.743643887037151", "0.131825904205330", 1e12, 4096 },
+        { "-0.743643887037151", "0.131825904205330", 1e14, 4096 },
+        { "-0.743643887037151", "0.131825904205330", 1e16, 4096 },
+        { "-0.743643887037151", "0.131825904205330", 1e18, 4096 },
+        { "-0.743643887037158704752191506114774", "0.131825904205311970493132056385139", 1e20, 16384 },
+    };
+    const unsigned  res = 256;
+    TileInfo        *tiles = new TileInfo [kMaxTileCount];
+    unsigned        *reference = new unsigned [res * res];
+    unsigned        *pixels = new unsigned [res * res];
+    mpf_t           center_x, center_y;
+    
+    mpf_init2(center_x, 128);
+    mpf_init2(center_y, 128);
+    
+    printf("Double-double benchmark %ux%u, %s kernel\n", res, res, getSIMDLevelName(getSIMDLevel()));
+    
+    for(unsigned i=0; i<sizeof(views)/sizeof(*views); i++)
+    {
+        static const unsigned modes[] = { kUSE_BIGNUM, kUSE_DOUBLEDOUBLE, 0 };
+        FrameInfo   frame;
+        double      elapsed[3];
+        unsigned    mismatches[3] = { 0, 0, 0 };
+        
+        mpf_set_str(center_x, views[i].x, 10);
+        mpf_set_str(center_y, views[i].y, 10);
+        
+        setFrameCenter(&frame, center_x, center_y);
+        frame.zoom      = floatExpFromDouble(views[i].zoom);
+        frame.xres      = res;
+        frame.yres      = res;
+        frame.itermax   = views[i].itermax;
+        frame.reference = NULL;
+        frame.bla       = NULL;
+        frame.cost      = NULL;
+        
+        for(int mode=0; mode<3; mode++)
+        {
+            frame.flags     = kUSE_SUBDIVISION | modes[mode];
+            frame.pixels    = mode ? pixels : reference;
+            
+            double start = getSeconds();
+            
+            renderFrameCPU(&frame, tiles);
+            
+            elapsed[mode] = getSeconds() - start;
+            
+            for(unsigned j=0; mode && j<res*res; j++)
+            {
+                if(pixels[j] != reference[j])
+                    mismatches[mode]++;
+            }
+        }
+        
+        printf("    zoom %-6g itermax %-5u %3u bits  double-double %.3fs vs bignum %.3fs  %5.1fx, %u pixels differ, "
+               "doubles %u pixels differ\n", views[i].zoom, frame.itermax, getPrecisionBits(frame.zoom, res),
+               elapsed[1], elapsed[0], elapsed[0] / elapsed[1], mismatches[1], mismatches[2]);
+    }
+    
+    mpf_clear(center_x);
+    mpf_clear(center_y);
+    
+    delete [] tiles;
+    delete [] reference;
+    delete [] pixels;
+}
+#endif
+
+static void countWork(void *arg, WorkerContext *)
+{
+    __atomic_fetch_add((unsigned *)arg, 1, __ATOMIC_RELAXED);
+}
+
+// what the queue itself costs with empty tasks, pushed all at once and a few at
+// a time, then how much of a core the main thread takes waiting on a render
+void benchmarkWorkQueue(void)
+{
+    const unsigned  task_count = 100000;
+    const unsigned  round_count = 10000;
+    unsigned        counter = 0;
+    double          start, cpu_start;
+    
+    printf("Work queue benchmark, %u calc threads\n", g_work_pool.thread_count);
+    
+    start       = getSeconds();
+    cpu_start   = getThreadSeconds();
+    
+    for(unsigned i=0; i<task_count; i++)
+    {
+        pushWork(countWork, &counter);
+    }
+    
+    waitForWork();
+    
+    printf("    %u empty tasks         %.3fs, %6.2fus a task, main thread cpu %.3fs\n", task_count,
+           getSeconds() - start, 1e6 * (getSeconds() - start) / task_count, getThreadSeconds() - cpu_start);
+    
+    start       = getSeconds();
+    cpu_start   = getThreadSeconds();
+    
+    for(unsigned i=0; i<round_count; i++)
+    {
+        for(unsigned j=0; j<g_work_pool.thread_count; j++)
+        {
+            pushWork(countWork, &counter);
+        }
+        
+        waitForWork();
+    }
+    
+    printf("    %u rounds of %u tasks %.3fs, %6.2fus a round, main thread cpu %.3fs\n", round_count, g_work_pool.thread_count,
+           getSeconds() - start, 1e6 * (getSeconds() - start) / round_count, getThreadSeconds() - cpu_start);
+    
+    if(counter != task_count + round_count * g_work_pool.thread_count)
+    {
+        printf("    %u tasks ran, %u pushed\n", counter, task_count + round_count * g_work_pool.thread_count);
+    }
+    
+    TileInfo        *tiles = new TileInfo [kMaxTileCount];
+    unsigned        *pixels = new unsigned [SCREEN_WIDTH * SCREEN_HEIGHT];
+    FrameInfo       frame;
+    mpf_t           center_x, center_y;
+    
+    mpf_init_set_d(center_x, -0.743643887);
+    mpf_init_set_d(center_y, 0.131825904);
+    
+    setFrameCenter(&frame, center_x, center_y);
+    frame.zoom      = floatExpFromDouble(2000.0);
+    frame.xres      = SCREEN_WIDTH;
+    frame.yres      = SCREEN_HEIGHT;
+    frame.itermax   = 4096;
+    frame.flags     = 0;
+    frame.pixels    = pixels;
+    frame.reference = NULL;
+    frame.bla       = NULL;
+    frame.cost      = NULL;
+    
+    for(int subdivide=0; subdivide<2; subdivide++)
+    {
+        frame.flags = subdivide ? kUSE_SUBDIVISION : 0;
+        
+        unsigned long long steals = g_work_pool.steals;
+        
+        start       = getSeconds();
+        cpu_start   = getThreadSeconds();
+        
+        renderFrameCPU(&frame, tiles);
+        
+        double elapsed = getSeconds() - start;
+        double cpu = getThreadSeconds() - cpu_start;
+        
+        printf("    seahorse %s %.3fs, main thread cpu %.3fs (%.0f%%), %llu tasks stolen\n",
+               subdivide ? "subdivided" : "tiles     ", elapsed, cpu, 100.0 * cpu / elapsed, g_work_pool.steals - steals);
+    }
+    
+    mpf_clear(center_x);
+    mpf_clear(center_y);
+    
+    delete [] tiles;
+    delete [] pixels;
+}
+
+double  g_bench_cancel_at;
+
+static void cancelBenchmarkFrame(void)
+{
+    if(g_cancel_time == 0.0 && getSeconds() >= g_bench_cancel_at)
+    {
+        g_cancel_time = getSeconds();
+        cancelRender();
+    }
+}
+
+// how long a frame takes to give up once cancelled, the slow per step modes are
+// the ones that matter: the event loop waits this long before it can start over
+void benchmarkCancel(void)
+{
+    static const struct {
+        const char  *name;
+        double      zoom;
+        unsigned    res;
+        unsigned    itermax;
+        unsigned    flags;
+    } modes[] = {
+        { "double",         2000.0, SCREEN_WIDTH,   1 << 24,    0 },
+        { "double-double",  1e20,   SCREEN_WIDTH,   1 << 24,    kUSE_DOUBLEDOUBLE },
+#ifdef USE_BIGNUM
+        { "bignum",         1e20,   512,            1 << 20,    kUSE_BIGNUM },
+#endif
+    };
+    TileInfo        *tiles = new TileInfo [kMaxTileCount];
+    unsigned        *pixels = new unsigned [SCREEN_WIDTH * SCREEN_HEIGHT];
+    KernelOptions   kernel_options = g_kernel_options;
+    mpf_t           center_x, center_y;
+    
+    mpf_init2(center_x, 128);
+    mpf_init2(center_y, 128);
+    mpf_set_str(center_x, "-0.743643887037158704752191506114774", 10);
+    mpf_set_str(center_y, "0.131825904205311970493132056385139", 10);
+    
+    // no periodicity, so the interior pixels run all the way
+    g_kernel_options.flags &= ~kKernelPeriodicityCheck;
+    g_render_poll = cancelBenchmarkFrame;
+    
+    printf("Cancel benchmark, cancelled %.0fms in, polled every %.0fms, kernels check every %u steps\n",
+           1e3 * 0.1, 1e3 * kRenderPollInterval, kCancelCheckInterval);
+    
+    for(unsigned i=0; i<sizeof(modes)/sizeof(*modes); i++)
+    {
+        FrameInfo   frame;
+        
+        setFrameCenter(&frame, center_x, center_y);
+        frame.zoom      = floatExpFromDouble(modes[i].zoom);
+        frame.xres      = modes[i].res;
+        frame.yres      = modes[i].res;
+        frame.itermax   = modes[i].itermax;
+        frame.flags     = modes[i].flags | kUSE_SUBDIVISION;
+        frame.pixels    = pixels;
+        frame.reference = NULL;
+        frame.bla       = NULL;
+        frame.cost      = NULL;
+        
+        g_cancel_time       = 0.0;
+        g_bench_cancel_at   = getSeconds() + 0.1;
+        
+        bool done = renderFrameCPU(&frame, tiles);
+        
+        double      stopped = getSeconds();
+        unsigned    count = ((frame.xres + g_tile_size - 1) / g_tile_size) * ((frame.yres + g_tile_size - 1) / g_tile_size);
+        unsigned    finished = 0;
+        
+        for(unsigned j=0; j<count; j++)
+        {
+            if(tiles[j].finished > tiles[j].started && tiles[j].finished < g_cancel_time)
+                finished++;
+        }
+        
+        if(done)
+        {
+            printf("    %-14s itermax %-8u finished before the cancel\n", modes[i].name, frame.itermax);
+        }
+        else
+        {
+            printf("    %-14s itermax %-8u returned %6.2fms after the cancel, %u of %u tiles were done\n",
+                   modes[i].name, frame.itermax, 1e3 * (stopped - g_cancel_time), finished, count);
+        }
+    }
+    
+    g_render_poll       = NULL;
+    g_cancel_time       = 0.0;
+    g_kernel_options    = kernel_options;
+    
+    mpf_clear(center_x);
+    mpf_clear(center_y);
+    
+    delete [] tiles;
+    delete [] pixels;
+}
+
+// the seahorse frame on 1, 2, 4... calc threads up to the configured count, the
+// pool is restarted for each so pinning and first touch are as in a real run
+void benchmarkScaling(void)
+{
+    unsigned        thread_count = g_work_pool.thread_count;
+    TileInfo        *tiles = new TileInfo [kMaxTileCount];
+    FrameInfo       frame;
+    mpf_t           center_x, center_y;
+    double          single = 0.0;
+    
+    mpf_init_set_d(center_x, -0.743643887);
+    mpf_init_set_d(center_y, 0.131825904);
+    
+    setFrameCenter(&frame, center_x, center_y);
+    frame.zoom      = floatExpFromDouble(2000.0);
+    frame.xres      = SCREEN_WIDTH;
+    frame.yres      = SCREEN_HEIGHT;
+    frame.itermax   = 4096;
+    frame.flags     = kUSE_SUBDIVISION;
+    frame.reference = NULL;
+    frame.bla       = NULL;
+    frame.cost      = NULL;
+    
+    printf("Thread scaling benchmark, seahorse %ux%u itermax %u, %ld cpus online%s\n", frame.xres, frame.yres,
+           frame.itermax, sysconf(_SC_NPROCESSORS_ONLN), g_pin_threads ? ", pinned" : "");
+    
+    for(unsigned count=1; ; count=std::min(count * 2, thread_count))
+    {
+        stopCalcThreads();
+        startCalcThreads(count);
+        
+        // a fresh buffer each time, or the first run's threads would keep its pages
+        frame.pixels = allocPixels(frame.xres * frame.yres);
+        
+        double start = getSeconds();
+        
+        renderFrameCPU(&frame, tiles);
+        
+        double elapsed = getSeconds() - start;
+        
+        if(count == 1)
+            single = elapsed;
+        
+        printf("    %3u threads %.3fs  %5.2fx, %3.0f%% efficiency\n", count, elapsed, single / elapsed,
+               100.0 * single / elapsed / count);
+        
+        freePixels(frame.pixels, frame.xres * frame.yres);
+        
+        if(count == thread_count)
+            break;
+    }
+    
+    mpf_clear(center_x);
+    mpf_clear(center_y);
+    
+    delete [] tiles;
+}
+
+static const char *getTileOrderName(unsigned order)
+{
+    switch(order)
+    {
+        case kTileOrderRows:    return "rows";
+        case kTileOrderMorton:  return "morton";
+        case kTileOrderHilbert: return "hilbert";
+    }
+    
+    return "unknown";
+}
+
+static unsigned findTileOrder(const char *name)
+{
+    for(unsigned order=kTileOrderRows; order<=kTileOrderHilbert; order++)
+    {
+        if(!strcmp(name, getTileOrderName(order)))
+            return order;
+    }
+    
+    return kTileOrderHilbert;
+}
+
+// when the tiles of a render finish for a few tile sizes and orders, the last
+// one is what the frame waits on
+void benchmarkTiles(void)
+{
+    static const unsigned sizes[] = { 16, 32, 64, 128 };
+    TileInfo        *tiles = new TileInfo [kMaxTileCount];
+    unsigned        *pixels = new unsigned [SCREEN_WIDTH * SCREEN_HEIGHT];
+    unsigned        tile_size = g_tile_size;
+    unsigned        tile_order = g_tile_order;
+    FrameInfo       frame;
+    mpf_t           center_x, center_y;
+    
+    mpf_init_set_d(center_x, -0.743643887);
+    mpf_init_set_d(center_y, 0.131825904);
+    
+    setFrameCenter(&frame, center_x, center_y);
+    frame.zoom      = floatExpFromDouble(2000.0);
+    frame.xres      = SCREEN_WIDTH;
+    frame.yres      = SCREEN_HEIGHT;
+    frame.itermax   = 4096;
+    frame.flags     = 0;
+    frame.pixels    = pixels;
+    frame.reference = NULL;
+    frame.bla       = NULL;
+    frame.cost      = NULL;
+    
+    printf("Tile benchmark, seahorse %ux%u itermax %u, times from the start of the render\n",
+           frame.xres, frame.yres, frame.itermax);
+    
+    for(unsigned i=0; i<sizeof(sizes)/sizeof(*sizes); i++)
+    {
+        for(unsigned order=kTileOrderRows; order<=kTileOrderHilbert; order++)
+        {
+            g_tile_size     = sizes[i];
+            g_tile_order    = order;
+            
+            double start = getSeconds();
+            
+            renderFrameCPU(&frame, tiles);
+            
+            double              elapsed = getSeconds() - start;
+            unsigned            count = ((frame.xres + sizes[i] - 1) / sizes[i]) * ((frame.yres + sizes[i] - 1) / sizes[i]);
+            std::vector<double> finished(count);
+            double              slowest = 0.0;
+            
+            for(unsigned j=0; j<count; j++)
+            {
+                finished[j] = tiles[j].finished - start;
+                slowest = std::max(slowest, tiles[j].finished - tiles[j].started);
+            }
+            
+            std::sort(finished.begin(), finished.end());
+            
+            printf("    %3u pixels %-7s %5u tiles %.3fs, half done at %.3fs, last at %.3fs, slowest tile %.4fs\n",
+                   g_tile_size, getTileOrderName(order), count, elapsed, finished[count / 2], finished[count - 1], slowest);
+        }
+    }
+    
+    g_tile_size     = tile_size;
+    g_tile_order    = tile_order;
+    
+    mpf_clear(center_x);
+    mpf_clear(center_y);
+    
+    delete [] tiles;
+    delete [] pixels;
+}
+
+// when the tiles within kFocusBenchRadius of a point are done, the box a user
+// would be looking at around the cursor
+#define kFocusBenchRadius       128
+
+static double getFocusRegionDone(const TileInfo *tiles, unsigned count, unsigned focus_x, unsigned focus_y)
+{
+    double done = 0.0;
+    
+    for(unsigned i=0; i<count; i++)
+    {
+        const Rect *r = &tiles[i].rect;
+        
+        if(r->x1 + kFocusBenchRadius >= focus_x && r->x0 <= focus_x + kFocusBenchRadius &&
+           r->y1 + kFocusBenchRadius >= focus_y && r->y0 <= focus_y + kFocusBenchRadius)
+        {
+            done = std::max(done, tiles[i].finished);
+        }
+    }
+    
+    return done;
+}
+
+double      g_bench_focus_at;
+unsigned    g_bench_focus_x, g_bench_focus_y;
+
+static void moveBenchmarkFocus(void)
+{
+    if(g_bench_focus_at != 0.0 && getSeconds() >= g_bench_focus_at)
+    {
+        setRenderFocus(g_bench_focus_x, g_bench_focus_y);
+        g_bench_focus_at = 0.0;
+    }
+}
+
+// The seahorse frame in hilbert order against kUSE_FOCUS: how long until the box
+// around a point off center is done, from the start of the render and from a
+// focus move a quarter of the way through it.
+void benchmarkFocus(void)
+{
+    TileInfo        *tiles = new TileInfo [kMaxTileCount];
+    unsigned        *pixels = new unsigned [SCREEN_WIDTH * SCREEN_HEIGHT];
+    unsigned        count;
+    unsigned        focus = g_render_focus;
+    FrameInfo       frame;
+    mpf_t           center_x, center_y;
+    
+    mpf_init_set_d(center_x, -0.743643887);
+    mpf_init_set_d(center_y, 0.131825904);
+    
+    setFrameCenter(&frame, center_x, center_y);
+    frame.zoom      = floatExpFromDouble(2000.0);
+    frame.xres      = SCREEN_WIDTH;
+    frame.yres      = SCREEN_HEIGHT;
+    frame.itermax   = 4096;
+    frame.pixels    = pixels;
+    frame.reference = NULL;
+    frame.bla       = NULL;
+    frame.cost      = NULL;
+    
+    count = ((frame.xres + g_tile_size - 1) / g_tile_size) * ((frame.yres + g_tile_size - 1) / g_tile_size);
+    
+    printf("Focus benchmark, seahorse %ux%u itermax %u, %u pixel tiles, the %u pixels around the focus\n",
+           frame.xres, frame.yres, frame.itermax, g_tile_size, kFocusBenchRadius);
+    
+    for(unsigned moved=0; moved<2; moved++)
+    {
+        for(unsigned use_focus=0; use_focus<2; use_focus++)
+        {
+            double      start, elapsed, moved_at, region_done;
+            unsigned    x = moved ? SCREEN_WIDTH / 5 : 3 * SCREEN_WIDTH / 4;
+            unsigned    y = moved ? 4 * SCREEN_HEIGHT / 5 : SCREEN_HEIGHT / 4;
+            
+            frame.flags = use_focus ? kUSE_FOCUS : 0;
+            
+            // a render first, so the move lands a quarter of the way through the timed one
+            setRenderFocus(moved ? SCREEN_WIDTH / 2 : x, moved ? SCREEN_HEIGHT / 2 : y);
+            
+            start = getSeconds();
+            renderFrameCPU(&frame, tiles);
+            elapsed = getSeconds() - start;
+            
+            if(moved)
+            {
+                g_bench_focus_x     = x;
+                g_bench_focus_y     = y;
+                g_bench_focus_at    = getSeconds() + 0.25 * elapsed;
+                g_render_poll       = moveBenchmarkFocus;
+            }
+            
+            start = getSeconds();
+            moved_at = moved ? g_bench_focus_at : start;
+            renderFrameCPU(&frame, tiles);
+            elapsed = getSeconds() - start;
+            
+            g_render_poll = NULL;
+            
+            region_done = getFocusRegionDone(tiles, count, x, y);
+            
+            printf("    %-8s %-8s %4u,%-4u frame %.3fs, the box around it done %.3fs after the %s\n",
+                   use_focus ? "focus" : getTileOrderName(g_tile_order), moved ? "moved to" : "focus at", x, y,
+                   elapsed, std::max(region_done - moved_at, 0.0), moved ? "move" : "start");
+        }
+    }
+    
+    g_render_focus = focus;
+    
+    mpf_clear(center_x);
+    mpf_clear(center_y);
+    
+    delete [] tiles;
+    delete [] pixels;
+}
+
+// How far past an even split of the tile iterations a list schedule on threads
+// ends, taking the tiles in the order they were started. Wall times say little
+// when the calc threads outnumber the cpus, this says what the order is worth.
+static double getScheduleOverrun(const FrameInfo *frame, const TileInfo *tiles, unsigned threads)
+{
+    std::vector<std::pair<double, double> > started(frame->tile_count);
+    std::vector<double>                     loads(threads, 0.0);
+    double                                  total = 0.0;
+    
+    for(unsigned i=0; i<frame->tile_count; i++)
+    {
+        started[i] = std::make_pair(tiles[i].started, getRectIterations(frame, &tiles[i].rect));
+        total += started[i].second;
+    }
+    
+    std::sort(started.begin(), started.end());
+    
+    for(unsigned i=0; i<frame->tile_count; i++)
+    {
+        *std::min_element(loads.begin(), loads.end()) += started[i].second;
+    }
+    
+    return *std::max_element(loads.begin(), loads.end()) / (total / threads) - 1.0;
+}
+
+// The seahorse frame at zoom 2000 is the parent, then a zoom in and a pan off it
+// are rendered in hilbert order and again with the cost map estimateViewCost
+// reads off the parent, which splits heavy tiles and takes them longest first.
+void benchmarkCostModel(void)
+{
+    static const struct {
+        const char  *name;
+        double      zoom;
+        double      offset_x, offset_y;     // in parent frame widths
+    } children[] = {
+        { "zoom in",    4000.0, 0.0,    0.0 },
+        { "pan",        2000.0, 0.25,   -0.2 },
+    };
+    TileInfo        *tiles = new TileInfo [kMaxTileCount];
+    float           *cost = new float [kCostColumns * kCostRows];
+    ZoomView        parent, child;
+    FrameInfo       frame;
+    
+    parent.zoom             = floatExpFromDouble(2000.0);
+    parent.xres             = SCREEN_WIDTH;
+    parent.yres             = SCREEN_HEIGHT;
+    parent.itermax          = 4096;
+    parent.pixels           = new unsigned [SCREEN_WIDTH * SCREEN_HEIGHT];
+    parent.pixels_itermax   = parent.itermax;
+    
+    parent.center_x         = -0.743643887;
+    parent.center_y         = 0.131825904;
+    
+    mpf_init2(parent.center_x_mp, 128);
+    mpf_init2(parent.center_y_mp, 128);
+    mpf_set_d(parent.center_x_mp, parent.center_x);
+    mpf_set_d(parent.center_y_mp, parent.center_y);
+    
+    child = parent;
+    child.pixels = new unsigned [SCREEN_WIDTH * SCREEN_HEIGHT];
+    
+    mpf_init2(child.center_x_mp, 128);
+    mpf_init2(child.center_y_mp, 128);
+    
+    setFrameCenter(&frame, parent.center_x_mp, parent.center_y_mp);
+    frame.zoom      = parent.zoom;
+    frame.xres      = parent.xres;
+    frame.yres      = parent.yres;
+    frame.itermax   = parent.itermax;
+    frame.flags     = 0;
+    frame.pixels    = parent.pixels;
+    frame.reference = NULL;
+    frame.bla       = NULL;
+    frame.cost      = NULL;
+    
+    renderFrameCPU(&frame, tiles);
+    
+    printf("Cost model benchmark, seahorse %ux%u itermax %u, %u pixel tiles on %u threads\n",
+           frame.xres, frame.yres, frame.itermax, g_tile_size, g_work_pool.thread_count);
+    
+    for(unsigned i=0; i<sizeof(children)/sizeof(*children); i++)
+    {
+        child.zoom      = floatExpFromDouble(children[i].zoom);
+        child.center_x  = parent.center_x + getZoomOffset(3.0 * children[i].offset_x, parent.zoom);
+        child.center_y  = parent.center_y + getZoomOffset(3.0 * children[i].offset_y, parent.zoom);
+        
+        mpf_set_d(child.center_x_mp, child.center_x);
+        mpf_set_d(child.center_y_mp, child.center_y);
+        
+        estimateViewCost(&child, &parent, cost);
+        
+        setFrameCenter(&frame, child.center_x_mp, child.center_y_mp);
+        frame.zoom      = child.zoom;
+        frame.pixels    = child.pixels;
+        
+        for(unsigned use_cost=0; use_cost<2; use_cost++)
+        {
+            frame.cost = use_cost ? cost : NULL;
+            
+            double start = getSeconds();
+            
+            renderFrameCPU(&frame, tiles);
+            
+            double      elapsed = getSeconds() - start;
+            double      slowest = 0.0;
+            double      last = 0.0;
+            
+            for(unsigned j=0; j<frame.tile_count; j++)
+            {
+                slowest = std::max(slowest, tiles[j].finished - tiles[j].started);
+                last    = std::max(last, tiles[j].started);
+            }
+            
+            printf("    %-8s %-9s %5u tiles %.3fs, last tile started at %.3fs, slowest tile %.4fs, "
+                   "scheduled on 16 threads the iterations end %.1f%% past an even split\n",
+                   children[i].name, use_cost ? "cost" : getTileOrderName(g_tile_order), frame.tile_count,
+                   elapsed, last - start, slowest, 100.0 * getScheduleOverrun(&frame, tiles, 16));
+        }
+    }
+    
+    mpf_clear(parent.center_x_mp);
+    mpf_clear(parent.center_y_mp);
+    mpf_clear(child.center_x_mp);
+    mpf_clear(child.center_y_mp);
+    
+    delete [] parent.pixels;
+    delete [] child.pixels;
+    delete [] cost;
+    delete [] tiles;
+}
+
+// plain vs subdivided tiles for a few views on the calc threads
+void benchmarkSubdivision(void)
+{
+    static const struct {
+        const char  *name;
+        double      center_x, center_y, zoom;
+        unsigned    res;
+        unsigned    itermax;
+        unsigned    flags;
+    } views[] = {
+        { "default",        -0.7,           0.0,            1.0,    SCREEN_WIDTH,   1024,   0 },
+        { "seahorse",       -0.743643887,   0.131825904,    2000.0, SCREEN_WIDTH,   4096,   0 },
+        { "mini",           -1.7685,        0.0,            500.0,  SCREEN_WIDTH,   4096,   0 },
+#ifdef USE_BIGNUM
+        { "default bignum", -0.7,           0.0,            1.0,    256,            256,    kUSE_BIGNUM },
+        { "seahorse bignum",-0.743643887,   0.131825904,    2000.0, 256,            1024,   kUSE_BIGNUM },
+#endif
+    };
+    TileInfo        *tiles = new TileInfo [kMaxTileCount];
+    unsigned        *reference = new unsigned [SCREEN_WIDTH * SCREEN_HEIGHT];
+    unsigned        *pixels = new unsigned [SCREEN_WIDTH * SCREEN_HEIGHT];
+    mpf_t           center_x, center_y;
+    
+    mpf_init2(center_x, 64);
+    mpf_init2(center_y, 64);
+    
+    printf("Subdivision benchmark, %u pixel tiles plain vs Mariani-Silver\n", g_tile_size);
+    
+    for(unsigned i=0; i<sizeof(views)/sizeof(*views); i++)
+    {
+        FrameInfo   frame;
+        double      elapsed[2];
+        
+        mpf_set_d(center_x, views[i].center_x);
+        mpf_set_d(center_y, views[i].center_y);
+        
+        setFrameCenter(&frame, center_x, center_y);
+        frame.zoom      = floatExpFromDouble(views[i].zoom);
+        frame.xres      = views[i].res;
+        frame.yres      = views[i].res;
+        frame.itermax   = views[i].itermax;
+        frame.reference = NULL;
+        frame.bla       = NULL;
+        frame.cost      = NULL;
+        
+        for(int subdivide=0; subdivide<2; subdivide++)
+        {
+            memset(&g_frame_stats, 0, sizeof(g_frame_stats));
+            
+            frame.flags     = views[i].flags | (subdivide ? kUSE_SUBDIVISION : 0);
+            frame.pixels    = subdivide ? pixels : reference;
+            
+            double start = getSeconds();
+            
+            renderFrameCPU(&frame, tiles);
+            
+            elapsed[subdivide] = getSeconds() - start;
+        }
+        
+        unsigned count = frame.xres * frame.yres;
+        unsigned mismatches = 0;
+        
+        for(unsigned j=0; j<count; j++)
+        {
+            if(pixels[j] != reference[j])
+                mismatches++;
+        }
+        
+        printf("    %-16s %4ux%-4u itermax %-5u %.3fs vs %.3fs  %5.2fx, %5.1f%% filled, %u pixels differ\n",
+               views[i].name, frame.xres, frame.yres, frame.itermax, elapsed[1], elapsed[0],
+               elapsed[0] / elapsed[1], 100.0 * g_frame_stats.subdivision_filled / count, mismatches);
+    }
+    
+    mpf_clear(center_x);
+    mpf_clear(center_y);
+    
+    delete [] tiles;
+    delete [] reference;
+    delete [] pixels;
+}
+
+// itermax doubled a few times on views with a lot of boundary, each a frame
+// from z = 0 against carrying on the last one's pixels still running and the
+// rectangles it filled from them
+void benchmarkResume(void)
+{
+    static const struct {
+        const char  *name;
+        double      center_x, center_y, zoom;
+    } views[] = {
+        { "default",    -0.7,           0.0,            1.0 },
+        { "seahorse",   -0.743643887,   0.131825904,    2000.0 },
+        { "mini",       -1.7685,        0.0,            500.0 },
+    };
+    const unsigned  res = SCREEN_WIDTH;
+    const unsigned  itermax = 256, steps = 4;
+    TileInfo        *tiles = new TileInfo [kMaxTileCount];
+    unsigned        *reference = new unsigned [res * res];
+    unsigned        *pixels = new unsigned [res * res];
+    OrbitList       orbits, next;
+    mpf_t           center_x, center_y;
+    
+    mpf_init2(center_x, 64);
+    mpf_init2(center_y, 64);
+    initOrbitList(&orbits);
+    initOrbitList(&next);
+    
+    printf("Resume benchmark %ux%u, itermax doubled from %u, from z = 0 vs carried on\n", res, res, itermax);
+    
+    for(unsigned i=0; i<sizeof(views)/sizeof(*views); i++)
+    {
+        FrameInfo   frame;
+        
+        mpf_set_d(center_x, views[i].center_x);
+        mpf_set_d(center_y, views[i].center_y);
+        
+        setFrameCenter(&frame, center_x, center_y);
+        frame.zoom      = floatExpFromDouble(views[i].zoom);
+        frame.xres      = res;
+        frame.yres      = res;
+        frame.itermax   = itermax;
+        frame.reference = NULL;
+        frame.bla       = NULL;
+        frame.cost      = NULL;
+        frame.flags     = kUSE_SUBDIVISION | kUSE_ORBITS;
+        frame.pixels    = pixels;
+        frame.orbits    = &orbits;
+        
+        startOrbitList(&orbits, res, res, itermax);
+        renderFrameCPU(&frame, tiles);
+        
+        for(unsigned step=0; step<steps; step++)
+        {
+            double      elapsed[2];
+            unsigned    carried = orbits.count;
+            unsigned    filled = orbits.filled_count;
+            
+            frame.itermax   *= 2;
+            frame.flags     = kUSE_SUBDIVISION;
+            frame.pixels    = reference;
+            
+            double start = getSeconds();
+            
+            renderFrameCPU(&frame, tiles);
+            
+            elapsed[0] = getSeconds() - start;
+            
+            frame.flags     = kUSE_SUBDIVISION | kUSE_ORBITS;
+            frame.pixels    = pixels;
+            frame.orbits    = &next;
+            
+            start = getSeconds();
+            
+            startOrbitList(&next, res, res, frame.itermax);
+            resumeFrame(&frame, &orbits, __atomic_load_n(&g_render_generation, __ATOMIC_RELAXED));
+            
+            elapsed[1] = getSeconds() - start;
+            
+            std::swap(orbits, next);
+            
+            unsigned mismatches = 0;
+            
+            for(unsigned j=0; j<res * res; j++)
+            {
+                if(pixels[j] != reference[j])
+                    mismatches++;
+            }
+            
+            printf("    %-10s itermax %5u %.3fs vs %.3fs  %6.2fx, %7u pixels and %5u rectangles carried on, "
+                   "%u pixels differ\n", views[i].name, frame.itermax, elapsed[1], elapsed[0], elapsed[0] / elapsed[1],
+                   carried, filled, mismatches);
+        }
+    }
+    
+    freeOrbitList(&orbits);
+    freeOrbitList(&next);
+    mpf_clear(center_x);
+    mpf_clear(center_y);
+    
+    delete [] tiles;
+    delete [] reference;
+    delete [] pixels;
+}
+
+// clicks of a few sizes away from a view, each a frame of the moved view from
+// scratch against copying what the last frame has and rendering the rest
+void benchmarkPan(void)
+{
+    static const struct {
+        int         x, y;
+    } shifts[] = {
+        { 8, 0 }, { 0, -32 }, { 100, 60 }, { -300, 200 }, { 480, -480 },
+    };
+    const unsigned  res = SCREEN_WIDTH;
+    const double    zoom = 2000.0;
+    TileInfo        *tiles = new TileInfo [kMaxTileCount];
+    unsigned        *last = new unsigned [res * res];
+    unsigned        *reference = new unsigned [res * res];
+    unsigned        *pixels = new unsigned [res * res];
+    mpf_t           center_x, center_y, offset;
+    FrameInfo       frame;
+    
+    mpf_init2(center_x, 64);
+    mpf_init2(center_y, 64);
+    mpf_init2(offset, 64);
+    mpf_set_d(center_x, -0.743643887);
+    mpf_set_d(center_y, 0.131825904);
+    
+    setFrameCenter(&frame, center_x, center_y);
+    frame.zoom      = floatExpFromDouble(zoom);
+    frame.xres      = res;
+    frame.yres      = res;
+    frame.itermax   = 4096;
+    frame.reference = NULL;
+    frame.bla       = NULL;
+    frame.cost      = NULL;
+    frame.flags     = kUSE_SUBDIVISION;
+    frame.pixels    = last;
+    
+    renderFrameCPU(&frame, tiles);
+    
+    printf("Pan benchmark %ux%u seahorse, from scratch vs the last frame's pixels reused\n", res, res);
+    
+    for(unsigned i=0; i<sizeof(shifts)/sizeof(*shifts); i++)
+    {
+        double      elapsed[2];
+        Rect        overlap;
+        
+        mpf_set_d(offset, shifts[i].x * 3.0 / (zoom * res));
+        mpf_add(offset, offset, center_x);
+        mpf_swap(offset, center_x);
+        mpf_set_d(offset, shifts[i].y * 3.0 / (zoom * res));
+        mpf_add(offset, offset, center_y);
+        mpf_swap(offset, center_y);
+        
+        setFrameCenter(&frame, center_x, center_y);
+        frame.pixels = reference;
+        
+        double start = getSeconds();
+        
+        renderFrameCPU(&frame, tiles);
+        
+        elapsed[0] = getSeconds() - start;
+        
+        frame.pixels = pixels;
+        
+        start = getSeconds();
+        
+        unsigned count = setPanFrame(&frame, last, shifts[i].x, shifts[i].y, g_tile_size, g_tile_order, tiles, &overlap);
+        
+        renderTilesCPU(&frame, tiles, count, __atomic_load_n(&g_render_generation, __ATOMIC_RELAXED));
+        
+        elapsed[1] = getSeconds() - start;
+        
+        unsigned reused = (overlap.x1 - overlap.x0 + 1) * (overlap.y1 - overlap.y0 + 1);
+        unsigned mismatches = 0;
+        
+        for(unsigned j=0; j<res * res; j++)
+        {
+            if(pixels[j] != reference[j])
+                mismatches++;
+        }
+        
+        printf("    pan %4d,%-4d %.3fs vs %.3fs  %6.2fx, %5.1f%% of the pixels reused, %u pixels differ\n",
+               shifts[i].x, shifts[i].y, elapsed[1], elapsed[0], elapsed[0] / elapsed[1], 100.0 * reused / (res * res),
+               mismatches);
+        
+        std::swap(last, pixels);
+    }
+    
+    mpf_clear(center_x);
+    mpf_clear(center_y);
+    mpf_clear(offset);
+    
+    delete [] tiles;
+    delete [] last;
+    delete [] reference;
+    delete [] pixels;
+}
+
+cl_device_id getCLDevice()
+{
+    cl_platform_id platforms[100];
+    cl_uint platforms_n = 0;
+    
+    clGetPlatformIDs(100, platforms, &platforms_n);
+    
+    if(!platforms_n)
+    {
+        printf("No OpenCL platform, the OpenCL and hybrid modes are off\n");
+        return NULL;
+    }
+    
+    cl_device_id devices[100];
+    cl_uint devices_n = 0;
+    clGetDeviceIDs(platforms[0], CL_DEVICE_TYPE_GPU, 100, devices, &devices_n);
+    
+    // a cpu only runtime such as pocl
+    if(!devices_n && (clGetDeviceIDs(platforms[0], CL_DEVICE_TYPE_ALL, 100, devices, &devices_n) != CL_SUCCESS || !devices_n))
+    {
+        printf("No OpenCL device, the OpenCL and hybrid modes are off\n");
+        return NULL;
+    }
+    
+    char buffer[1024];
+    for (int i=0; i<devices_n; i++)
+    {
+        clGetDeviceInfo(devices[i], CL_DEVICE_VENDOR, sizeof(buffer), buffer, NULL);
+        
+        if(!strcmp("NVIDIA", buffer))
+        {
+            clGetDeviceInfo(devices[i], CL_DEVICE_VENDOR, sizeof(buffer), buffer, NULL);
+            
+            return devices[i];
+        }
+    }
+    
+    return devices[0];
+}
+
+void cl_notify(const char *errinfo, const void *private_info, size_t cb, void *user_data)
+{
+    fprintf(stderr, "OpenCL Error (via pfn_notify): %s\n", errinfo);
+}
+
+HSV_Color RGB2HSV(RGB_Color in)
+{
+    HSV_Color   out;
+    double      min, max, delta;
+    
+    min = in.r < in.g ? in.r : in.g;
+    min = min  < in.b ? min  : in.b;
+    
+    max = in.r > in.g ? in.r : in.g;
+    max = max  > in.b ? max  : in.b;
+    
+    out.v = max;                                // v
+    delta = max - min;
+    if( max > 0.0 ) { // NOTE: if Max is == 0, this divide would cause a crash
+        out.s = (delta / max);                  // s
+    } else {
+        // if max is 0, then r = g = b = 0
+        // s = 0, v is undefined
+        out.s = 0.0;
+        out.h = NAN;                            // its now undefined
+        return out;
+    }
+    if( in.r >= max )                           // > is bogus, just keeps compilor happy
+        out.h = ( in.g - in.b ) / delta;        // between yellow & magenta
+    else
+        if( in.g >= max )
+            out.h = 2.0 + ( in.b - in.r ) / delta;  // between cyan & yellow
+        else
+            out.h = 4.0 + ( in.r - in.g ) / delta;  // between magenta & cyan
+    
+    out.h *= 60.0;                              // degrees
+    
+    if( out.h < 0.0 )
+        out.h += 360.0;
+    
+    return out;
+}
+
+RGB_Color HSV2RGB(HSV_Color in)
+{
+    double      hh, p, q, t, ff;
+    long        i;
+    RGB_Color   out;
+    
+    if(in.s <= 0.0)
+    {
+        out.r = in.v;
+        out.g = in.v;
+        out.b = in.v;
+        return out;
+    }
+    hh = in.h;
+    if(hh >= 360.0) hh = 0.0;
+    hh /= 60.0;
+    i = (long)hh;
+    ff = hh - i;
+    p = in.v * (1.0 - in.s);
+    q = in.v * (1.0 - (in.s * ff));
+    t = in.v * (1.0 - (in.s * (1.0 - ff)));
+    
+    switch(i)
+    {
+        case 0:
+            out.r = in.v;
+            out.g = t;
+            out.b = p;
+            break;
+        case 1:
+            out.r = q;
+            out.g = in.v;
+            out.b = p;
+            break;
+        case 2:
+            out.r = p;
+            out.g = in.v;
+            out.b = t;
+            break;
+        case 3:
+            out.r = p;
+            out.g = q;
+            out.b = in.v;
+            break;
+        case 4:
+            out.r = t;
+            out.g = p;
+            out.b = in.v;
+            break;
+        case 5:
+        default:
+            out.r = in.v;
+            out.g = p;
+            out.b = q;
+            break;
+    }
+    
+    return out;
+}
+
+HSV_Color genBezierColor(float u, HSV_Color *cpts)
+{
+    HSV_Color   hsv;
+    float       b0, b1, b2, b3;
+    
+    b0 = pow(1.0 - u, 3);
+    b1 = 3.0 * u * pow(1.0 - u, 2);
+    b2 = 3.0 * pow(u, 2) * (1.0 - u);
+    b3 = pow(u, 3);
+    
+    hsv.h = b0 * cpts[0].h + b1 * cpts[1].h + b2 * cpts[2].h + b3 * cpts[3].h;
+    hsv.s = b0 * cpts[0].s + b1 * cpts[1].s + b2 * cpts[2].s + b3 * cpts[3].s;
+    hsv.v = b0 * cpts[0].v + b1 * cpts[1].v + b2 * cpts[2].v + b3 * cpts[3].v;
+    
+    return hsv;
+}
+
+RGB_Color genColorFromPalette(unsigned index, unsigned max, Palette *palette)
+{
+    if(index == 0)
+    {
+        RGB_Color   zero;
+        
+        zero.r = 0;
+        zero.g = 0;
+        zero.b = 0;
+        
+        return zero;
+    }
+    
+    // deferred creation of palette if count is larger
+    if(max > palette->count)
+    {
+        free(palette->c);
+        
+        palette->c = new RGB_Color [max];
+        palette->count = max;
+        
+        for(int i=0; i<max; i++)
+        {
+            float u = (float)i / (float)max;
+            HSV_Color hsv = genBezierColor(u, palette->control_colors);
+            RGB_Color rgb = HSV2RGB(hsv);
+            
+            palette->c[i].r = rgb.r * 255.0;
+            palette->c[i].g = rgb.g * 255.0;
+            palette->c[i].b = rgb.b * 255.0;
+        }
+    }
+    else if (max < palette->count)
+    {
+        float scale = (float)palette->count / (float)max;
+        
+        index = scale * index;
+    }
+    
+    return palette->c[index];
+}
+
+int createPalettes(Palette *palettes)
+{
+    unsigned        palette_index;
+    
+    HSV_Color   zero;
+    zero.h = 0.0;
+    zero.s = 0.0;
+    zero.v = 0.0;
+    
+    // greyscale
+    palette_index = 0;
+    
+    for(int i=0; i<4; i++)
+    {
+        palettes[palette_index].control_colors[i] = zero;
+    }
+    
+    palettes[palette_index].control_colors[0].v = 0.0;
+    palettes[palette_index].control_colors[1].v = 1.0/3.0;
+    palettes[palette_index].control_colors[2].v = 2.0/3.0;
+    palettes[palette_index].control_colors[3].v = 1.0;
+    
+    palettes[palette_index].count = 256;
+    palettes[palette_index].c     = new RGB_Color [256];
+    
+    for(int i=0; i<256; i++)
+    {
+        float u = (float)i / 255.0;
+        HSV_Color hsv = genBezierColor(u, palettes[palette_index].control_colors);
+        RGB_Color rgb = HSV2RGB(hsv);
+        
+        palettes[palette_index].c[i].r = rgb.r * 255.0;
+        palettes[palette_index].c[i].g = rgb.g * 255.0;
+        palettes[palette_index].c[i].b = rgb.b * 255.0;
+    }
+    
+    palette_index++;
+    
+    // remaining
+    for(int j=palette_index; j<PALETTE_COUNT; j++)
+    {
+        palettes[palette_index].count = 0;
+        palette_index++;
+    }
+    
+    palette_index = 0;
+    
+    return palette_index;
+}
+
+void drawFractalImage(SDL_Window* window, SDL_Surface *draw_surface, ZoomView *current_view, Palette *current_palette)
+{
+    SDL_Surface *screen_surface;
+    unsigned    *histogram = NULL;
+    unsigned    histogram_max = 0;
+    
+    if(current_view->use_histogram)
+    {
+        unsigned    *src_pixels = current_view->pixels;
+        size_t      len = current_view->xres * current_view->yres;
+        
+        histogram = new unsigned [len];
+        
+        for(int i=0; i<len; i++)
+        {
+            histogram[i] = 0;
+        }
+
+        for(int i=0; i<len; i++)
+        {
+            unsigned index = src_pixels[i];
+            
+            histogram[index]++;
+        }
+
+        for(int i=0; i<len; i++)
+        {
+            if(histogram[i] > histogram_max)
+                histogram_max = histogram[i];
+        }
+    }
+    
+    SDL_LockSurface(draw_surface);
+    
+    for (int hy=0; hy<current_view->yres; hy++)
+    {
+        unsigned *dst_pixels = (unsigned *)draw_surface->pixels + (draw_surface->pitch >> 2) * hy;
+        
+        if(histogram)
+        {
+            unsigned *src_pixels = &histogram[hy * current_view->xres];
+            
+            for (int hx=0; hx<current_view->xres; hx++)
+            {
+                RGB_Color rgb = genColorFromPalette(src_pixels[hx], histogram_max, current_palette);
+                
+                dst_pixels[hx] = SDL_MapRGBA(draw_surface->format,
+                                             rgb.r,
+                                             rgb.g,
+                                             rgb.b,
+                                             0);
+            }
+        }
+        else
+        {
+            unsigned *src_pixels = &current_view->pixels[hy * current_view->xres];
+
+            for (int hx=0; hx<current_view->xres; hx++)
+            {
+                RGB_Color rgb = genColorFromPalette(src_pixels[hx], current_view->itermax, current_palette);
+                
+                dst_pixels[hx] = SDL_MapRGBA(draw_surface->format,
+                                             rgb.r,
+                                             rgb.g,
+                                             rgb.b,
+                                             0);
+            }
+        }
+    }
+    
+    SDL_UnlockSurface(draw_surface);
+    
+    screen_surface = SDL_GetWindowSurface( window );
+    
+    SDL_SetSurfaceBlendMode(screen_surface, SDL_BLENDMODE_NONE);
+    
+    SDL_BlitSurface(draw_surface, NULL,
+                    screen_surface, NULL);
+}
+
+bool runPaletteDialog(SDL_Window* window, SDL_Surface *draw_surface, ZoomView *current_view, Palette *current_palette)
+{
+    SDL_Surface     *screen_surface;
+    SDL_Event       event;
+    bool            finished;
+    bool            update;
+    float           value[4];
+    unsigned        control_color;
+    
+    finished        = false;
+    update          = true;
+    control_color   = 0;
+    
+    for(int i=0; i<4; i++)
+    {
+        value[i] = current_palette->control_colors[i].v;
+    }
+    
+    while(!finished)
+    {
+        while(SDL_PollEvent(&event))
+        {
+            switch(event.type)
+            {
+                case SDL_KEYDOWN:
+                {
+                    if(event.key.keysym.scancode == SDL_SCANCODE_P)
+                    {
+                        finished = 1;
+                    }
+                    else if(event.key.keysym.scancode == SDL_SCANCODE_RIGHT)
+                    {
+                        value[control_color] += 0.1;
+                        
+                        if(value[control_color] > 1.0)
+                        {
+                            value[control_color] = 1.0;
+                        }
+                        
+                        current_palette->control_colors[control_color].v = value[control_color];
+                        update = true;
+                    }
+                    else if(event.key.keysym.scancode == SDL_SCANCODE_LEFT)
+                    {
+                        value[control_color] -= 0.1;
+                        
+                        if(value[control_color] < 0.0)
+                        {
+                            value[control_color] = 0.0;
+                        }
+                        
+                        current_palette->control_colors[control_color].v = value[control_color];
+                        update = true;
+                    }
+                    else if(event.key.keysym.scancode == SDL_SCANCODE_1)
+                    {
+                        control_color = 0;
+                        update = true;
+                    }
+                    else if(event.key.keysym.scancode == SDL_SCANCODE_2)
+                    {
+                        control_color = 1;
+                        update = true;
+                    }
+                    else if(event.key.keysym.scancode == SDL_SCANCODE_3)
+                    {
+                        control_color = 2;
+                        update = true;
+                    }
+                    else if(event.key.keysym.scancode == SDL_SCANCODE_4)
+                    {
+                        control_color = 3;
+                        update = true;
+                    }
+                    
+                    break;
+                }
+                    
+                case SDL_MOUSEMOTION:
+                    if(event.motion.state != SDL_PRESSED)
+                    {
+                        break;
+                    }
+                    
+                case SDL_MOUSEBUTTONDOWN:
+                {
+                    float mouse_x = (double)event.button.x;
+                    float mouse_y = (double)event.button.y;
+                    
+                    // figure out which circle it was in
+                    update = true;
+                    for(int control_circle=0; control_circle<4; control_circle++)
+                    {
+                        float cx = (2 * control_circle + 1) * current_view->xres / 8.0f;
+                        float cy = current_view->yres / 8.0f;
+                        
+                        float x = cx - mouse_x;
+                        float y = cy - mouse_y;
+                        
+                        float radius = current_view->xres / 12;
+                        float dist = sqrtf(x*x + y*y);
+                        
+                        if(dist <= radius)
+                        {
+                            if(control_color != control_circle)
+                            {
+                                control_color = control_circle;
+                                update = false;
+                            }
+                        }
+                    }
+                    
+                    if(update)
+                    {
+                        float cx = (2 * control_color + 1) * current_view->xres / 8.0f;
+                        float cy = current_view->yres / 8.0f;
+                        
+                        float x = cx - mouse_x;
+                        float y = cy - mouse_y;
+                        
+                        float radius = current_view->xres / 12;
+                        float dist = sqrtf(x*x + y*y);
+                        
+                        if(dist <= radius)
+                        {
+                            x /= dist;
+                            y /= dist;
+                            
+                            float theta = acosf(x) * 180.0 / M_PI;
+                            
+                            if (y < 0)
+                            {
+                                theta = 360 - theta;
+                            }
+                            
+                            current_palette->control_colors[control_color].h = theta;
+                            current_palette->control_colors[control_color].s = dist / radius;
+                            current_palette->control_colors[control_color].v = value[control_color];
+                        }
+                    }
+                    
+                    break;
+                }
+                    
+                case SDL_QUIT:
+                {
+                    return true;
+                }
+            }
+        }
+        
+        // draw base surface
+        if(update)
+        {
+            SDL_LockSurface(draw_surface);
+            
+            HSV_Color   hsv;
+            RGB_Color   rgb;
+            float       dist;
+            float       radius = current_view->xres / 12;
+            
+            current_palette->count = 256;
+            for (int i=0; i<256; i++)
+            {
+                float   u = (float)i / 255.0;
+                
+                hsv = genBezierColor(u, current_palette->control_colors);
+                rgb = HSV2RGB(hsv);
+                
+                current_palette->c[i].r = rgb.r * 255.0;
+                current_palette->c[i].g = rgb.g * 255.0;
+                current_palette->c[i].b = rgb.b * 255.0;
+            }
+            
+            // draw image
+            drawFractalImage(window, draw_surface, current_view, current_palette);
+            
+            // draw HSV palette
+            for (int hy=0; hy<32; hy++)
+            {
+                unsigned *dst_pixels = (unsigned *)draw_surface->pixels + (draw_surface->pitch >> 2) * hy;
+                
+                for (int hx=0; hx<current_view->xres; hx++)
+                {
+                    float   u = (float)hx / (float)current_view->xres;
+                    HSV_Color hsv = genBezierColor(u, current_palette->control_colors);
+                    RGB_Color rgb = HSV2RGB(hsv);
+                    
+                    dst_pixels[hx] = SDL_MapRGBA(draw_surface->format,
+                                                 rgb.r * 255.0,
+                                                 rgb.g * 255.0,
+                                                 rgb.b * 255.0,
+                                                 0);
+                }
+            }
+            
+            // draw HSV control circles
+            for(int control_circle=0; control_circle<4; control_circle++)
+            {
+                float   cx = (2 * control_circle + 1) * current_view->xres / 8.0f;
+                float   cy = current_view->yres / 8.0f;
+                
+                for (int hy=0; hy<current_view->yres; hy++)
+                {
+                    unsigned *dst_pixels = (unsigned *)draw_surface->pixels + (draw_surface->pitch >> 2) * hy;
+                    
+                    for (int hx=0; hx<current_view->xres; hx++)
+                    {
+                        float  x = cx - hx;
+                        float  y = cy - hy;
+                        
+                        dist = sqrtf(x*x + y*y);
+                        
+                        if(dist <= radius)
+                        {
+                            x /= dist;
+                            y /= dist;
+                            
+                            float theta = acosf(x) * 180.0 / M_PI;
+                            
+                            if (y < 0)
+                            {
+                                theta = 360 - theta;
+                            }
+                            
+                            hsv.h = theta;
+                            hsv.s = dist / radius;
+                            hsv.v = value[control_circle];
+                            
+                            rgb = HSV2RGB(hsv);
+                            
+                            dst_pixels[hx] = SDL_MapRGBA(draw_surface->format,
+                                                         rgb.r * 255.0,
+                                                         rgb.g * 255.0,
+                                                         rgb.b * 255.0,
+                                                         0);
+                        }
+                    }
+                }
+                
+                
+                // draw hsv value in circle
+                hsv = current_palette->control_colors[control_circle];
+                
+                float x = cx + radius * cos(hsv.h / (180.0 / M_PI)) * hsv.s;
+                float y = cy + radius * sin(hsv.h / (180.0 / M_PI)) * hsv.s;
+                
+                unsigned *dst_pixels = (unsigned *)draw_surface->pixels + (draw_surface->pitch >> 2) * (int)y;
+                
+                dst_pixels[(int)x] = SDL_MapRGBA(draw_surface->format,
+                                                 0,
+                                                 0,
+                                                 0,
+                                                 0);
+                
+                SDL_UnlockSurface(draw_surface);
+                
+                SDL_SetSurfaceBlendMode(draw_surface, SDL_BLENDMODE_NONE);
+                
+                // blt the draw surface to the screen
+                screen_surface = SDL_GetWindowSurface( window );
+                SDL_SetSurfaceBlendMode(screen_surface, SDL_BLENDMODE_NONE);
+                
+                SDL_BlitSurface(draw_surface, NULL,
+                                screen_surface, NULL);
+                
+                update = false;
+            }
+        }
+        
+        SDL_UpdateWindowSurface( window );
+    }
+    
+    return false;
+}
+
+// zoom as %.*g prints a double with precision digits, and past the double range
+// as the mantissa and exponent in decimal, "2.5e+400"
+static void formatZoom(char *dst, size_t size, FloatExp zoom, int precision)
+{
+    if(zoom.e <= 1023 && zoom.e >= -1022)
+    {
+        snprintf(dst, size, "%.*g", precision, floatExpToDouble(zoom));
+        return;
+    }
+    
+    double digits = zoom.e * log10(2.0) + log10(fabs(zoom.m));
+    double exponent = floor(digits);
+    double mantissa = pow(10.0, digits - exponent);
+    
+    // what %g would round up to 10
+    if(mantissa >= 10.0 - 0.5 * pow(10.0, 1 - precision))
+    {
+        mantissa /= 10.0;
+        exponent += 1.0;
+    }
+    
+    snprintf(dst, size, "%.*ge%+.0f", precision, copysign(mantissa, zoom.m), exponent);
+}
+
+// What Z does to zoom, one more or twice that while the key is held, and no
+// further than 2^kMaxZoomExponent.
+static FloatExp raiseZoom(FloatExp zoom, bool repeat)
+{
+    FloatExp raised = floatExpAdd(zoom, floatExpFromDouble(1.0));
+    
+    if(repeat)
+    {
+        raised = floatExpScale(raised, 1);
+    }
+    
+    return raised.e < kMaxZoomExponent ? raised : makeFloatExp(1.0, kMaxZoomExponent);
+}
+
+// the bits of a view zoomed to zoom from view, see pushZoomView
+static unsigned getZoomViewBits(const ZoomView *view, FloatExp zoom)
+{
+    return std::max((unsigned)mpf_get_prec(view->center_x_mp), getPrecisionBits(zoom, view->xres));
+}
+
+// Starts views[index+1] as a copy of views[index] at zoom. The centers keep
+// their bits and get more when the new zoom needs them, so offsets added at
+// depth are never rounded to the precision of a shallower view.
+static void pushZoomView(ZoomView *views, unsigned index, FloatExp zoom)
+{
+    ZoomView    *view = &views[index + 1];
+    unsigned    bits = getZoomViewBits(&views[index], zoom);
+    
+    *view = views[index];
+    
+    mpf_init2(view->center_x_mp, bits);
+    mpf_init2(view->center_y_mp, bits);
+    mpf_set(view->center_x_mp, views[index].center_x_mp);
+    mpf_set(view->center_y_mp, views[index].center_y_mp);
+    
+    view->zoom      = zoom;
+    view->pixels    = allocPixels(SCREEN_WIDTH * SCREEN_HEIGHT);
+    view->pixels_itermax = 0;
+    
+    initOrbitList(&view->orbits);
+}
+
+static void popZoomView(ZoomView *view)
+{
+    mpf_clear(view->center_x_mp);
+    mpf_clear(view->center_y_mp);
+    
+    freePixels(view->pixels, SCREEN_WIDTH * SCREEN_HEIGHT);
+    freeOrbitList(&view->orbits);
+}
+
+// the view's center moved by offset_x,offset_y times 2^offset_exponent, the
+// doubles follow the mpf ones
+static void moveZoomView(ZoomView *view, double offset_x, double offset_y, int offset_exponent)
+{
+    mpf_t offset;
+    
+    mpf_init2(offset, 64);
+    
+    setScaledOffset(offset, offset_x, offset_exponent);
+    mpf_add(view->center_x_mp, view->center_x_mp, offset);
+    setScaledOffset(offset, offset_y, offset_exponent);
+    mpf_add(view->center_y_mp, view->center_y_mp, offset);
+    
+    mpf_clear(offset);
+    
+    view->center_x  = mpf_get_d(view->center_x_mp);
+    view->center_y  = mpf_get_d(view->center_y_mp);
+}
+
+// how far a click at x,y moves the center of view, whole pixels of its frame so
+// the last frame lines up with the next, see getPanShift. The offsets are times
+// 2^offset_exponent for moveZoomView, they would be under the double range deep.
+static void getClickOffset(const ZoomView *view, int x, int y, double *offset_x, double *offset_y,
+                           int *offset_exponent)
+{
+    *offset_x = (x - (int)view->xres / 2) * 3.0 / (view->zoom.m * view->xres);
+    *offset_y = (y - (int)view->yres / 2) * 3.0 / (view->zoom.m * view->yres);
+    *offset_exponent = -view->zoom.e;
+}
+
+const char *getRenderModeName(unsigned mode)
+{
+    switch(mode)
+    {
+        case kRenderModeDouble:         return "double";
+        case kRenderModeDoubleDouble:   return "double-double";
+#ifdef USE_BIGNUM
+        case kRenderModeBigNUM:         return "bignum";
+        case kRenderModePerturbation:   return "perturbation";
+#endif
+        case kRenderModeOpenCL:         return "OpenCL";
+        case kRenderModeHybrid:         return "hybrid";
+        case kRenderModeAuto:           return "auto";
+    }
+    
+    return "unknown";
+}
+
+// Auto mode: a frame needs getSignificantBits of c plus kLadderGuardBits for
+// the rounding an orbit amplifies, and gets the first mode that has that many,
+// doubles, then double-double, then perturbation. Perturbation goes to floatexp
+// on its own past kFloatExpZoom, and is only trusted with glitch correction on,
+// without it the frame goes to bignum.
+#define kLadderGuardBits    12
+#define kDoubleBits         53
+
+unsigned chooseRenderMode(const ZoomView *view, unsigned xres, char *reason, size_t size)
+{
+    unsigned bits = getSignificantBits(view->center_x, view->center_y, view->zoom, xres) + kLadderGuardBits;
+    
+    if(bits <= kDoubleBits)
+    {
+        snprintf(reason, size, "%u bits needed, doubles have %u", bits, kDoubleBits);
+        return kRenderModeDouble;
+    }
+    
+#ifdef USE_BIGNUM
+    if(bits <= kDoubleDoubleBits)
+    {
+        snprintf(reason, size, "%u bits needed, past doubles, double-double has %u", bits, kDoubleDoubleBits);
+        return kRenderModeDoubleDouble;
+    }
+    
+    if(g_use_glitch_correction)
+    {
+        snprintf(reason, size, "%u bits needed, past double-double, perturbation%s", bits,
+                 floatExpCompare(view->zoom, floatExpFromDouble(kFloatExpZoom)) > 0 ? " with floatexp offsets" : "");
+        return kRenderModePerturbation;
+    }
+    
+    snprintf(reason, size, "%u bits needed, past double-double, bignum as glitch correction is off", bits);
+    return kRenderModeBigNUM;
+#else
+    snprintf(reason, size, "%u bits needed, double-double has %u%s", bits, kDoubleDoubleBits,
+             bits > kDoubleDoubleBits ? " and will pixelate" : "");
+    return kRenderModeDoubleDouble;
+#endif
+}
+
+// the longest center written into a saved file name, in digits
+#define kMaxFileNameDigits      100
+
+// The event loop hands each view to the render thread and goes back to waiting
+// for input. The thread renders into its own pixels, cpu tiles go back through
+// g_tile_queue as they finish and a finished frame's pixels are swapped for the
+// view's by the event loop. A new request cancels the frame in progress.
+typedef struct {
+    mpf_t           center_x_mp;
+    mpf_t           center_y_mp;
+    double          center_x, center_y;
+    FloatExp        zoom;
+    unsigned        xres, yres;
+    unsigned        itermax;
+    unsigned        mode;           // what auto mode picked, never kRenderModeAuto
+    unsigned        generation;     // g_render_generation after the request's cancelRender
+    double          cancelled;      // getSeconds if the request cancelled a frame, else 0
+    float           *cost;          // kCostColumns x kCostRows, see estimateViewCost
+    bool            use_cost;
+    unsigned        *target;        // a speculative frame's pixels, NULL for g_render_pipeline.pixels
+    OrbitList       *orbits;        // where a double frame keeps its pixels still running, NULL not to
+    OrbitList       resume;         // the view's, to carry on instead of a whole frame, itermax 0 for none
+    bool            use_pan;        // only the strips a pan exposed are rendered, see setPanFrame
+    int             pan_x, pan_y;   // whole pixels the view moved from the one base_pixels is of
+    unsigned        *base_pixels;   // the frame a resume or a pan starts from, xres x yres
+} RenderRequest;
+
+struct {
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;
+    RenderRequest   request;        // the latest, under lock
+    bool            quit;
+    unsigned        *pixels;        // the frame in progress, see updateLoop for the swap
+    OrbitList       orbits;         // its pixels still running, the event loop copies them to the view
+    unsigned        done;           // generation of the last frame that finished
+} g_render_pipeline;
+
+static void setRenderRequest(RenderRequest *dst, RenderRequest *src)
+{
+    mpf_set_prec(dst->center_x_mp, mpf_get_prec(src->center_x_mp));
+    mpf_set_prec(dst->center_y_mp, mpf_get_prec(src->center_y_mp));
+    mpf_set(dst->center_x_mp, src->center_x_mp);
+    mpf_set(dst->center_y_mp, src->center_y_mp);
+    
+    dst->center_x   = src->center_x;
+    dst->center_y   = src->center_y;
+    dst->zoom       = src->zoom;
+    dst->xres       = src->xres;
+    dst->yres       = src->yres;
+    dst->itermax    = src->itermax;
+    dst->mode       = src->mode;
+    dst->generation = src->generation;
+    dst->cancelled  = src->cancelled;
+    dst->use_cost   = src->use_cost;
+    dst->target     = src->target;
+    dst->orbits     = src->orbits;
+    dst->use_pan    = src->use_pan;
+    dst->pan_x      = src->pan_x;
+    dst->pan_y      = src->pan_y;
+    
+    // handed over rather than copied, src is written whole by the next requestRender
+    std::swap(dst->resume, src->resume);
+    std::swap(dst->base_pixels, src->base_pixels);
+    
+    if(src->use_cost)
+    {
+        memcpy(dst->cost, src->cost, kCostColumns * kCostRows * sizeof(float));
+    }
+}
+
+// The device renders the first rows of a request, started without waiting so a
+// hybrid frame can keep the calc threads busy meanwhile and finished once they
+// are done. An OpenCL frame is all its rows.
+typedef struct {
+    cl_mem          input_buffer;
+    cl_mem          output_buffer;
+    cl_mem          stats_buffer;
+    cl_event        completion;
+    unsigned        rows;
+    unsigned        pitch;
+    double          elapsed;        // from the enqueue to the end of the kernel, set by finishFrameCL
+} CLFrame;
+
+static void startFrameCL(const RenderRequest *request, unsigned rows, CLFrame *cl)
+{
+    CLWorkInfo  workInfo;
+    cl_int      _err = CL_INVALID_VALUE;
+    unsigned    cl_stats[4] = { 0, 0, 0, 0 };
+    
+    workInfo.center_x   = request->center_x;
+    workInfo.center_y   = request->center_y;
+    workInfo.zoom       = floatExpToDouble(request->zoom);
+    workInfo.xres       = request->xres;
+    workInfo.yres       = request->yres;
+    workInfo.itermax    = request->itermax;
+    workInfo.pitch      = request->xres;
+    workInfo.flags      = g_kernel_options.flags;
+    workInfo.periodicity_epsilon  = g_kernel_options.periodicity_tolerance *
+                                    getPixelSpacing(request->zoom, request->xres);
+    workInfo.periodicity_interval = g_kernel_options.periodicity_interval;
+    
+    size_t      global_work_size[2] = { (size_t)request->xres, (size_t)rows };
+    size_t      pbuffer_size = rows * request->xres * sizeof(unsigned);
+    
+    cl->rows    = rows;
+    cl->pitch   = request->xres;
+    cl->elapsed = 0.0;
+    
+    cl->input_buffer = clCreateBuffer(context, CL_MEM_COPY_HOST_PTR, sizeof(CLWorkInfo), &workInfo, &_err);
+    assert(cl->input_buffer);
+    cl->output_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, pbuffer_size, NULL, &_err);
+    assert(cl->output_buffer);
+    cl->stats_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(cl_stats), cl_stats, &_err);
+    assert(cl->stats_buffer);
+    
+    clSetKernelArg(kernel, 0, sizeof(cl->input_buffer), &cl->input_buffer);
+    clSetKernelArg(kernel, 1, sizeof(cl->output_buffer), &cl->output_buffer);
+    clSetKernelArg(kernel, 2, sizeof(cl->stats_buffer), &cl->stats_buffer);
+    
+    clEnqueueNDRangeKernel(queue, kernel, 2, NULL, global_work_size, NULL, 0, NULL, &cl->completion);
+    clFlush(queue);
+}
+
+// waits for the rows and reads them into pixels, the stats are added to g_frame_stats
+static void finishFrameCL(CLFrame *cl, unsigned *pixels)
+{
+    unsigned    cl_stats[4];
+    cl_ulong    queued = 0, ended = 0;
+    
+    clWaitForEvents(1, &cl->completion);
+    
+    clGetEventProfilingInfo(cl->completion, CL_PROFILING_COMMAND_QUEUED, sizeof(queued), &queued, NULL);
+    clGetEventProfilingInfo(cl->completion, CL_PROFILING_COMMAND_END, sizeof(ended), &ended, NULL);
+    clReleaseEvent(cl->completion);
+    
+    cl->elapsed = (ended - queued) * 1e-9;
+    
+    clEnqueueReadBuffer(queue, cl->output_buffer, CL_TRUE, 0, cl->rows * cl->pitch * sizeof(unsigned), pixels, 0, NULL, NULL);
+    clEnqueueReadBuffer(queue, cl->stats_buffer, CL_TRUE, 0, sizeof(cl_stats), cl_stats, 0, NULL, NULL);
+    
+    g_frame_stats.cardioid_skipped  += cl_stats[0];
+    g_frame_stats.periodic_pixels   += cl_stats[1];
+    g_frame_stats.periodicity_saved += ((unsigned long long)cl_stats[3] << 32) | cl_stats[2];
+    
+    clReleaseMemObject(cl->input_buffer);
+    clReleaseMemObject(cl->output_buffer);
+    clReleaseMemObject(cl->stats_buffer);
+}
+
+static void renderFrameCL(const RenderRequest *request, unsigned *pixels)
+{
+    CLFrame cl;
+    
+    startFrameCL(request, request->yres, &cl);
+    finishFrameCL(&cl, pixels);
+}
+
+// One frame on both sides: the OpenCL device takes the rows above a split, whole
+// tile rows, and the calc threads the tiles below. The split puts g_hybrid_share
+// of the predicted cost on the device, from the cost map or by pixel count with
+// none. A finished frame sets the share from the cost each side got through per
+// second, halfway from the old one so one odd frame does not swing it, so both
+// sides should finish together next time. Each side keeps at least a tile row
+// to be measured by. Without a device it is a double frame.
+static bool renderFrameHybrid(const RenderRequest *request, FrameInfo *frame, TileInfo *tiles)
+{
+    std::vector<double> row_cost(frame->yres);
+    double              total = 0.0, device_cost = 0.0;
+    unsigned            rows = 0;
+    unsigned            count, cpu_count = 0;
+    CLFrame             cl;
+    
+    for(unsigned y=0; y<frame->yres; y++)
+    {
+        if(frame->cost)
+        {
+            for(unsigned cx=0; cx<kCostColumns; cx++)
+            {
+                row_cost[y] += frame->cost[(y / kCostCell) * kCostColumns + cx] * kCostCell;
+            }
+        }
+        else
+        {
+            row_cost[y] = frame->xres;
+        }
+        
+        total += row_cost[y];
+    }
+    
+    if(kernel && frame->yres > 2 * g_tile_size)
+    {
+        double  target = g_hybrid_share * total;
+        
+        while(rows + g_tile_size < frame->yres)
+        {
+            double band = 0.0;
+            
+            for(unsigned y=rows; y<rows + g_tile_size; y++)
+            {
+                band += row_cost[y];
+            }
+            
+            // the nearest tile row boundary to the target
+            if(rows && device_cost + 0.5 * band > target)
+                break;
+            
+            device_cost += band;
+            rows        += g_tile_size;
+        }
+        
+        startFrameCL(request, rows, &cl);
+    }
+    
+    count = getFrameTiles(frame, g_tile_size, g_tile_order, tiles);
+    
+    // the rows above the split are the device's, the tiles below keep their order
+    for(unsigned i=0; i<count; i++)
+    {
+        if(tiles[i].rect.y0 >= rows)
+        {
+            tiles[cpu_count++] = tiles[i];
+        }
+    }
+    
+    double  start = getSeconds();
+    bool    done = renderTilesCPU(frame, tiles, cpu_count, request->generation);
+    double  cpu_elapsed = getSeconds() - start;
+    
+    if(!rows)
+        return done;
+    
+    finishFrameCL(&cl, frame->pixels);
+    
+    if(!done)
+        return false;
+    
+    Rect band = { 0, 0, frame->xres - 1, rows - 1 };
+    
+    if(pushTileQueue(frame->generation, &band))
+    {
+        wakeEventLoop();
+    }
+    
+    double device_rate = device_cost / std::max(cl.elapsed, 1e-6);
+    double cpu_rate = (total - device_cost) / std::max(cpu_elapsed, 1e-6);
+    double share = g_hybrid_share;
+    
+    g_hybrid_share = 0.5 * (share + device_rate / (device_rate + cpu_rate));
+    
+    printf("Hybrid: OpenCL %u rows in %.3fs, calc threads %u rows in %.3fs, OpenCL share %.2f -> %.2f\n",
+           rows, cl.elapsed, frame->yres - rows, cpu_elapsed, share, g_hybrid_share);
+    
+    return true;
+}
+
+// The frame of a request, without the reference orbit a perturbation frame
+// also needs (setReferenceFrame) so whoever renders none of its tiles can skip it.
+static void setRequestFrame(const RenderRequest *request, FrameInfo *frame, unsigned *pixels)
+{
+    setFrameCenter(frame, request->center_x_mp, request->center_y_mp);
+    frame->zoom         = request->zoom;
+    frame->xres         = request->xres;
+    frame->yres         = request->yres;
+    frame->itermax      = request->itermax;
+    frame->flags        = (g_use_subdivision ? kUSE_SUBDIVISION : 0) | (g_use_focus ? kUSE_FOCUS : 0);
+    frame->pixels       = pixels;
+    frame->reference    = NULL;
+    frame->bla          = NULL;
+    frame->cost         = request->use_cost ? request->cost : NULL;
+    frame->generation   = request->generation;
+    
+    // a speculative frame is not drawn until it is asked for
+    if(!request->target)
+    {
+        frame->flags |= kUSE_TILE_QUEUE;
+    }
+    
+#ifdef USE_BIGNUM
+    if(request->mode == kRenderModeDouble && g_use_escalation)
+    {
+        frame->flags |= kUSE_ESCALATION;
+    }
+#endif
+    
+    if(request->mode == kRenderModeDoubleDouble)
+    {
+        frame->flags |= kUSE_DOUBLEDOUBLE;
+        
+        if(getPrecisionBits(frame->zoom, frame->xres) > kDoubleDoubleBits)
+        {
+            char zoom[32];
+            
+            formatZoom(zoom, sizeof(zoom), frame->zoom, 6);
+            printf("Zoom %s needs %u bits, double-double has %u and will pixelate\n",
+                   zoom, getPrecisionBits(frame->zoom, frame->xres), kDoubleDoubleBits);
+        }
+    }
+#ifdef USE_BIGNUM
+    if(request->mode == kRenderModeBigNUM)
+    {
+        frame->flags |= kUSE_BIGNUM;
+        
+        unsigned bits = getPrecisionBits(frame->zoom, frame->xres);
+        
+        if(getFixedPointLimbs(bits))
+        {
+            printf("Bignum at %u bits in %u limb fixed point\n", bits, getFixedPointLimbs(bits));
+        }
+        else
+        {
+            printf("Bignum at %u bits in mpf, more than %u limbs\n", bits, kFixedPointMaxLimbs);
+        }
+    }
+#endif
+}
+
+#ifdef USE_BIGNUM
+// one gmp orbit at the center of a perturbation frame, every pixel follows it in doubles
+static void setReferenceFrame(FrameInfo *frame, ReferenceOrbit *reference_orbit, BLATable *bla_table)
+{
+    computeReferenceOrbit(reference_orbit, frame->center_x_mp, frame->center_y_mp, 0.0, 0.0, 0,
+                          getPrecisionBits(frame->zoom, frame->xres), frame->itermax);
+    
+    printf("Reference orbit %u iterations at %u bits in %.3fs\n",
+           reference_orbit->length, reference_orbit->precision, reference_orbit->elapsed);
+    
+    frame->flags        |= kUSE_PERTURBATION;
+    frame->reference    = reference_orbit;
+    frame->reference_x  = frame->reference_y = 0.5;
+    
+    if(g_use_glitch_correction)
+    {
+        frame->flags |= kUSE_GLITCH_CORRECTION;
+    }
+    
+    // shallower views keep the vector double kernels
+    if(floatExpCompare(frame->zoom, floatExpFromDouble(kFloatExpZoom)) > 0)
+    {
+        char zoom[32];
+        
+        formatZoom(zoom, sizeof(zoom), frame->zoom, 6);
+        printf("Zoom %s is past %g, pixel offsets use floatexp\n", zoom, kFloatExpZoom);
+        
+        frame->flags |= kUSE_FLOATEXP;
+    }
+    
+    if(g_use_bla)
+    {
+        buildBLATable(bla_table, reference_orbit, getMaxPixelOffset(frame->zoom), g_bla_epsilon);
+        
+        printf("BLA table %u levels, %zu bytes in %.3fs\n", bla_table->levels, bla_table->bytes, bla_table->elapsed);
+        
+        frame->bla  = bla_table;
+    }
+}
+#endif
+
+// Other processes that render tiles for this one, given with -workers. Frames
+// go out to them in jobs of kTileJobSize square that each worker splits into
+// tiles of its own, kTileJobsInFlight at a time so the next job is on the wire
+// while one renders. The connections stay open from frame to frame.
+#define kMaxTileWorkers         64
+#define kTileJobSize            256
+#define kTileJobsInFlight       2
+#define kTileWorkerRetries      3       // failed connects in a row before a worker sits out the frame
+
+typedef struct {
+    const char      *address;
+    int             fd;             // -1 while not connected
+    unsigned        jobs;           // the rest are for the last frame, see renderFrameWorkers
+    unsigned long long pixels;
+    unsigned long long bytes;       // both ways
+    double          busy;           // rendering, as the worker timed it
+    double          elapsed;
+    unsigned        failures;
+} TileWorker;
+
+struct {
+    unsigned        count;
+    TileWorker      workers[kMaxTileWorkers];
+} g_tile_workers;
+
+// one frame's jobs, shared by the connections
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;
+    FrameInfo       *frame;
+    TileInfo        *jobs;
+    TileJob         view;           // what every job has in common
+    std::string     center_x, center_y;
+    std::vector<unsigned> pending;  // indices into jobs, taken from the back
+    unsigned        in_flight;      // sent and not answered, on every connection
+} TileWorkerFrame;
+
+typedef struct {
+    TileWorkerFrame *shared;
+    TileWorker      *worker;
+} TileWorkerTask;
+
+// -workers a,b,c, the list is kept for the addresses
+static void setTileWorkers(const char *list)
+{
+    char *addresses = strdup(list);
+    
+    for(char *address = strtok(addresses, ","); address && g_tile_workers.count < kMaxTileWorkers; address = strtok(NULL, ","))
+    {
+        TileWorker *worker = &g_tile_workers.workers[g_tile_workers.count++];
+        
+        memset(worker, 0, sizeof(*worker));
+        worker->address = address;
+        worker->fd      = -1;
+    }
+}
+
+// the tiles of frame clipped to r, in getFrameTiles order
+static unsigned getRectTiles(FrameInfo *frame, const Rect *r, TileInfo *tiles)
+{
+    unsigned count = getFrameTiles(frame, g_tile_size, g_tile_order, tiles);
+    unsigned kept = 0;
+    
+    for(unsigned i=0; i<count; i++)
+    {
+        TileInfo tile = tiles[i];
+        
+        tile.rect.x0 = std::max(tile.rect.x0, r->x0);
+        tile.rect.y0 = std::max(tile.rect.y0, r->y0);
+        tile.rect.x1 = std::min(tile.rect.x1, r->x1);
+        tile.rect.y1 = std::min(tile.rect.y1, r->y1);
+        
+        if(tile.rect.x0 <= tile.rect.x1 && tile.rect.y0 <= tile.rect.y1)
+        {
+            tiles[kept++] = tile;
+        }
+    }
+    
+    return kept;
+}
+
+// the kTileJob options of the frames asked for now
+static unsigned getFrameOptions(void)
+{
+    return (g_use_subdivision ? kTileJobSubdivision : 0) | (g_use_bla ? kTileJobBLA : 0) |
+           (g_use_glitch_correction ? kTileJobGlitchCorrection : 0) | (g_use_escalation ? kTileJobEscalation : 0);
+}
+
+static void setTileJobView(TileJob *job, const RenderRequest *request)
+{
+    memset(job, 0, sizeof(*job));
+    
+    job->mode       = request->mode;
+    job->options    = getFrameOptions();
+    job->xres       = request->xres;
+    job->yres       = request->yres;
+    job->itermax    = request->itermax;
+    job->precision  = (uint32_t)mpf_get_prec(request->center_x_mp);
+    job->zoom.m     = request->zoom.m;     // not the struct, its padding stays 0
+    job->zoom.e     = request->zoom.e;
+    job->bla_epsilon            = g_bla_epsilon;
+    job->periodicity_tolerance  = g_kernel_options.periodicity_tolerance;
+    job->periodicity_interval   = g_kernel_options.periodicity_interval;
+    job->kernel_flags           = g_kernel_options.flags;
+}
+
+// the next job for a connection, none once the frame is out of them or cancelled
+static bool takeWorkerJob(TileWorkerFrame *shared, unsigned *index)
+{
+    bool taken = false;
+    
+    pthread_mutex_lock(&shared->lock);
+    
+    if(!shared->pending.empty() && !isFrameCancelled(shared->frame))
+    {
+        *index = shared->pending.back();
+        shared->pending.pop_back();
+        shared->in_flight++;
+        taken = true;
+    }
+    
+    pthread_mutex_unlock(&shared->lock);
+    
+    return taken;
+}
+
+// a connection with nothing to do waits while another might still drop and hand its jobs back
+static bool waitWorkerJobs(TileWorkerFrame *shared)
+{
+    pthread_mutex_lock(&shared->lock);
+    
+    while(shared->pending.empty() && shared->in_flight)
+    {
+        pthread_cond_wait(&shared->wake, &shared->lock);
+    }
+    
+    bool more = !shared->pending.empty() && !isFrameCancelled(shared->frame);
+    
+    pthread_mutex_unlock(&shared->lock);
+    
+    return more;
+}
+
+static void finishWorkerJobs(TileWorkerFrame *shared, const unsigned *returned, unsigned count, unsigned finished)
+{
+    pthread_mutex_lock(&shared->lock);
+    
+    for(unsigned i=0; i<count; i++)
+    {
+        shared->pending.push_back(returned[i]);
+    }
+    
+    shared->in_flight -= count + finished;
+    
+    pthread_cond_broadcast(&shared->wake);
+    pthread_mutex_unlock(&shared->lock);
+}
+
+// One connection for one frame: keeps its worker kTileJobsInFlight jobs ahead
+// and copies the results into the frame. Jobs on a connection that drops go
+// back for the others, or for this one once it has reconnected.
+static void *runWorkerConnection(void *arg)
+{
+    TileWorkerTask  *task = (TileWorkerTask *)arg;
+    TileWorkerFrame *shared = task->shared;
+    TileWorker      *worker = task->worker;
+    FrameInfo       *frame = shared->frame;
+    unsigned        *pixels = new unsigned [kTileJobSize * kTileJobSize];
+    unsigned        sent[kTileJobsInFlight];
+    unsigned        sent_count = 0;
+    unsigned        attempts = 0;
+    double          start = getSeconds();
+    
+    for(;;)
+    {
+        if(worker->fd < 0)
+        {
+            worker->fd = connectTileSocket(worker->address);
+            
+            if(worker->fd < 0)
+            {
+                worker->failures++;
+                
+                if(++attempts >= kTileWorkerRetries)
+                {
+                    printf("Worker %s: cannot connect, its jobs go to the others\n", worker->address);
+                    break;
+                }
+                
+                usleep(100000 * attempts);
+                continue;
+            }
+        }
+        
+        attempts = 0;
+        
+        bool        lost = false;
+        bool        refused = false;
+        unsigned    index;
+        
+        for(;;)
+        {
+            while(sent_count < kTileJobsInFlight && takeWorkerJob(shared, &index))
+            {
+                TileJob job = shared->view;
+                
+                job.id  = index;
+                job.x0  = shared->jobs[index].rect.x0;
+                job.y0  = shared->jobs[index].rect.y0;
+                job.x1  = shared->jobs[index].rect.x1;
+                job.y1  = shared->jobs[index].rect.y1;
+                
+                sent[sent_count++] = index;
+                
+                if(!sendTileJob(worker->fd, &job, shared->center_x, shared->center_y))
+                {
+                    lost = true;
+                    break;
+                }
+                
+                worker->bytes += sizeof(job) + shared->center_x.size() + shared->center_y.size();
+            }
+            
+            if(lost)
+                break;
+            
+            if(!sent_count)
+            {
+                if(!waitWorkerJobs(shared))
+                    break;
+                
+                continue;
+            }
+            
+            TileResult  result;
+            const Rect  *r = &shared->jobs[sent[0]].rect;
+            unsigned    width = r->x1 - r->x0 + 1;
+            unsigned    height = r->y1 - r->y0 + 1;
+            
+            if(!recvTileResult(worker->fd, &result, pixels, kTileJobSize * kTileJobSize) || result.id != sent[0])
+            {
+                lost = true;
+                break;
+            }
+            
+            if(result.status != kTileStatusOK || result.pixels != width * height)
+            {
+                printf("Worker %s: refused a job with status %u, its jobs go to the others\n", worker->address, result.status);
+                
+                refused = true;
+                break;
+            }
+            
+            for(unsigned y=0; y<height; y++)
+            {
+                memcpy(&frame->pixels[(r->y0 + y) * frame->xres + r->x0], &pixels[y * width], width * sizeof(unsigned));
+            }
+            
+            worker->jobs++;
+            worker->pixels  += result.pixels;
+            worker->bytes   += sizeof(result) + result.pixels * sizeof(unsigned);
+            worker->busy    += result.elapsed;
+            
+            addKernelStats(&g_frame_stats, &result.stats);
+            
+            if((frame->flags & kUSE_TILE_QUEUE) && !isFrameCancelled(frame) && pushTileQueue(frame->generation, r))
+            {
+                wakeEventLoop();
+            }
+            
+            sent_count--;
+            memmove(&sent[0], &sent[1], sent_count * sizeof(*sent));
+            
+            finishWorkerJobs(shared, NULL, 0, 1);
+        }
+        
+        if(!lost && !refused)
+            break;
+        
+        finishWorkerJobs(shared, sent, sent_count, 0);
+        
+        if(lost)
+        {
+            printf("Worker %s: connection lost, %u jobs handed back\n", worker->address, sent_count);
+        }
+        
+        sent_count = 0;
+        worker->failures++;
+        
+        closeTileSocket(worker->fd);
+        worker->fd = -1;
+        
+        if(refused)
+            break;
+    }
+    
+    worker->elapsed = getSeconds() - start;
+    
+    delete [] pixels;
+    
+    return NULL;
+}
+
+// Fans the frame out to g_tile_workers in jobs and waits for them. Returns the
+// count of tiles put in tiles for the jobs no worker could take, those are left
+// for the calc threads.
+static unsigned renderFrameWorkers(const RenderRequest *request, FrameInfo *frame, TileInfo *tiles)
+{
+    TileWorkerFrame shared;
+    TileWorkerTask  tasks[kMaxTileWorkers];
+    pthread_t       threads[kMaxTileWorkers];
+    unsigned        columns = (frame->xres + kTileJobSize - 1) / kTileJobSize;
+    unsigned        rows = (frame->yres + kTileJobSize - 1) / kTileJobSize;
+    std::vector<TileInfo> jobs(std::max(columns, rows) * std::max(columns, rows));
+    unsigned        job_count = getFrameTiles(frame, kTileJobSize, g_tile_order, &jobs[0]);
+    double          start = getSeconds();
+    
+    pthread_mutex_init(&shared.lock, NULL);
+    pthread_cond_init(&shared.wake, NULL);
+    shared.frame        = frame;
+    shared.jobs         = &jobs[0];
+    shared.in_flight    = 0;
+    
+    setTileJobView(&shared.view, request);
+    getWireCenter(&shared.center_x, request->center_x_mp);
+    getWireCenter(&shared.center_y, request->center_y_mp);
+    
+    // backwards, so they are taken in curve order
+    for(unsigned i=job_count; i>0; i--)
+    {
+        shared.pending.push_back(i - 1);
+    }
+    
+    for(unsigned i=0; i<g_tile_workers.count; i++)
+    {
+        TileWorker *worker = &g_tile_workers.workers[i];
+        
+        worker->jobs        = 0;
+        worker->pixels      = 0;
+        worker->bytes       = 0;
+        worker->busy        = 0.0;
+        worker->elapsed     = 0.0;
+        worker->failures    = 0;
+        
+        tasks[i].shared = &shared;
+        tasks[i].worker = worker;
+        
+        pthread_create(&threads[i], NULL, runWorkerConnection, &tasks[i]);
+    }
+    
+    for(unsigned i=0; i<g_tile_workers.count; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    
+    double elapsed = getSeconds() - start;
+    
+    for(unsigned i=0; i<g_tile_workers.count; i++)
+    {
+        TileWorker *worker = &g_tile_workers.workers[i];
+        
+        printf("Worker %s: %u jobs, %.2f Mpixels/s, %.2f MB, busy %.0f%%, %u failures\n",
+               worker->address, worker->jobs, worker->pixels / std::max(worker->elapsed, 1e-6) * 1e-6,
+               worker->bytes / (1024.0 * 1024.0), 100.0 * worker->busy / std::max(worker->elapsed, 1e-6), worker->failures);
+    }
+    
+    unsigned count = 0;
+    
+    if(!isFrameCancelled(frame))
+    {
+        for(unsigned i=0; i<shared.pending.size(); i++)
+        {
+            count += getRectTiles(frame, &jobs[shared.pending[i]].rect, &tiles[count]);
+        }
+        
+        printf("Workers: %u of %u jobs in %.3fs, %u tiles left for the calc threads\n",
+               job_count - (unsigned)shared.pending.size(), job_count, elapsed, count);
+    }
+    
+    pthread_mutex_destroy(&shared.lock);
+    pthread_cond_destroy(&shared.wake);
+    
+    return count;
+}
+
+static bool isTileJobRenderable(const TileJob *job)
+{
+    bool mode = job->mode == kRenderModeDouble || job->mode == kRenderModeDoubleDouble;
+    
+#ifdef USE_BIGNUM
+    mode = mode || job->mode == kRenderModeBigNUM || job->mode == kRenderModePerturbation;
+#endif
+    
+    // a normalized zoom mantissa also keeps out inf and nan
+    return mode && job->xres && job->xres <= SCREEN_WIDTH && job->yres && job->yres <= SCREEN_HEIGHT && job->itermax &&
+           job->x0 <= job->x1 && job->x1 < job->xres && job->y0 <= job->y1 && job->y1 < job->yres &&
+           (job->x1 - job->x0 + 1) * (job->y1 - job->y0 + 1) <= kTileJobSize * kTileJobSize &&
+           job->precision && job->precision <= 4 * kMaxWireCenterLength &&
+           job->zoom.m >= 1.0 && job->zoom.m < 2.0 && abs(job->zoom.e) <= kMaxZoomExponent;
+}
+
+// all but the tile
+static bool isSameTileView(const TileJob *a, const TileJob *b)
+{
+    return a->mode == b->mode && a->options == b->options && a->xres == b->xres && a->yres == b->yres &&
+           a->itermax == b->itermax && a->precision == b->precision && !floatExpCompare(a->zoom, b->zoom) &&
+           a->bla_epsilon == b->bla_epsilon && a->periodicity_tolerance == b->periodicity_tolerance &&
+           a->periodicity_interval == b->periodicity_interval && a->kernel_flags == b->kernel_flags;
+}
+
+// The -worker process: renders the jobs that come in on address, for one
+// coordinator at a time, until it is killed. The frame of the last view is
+// kept with its reference orbit, the jobs of a frame all share it. Its pixels
+// are only ever touched under the jobs, the rest of the buffer stays unmapped.
+static int runTileWorker(const char *address)
+{
+    int             listener = listenTileSocket(address);
+    RenderRequest   request;
+    FrameInfo       frame;
+    TileJob         view, job;
+    std::string     view_x, view_y, center_x, center_y;
+    bool            have_view = false;
+    unsigned        *pixels = allocPixels(SCREEN_WIDTH * SCREEN_HEIGHT);
+    unsigned        *result_pixels = new unsigned [kTileJobSize * kTileJobSize];
+    TileInfo        *tiles = new TileInfo [kMaxTileCount];
+#ifdef USE_BIGNUM
+    ReferenceOrbit  reference_orbit;
+    BLATable        bla_table;
+    
+    initReferenceOrbit(&reference_orbit);
+    initBLATable(&bla_table);
+#endif
+    
+    if(listener < 0)
+    {
+        printf("Worker cannot listen on %s\n", address);
+        return 1;
+    }
+    
+    mpf_init2(request.center_x_mp, 64);
+    mpf_init2(request.center_y_mp, 64);
+    request.generation  = 0;
+    request.cancelled   = 0.0;
+    request.cost        = NULL;
+    request.use_cost    = false;
+    request.target      = NULL;
+    request.orbits      = NULL;
+    request.use_pan     = false;
+    request.base_pixels = NULL;
+    initOrbitList(&request.resume);
+    memset(&view, 0, sizeof(view));
+    
+    printf("Worker on %s, %u calc threads\n", address, g_work_pool.thread_count);
+    
+    for(;;)
+    {
+        int fd = accept(listener, NULL, NULL);
+        
+        if(fd < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            
+            printf("Worker accept failed, %s\n", strerror(errno));
+            break;
+        }
+        
+        unsigned jobs = 0;
+        
+        while(recvTileJob(fd, &job, &center_x, &center_y))
+        {
+            TileResult  result;
+            double      start = getSeconds();
+            
+            memset(&result, 0, sizeof(result));
+            result.id       = job.id;
+            result.status   = isTileJobRenderable(&job) ? kTileStatusOK : kTileStatusBadJob;
+            
+            if(result.status == kTileStatusOK &&
+               (!have_view || !isSameTileView(&job, &view) || center_x != view_x || center_y != view_y))
+            {
+                // the coordinator's options, not this process's
+                g_use_subdivision       = job.options & kTileJobSubdivision;
+                g_use_bla               = job.options & kTileJobBLA;
+                g_use_glitch_correction = job.options & kTileJobGlitchCorrection;
+                g_use_escalation        = job.options & kTileJobEscalation;
+                g_bla_epsilon           = job.bla_epsilon;
+                g_kernel_options.flags                  = job.kernel_flags;
+                g_kernel_options.periodicity_tolerance  = job.periodicity_tolerance;
+                g_kernel_options.periodicity_interval   = std::max(job.periodicity_interval, 1u);
+                
+                mpf_set_prec(request.center_x_mp, job.precision);
+                mpf_set_prec(request.center_y_mp, job.precision);
+                
+                have_view = setWireCenter(request.center_x_mp, center_x) && setWireCenter(request.center_y_mp, center_y);
+                
+                if(have_view)
+                {
+                    request.center_x    = mpf_get_d(request.center_x_mp);
+                    request.center_y    = mpf_get_d(request.center_y_mp);
+                    request.zoom        = job.zoom;
+                    request.xres        = job.xres;
+                    request.yres        = job.yres;
+                    request.itermax     = job.itermax;
+                    request.mode        = job.mode;
+                    
+                    setRequestFrame(&request, &frame, pixels);
+                    frame.flags &= ~(kUSE_TILE_QUEUE | kUSE_FOCUS);
+#ifdef USE_BIGNUM
+                    if(request.mode == kRenderModePerturbation)
+                    {
+                        setReferenceFrame(&frame, &reference_orbit, &bla_table);
+                    }
+#endif
+                    view    = job;
+                    view_x  = center_x;
+                    view_y  = center_y;
+                }
+                else
+                {
+                    result.status = kTileStatusBadJob;
+                }
+            }
+            
+            if(result.status == kTileStatusOK)
+            {
+                Rect        r = { job.x0, job.y0, job.x1, job.y1 };
+                unsigned    width = job.x1 - job.x0 + 1;
+                
+                memset(&g_frame_stats, 0, sizeof(g_frame_stats));
+                
+                renderTilesCPU(&frame, tiles, getRectTiles(&frame, &r, tiles), 0);
+                
+                result.stats = g_frame_stats;
+                
+                for(unsigned y=job.y0; y<=job.y1; y++)
+                {
+                    memcpy(&result_pixels[(y - job.y0) * width], &pixels[y * job.xres + job.x0], width * sizeof(unsigned));
+                }
+                
+                result.pixels = width * (job.y1 - job.y0 + 1);
+            }
+            
+            result.elapsed = getSeconds() - start;
+            
+            if(!sendTileResult(fd, &result, result_pixels))
+                break;
+            
+            jobs++;
+        }
+        
+        closeTileSocket(fd);
+        
+        printf("Worker: coordinator gone after %u jobs\n", jobs);
+    }
+    
+    closeTileSocket(listener);
+    
+    return 1;
+}
+
+#ifdef USE_BIGNUM
+static bool renderRequest(const RenderRequest *request, unsigned *pixels, TileInfo *tiles,
+                          ReferenceOrbit *reference_orbit, BLATable *bla_table)
+#else
+static bool renderRequest(const RenderRequest *request, unsigned *pixels, TileInfo *tiles)
+#endif
+{
+    memset(&g_frame_stats, 0, sizeof(g_frame_stats));
+    
+    if(request->orbits)
+    {
+        request->orbits->itermax = 0;
+    }
+    
+    // without a device an OpenCL frame is a hybrid one, all on the calc threads
+    if(request->mode == kRenderModeOpenCL && kernel)
+    {
+        renderFrameCL(request, pixels);
+    }
+    else
+    {
+        FrameInfo   frame;
+        bool        done;
+        
+        setRequestFrame(request, &frame, pixels);
+        
+        // the frames escalation or the workers have a hand in are not kept, nor a pan's,
+        // the pixels it copies left their orbits with the last frame
+        if(request->orbits && request->mode == kRenderModeDouble && !(frame.flags & kUSE_ESCALATION) &&
+           !g_tile_workers.count && !request->use_pan)
+        {
+            startOrbitList(request->orbits, request->xres, request->yres, request->itermax);
+            
+            frame.flags     |= kUSE_ORBITS;
+            frame.orbits    = request->orbits;
+        }
+        
+        if(request->resume.itermax && request->resume.itermax < request->itermax && (frame.flags & kUSE_ORBITS))
+        {
+            // scattered pixels, the window keeps the view's frame until this one is swapped in
+            frame.flags &= ~kUSE_TILE_QUEUE;
+            
+            memcpy(pixels, request->base_pixels, request->xres * request->yres * sizeof(unsigned));
+            
+            done = resumeFrame(&frame, &request->resume, request->generation);
+            
+            if(done)
+            {
+                printf("Resumed %u pixels and %u filled rectangles from itermax %u, %u still running\n",
+                       request->resume.count, request->resume.filled_count,
+                       request->resume.itermax, frame.orbits->count);
+            }
+        }
+        else if(request->mode == kRenderModeHybrid || request->mode == kRenderModeOpenCL)
+        {
+            done = renderFrameHybrid(request, &frame, tiles);
+        }
+        else
+        {
+            Rect        overlap;
+            unsigned    count;
+            
+            // the workers render what they can, the tiles they leave are done here
+            if(g_tile_workers.count)
+            {
+                count = renderFrameWorkers(request, &frame, tiles);
+            }
+            else if(request->use_pan)
+            {
+                count = setPanFrame(&frame, request->base_pixels, request->pan_x, request->pan_y, g_tile_size,
+                                    g_tile_order, tiles, &overlap);
+                
+                // what the last frame had is drawn at once, the strips follow as they finish
+                if((frame.flags & kUSE_TILE_QUEUE) && pushTileQueue(request->generation, &overlap))
+                {
+                    wakeEventLoop();
+                }
+            }
+            else
+            {
+                count = getFrameTiles(&frame, g_tile_size, g_tile_order, tiles);
+            }
+            
+#ifdef USE_BIGNUM
+            if(count && request->mode == kRenderModePerturbation)
+            {
+                setReferenceFrame(&frame, reference_orbit, bla_table);
+            }
+#endif
+            
+            done = count ? renderTilesCPU(&frame, tiles, count, request->generation) : !isFrameCancelled(&frame);
+            
+            if(done && request->use_pan)
+            {
+                unsigned reused = (overlap.x1 - overlap.x0 + 1) * (overlap.y1 - overlap.y0 + 1);
+                
+                printf("Panned %d,%d pixels, %u of %u pixels (%.1f%%) reused from the last frame\n",
+                       request->pan_x, request->pan_y, reused, request->xres * request->yres,
+                       100.0 * reused / (request->xres * request->yres));
+            }
+        }
+        
+        if(!done)
+        {
+            printf("Frame cancelled\n");
+            
+            return false;
+        }
+    }
+    
+    printf("Frame %u x %u itermax %u: %llu pixels skipped by the cardioid / bulb test, "
+           "%llu periodic pixels saved %llu iterations, %llu pixels filled by subdivision, "
+           "%llu pixels outlived the reference, BLA skipped %llu iterations in %llu steps, "
+           "%llu glitched pixels redone with %llu references in %llu passes, %llu unresolved, "
+           "%llu pixels escalated to bignum\n",
+           request->xres, request->yres, request->itermax, g_frame_stats.cardioid_skipped,
+           g_frame_stats.periodic_pixels, g_frame_stats.periodicity_saved, g_frame_stats.subdivision_filled,
+           g_frame_stats.reference_exhausted, g_frame_stats.bla_skipped, g_frame_stats.bla_steps,
+           g_frame_stats.glitched_pixels, g_frame_stats.glitch_references, g_frame_stats.glitch_passes,
+           g_frame_stats.glitch_unresolved, g_frame_stats.escalated_pixels);
+    
+    return true;
+}
+
+// -test-workers <n>: starts n workers of this binary on unix sockets, renders a
+// few views through them and on the calc threads here, and compares the pixels.
+// The first worker is killed before the last view, the others take its jobs.
+// Glitch correction on a worker only sees the glitched pixels of its job and
+// picks other references than a local frame would, so the perturbation view is
+// reported but can not fail. Returns the exit status.
+static int testTileWorkers(const char *self, unsigned count)
+{
+    static const struct {
+        const char  *name;
+        double      center_x, center_y, zoom;
+        unsigned    itermax, mode, res;
+    } views[] = {
+        { "double",         -0.7,               0.0,                1.0,    256,    kRenderModeDouble,          1024 },
+        { "double-double",  -0.743643887037151, 0.131825904205330,  1e20,   4096,   kRenderModeDoubleDouble,    512 },
+#ifdef USE_BIGNUM
+        { "bignum",         -0.743643887037151, 0.131825904205330,  1e6,    1024,   kRenderModeBigNUM,          128 },
+        { "perturbation",   -0.743643887037151, 0.131825904205330,  1e10,   4096,   kRenderModePerturbation,    1024 },
+#endif
+        { "worker killed",  0.2925755,          -0.0149977,         1e3,    1024,   kRenderModeDouble,          1024 },
+    };
+    const unsigned  view_count = sizeof(views) / sizeof(*views);
+    pid_t           pids[kMaxTileWorkers];
+    char            paths[kMaxTileWorkers][64];
+    char            threads[16];
+    TileInfo        *tiles = new TileInfo [kMaxTileCount];
+    unsigned        *local = allocPixels(SCREEN_WIDTH * SCREEN_HEIGHT);
+    unsigned        *remote = allocPixels(SCREEN_WIDTH * SCREEN_HEIGHT);
+    unsigned        failed = 0;
+    RenderRequest   request;
+#ifdef USE_BIGNUM
+    ReferenceOrbit  reference_orbit;
+    BLATable        bla_table;
+    
+    initReferenceOrbit(&reference_orbit);
+    initBLATable(&bla_table);
+#endif
+    
+    count = std::min(std::max(count, 1u), (unsigned)kMaxTileWorkers);
+    snprintf(threads, sizeof(threads), "%u", std::max(g_work_pool.thread_count / count, 1u));
+    
+    g_tile_workers.count = 0;
+    
+    for(unsigned i=0; i<count; i++)
+    {
+        snprintf(paths[i], sizeof(paths[i]), "/tmp/mandelbrot-worker-%d-%u.sock", (int)getpid(), i);
+        unlink(paths[i]);
+        
+        pids[i] = fork();
+        
+        if(pids[i] == 0)
+        {
+            execl(self, self, "-threads", threads, "-worker", paths[i], (char *)NULL);
+            _exit(127);
+        }
+        
+        TileWorker *worker = &g_tile_workers.workers[g_tile_workers.count++];
+        
+        memset(worker, 0, sizeof(*worker));
+        worker->address = paths[i];
+        worker->fd      = -1;
+    }
+    
+    // until every worker is listening
+    for(unsigned i=0, tries=0; i<count && tries<100; tries++)
+    {
+        struct stat st;
+        
+        if(stat(paths[i], &st) == 0)
+            i++;
+        else
+            usleep(50000);
+    }
+    
+    printf("Workers test, %u workers of %s calc threads\n", count, threads);
+    
+    mpf_init2(request.center_x_mp, 64);
+    mpf_init2(request.center_y_mp, 64);
+    request.generation  = __atomic_load_n(&g_render_generation, __ATOMIC_RELAXED);
+    request.cancelled   = 0.0;
+    request.cost        = NULL;
+    request.use_cost    = false;
+    request.target      = NULL;
+    request.orbits      = NULL;
+    request.use_pan     = false;
+    request.base_pixels = NULL;
+    initOrbitList(&request.resume);
+    
+    for(unsigned v=0; v<view_count; v++)
+    {
+        unsigned    bits = getPrecisionBits(floatExpFromDouble(views[v].zoom), views[v].res);
+        double      elapsed[2];
+        
+        mpf_set_prec(request.center_x_mp, bits);
+        mpf_set_prec(request.center_y_mp, bits);
+        mpf_set_d(request.center_x_mp, views[v].center_x);
+        mpf_set_d(request.center_y_mp, views[v].center_y);
+        request.center_x    = views[v].center_x;
+        request.center_y    = views[v].center_y;
+        request.zoom        = floatExpFromDouble(views[v].zoom);
+        request.xres        = views[v].res;
+        request.yres        = views[v].res;
+        request.itermax     = views[v].itermax;
+        request.mode        = views[v].mode;
+        
+        if(v == view_count - 1)
+        {
+            kill(pids[0], SIGKILL);
+            waitpid(pids[0], NULL, 0);
+            pids[0] = 0;
+        }
+        
+        for(unsigned remote_pass=0; remote_pass<2; remote_pass++)
+        {
+            unsigned    workers = g_tile_workers.count;
+            double      start = getSeconds();
+            
+            g_tile_workers.count = remote_pass ? workers : 0;
+#ifdef USE_BIGNUM
+            renderRequest(&request, remote_pass ? remote : local, tiles, &reference_orbit, &bla_table);
+#else
+            renderRequest(&request, remote_pass ? remote : local, tiles);
+#endif
+            g_tile_workers.count = workers;
+            
+            elapsed[remote_pass] = getSeconds() - start;
+        }
+        
+        unsigned    differ = 0;
+        const char  *status;
+        
+        for(unsigned i=0; i<request.xres * request.yres; i++)
+        {
+            differ += local[i] != remote[i];
+        }
+        
+        if(!differ)
+        {
+            status = "ok";
+        }
+#ifdef USE_BIGNUM
+        else if(request.mode == kRenderModePerturbation && g_use_glitch_correction)
+        {
+            status = "glitch references picked per job";
+        }
+#endif
+        else
+        {
+            status = "FAILED";
+            failed++;
+        }
+        
+        printf("    %-14s %4u x %-4u %s, %u pixels differ, calc threads %.3fs, workers %.3fs\n", views[v].name,
+               request.xres, request.yres, status, differ, elapsed[0], elapsed[1]);
+    }
+    
+    for(unsigned i=0; i<count; i++)
+    {
+        closeTileSocket(g_tile_workers.workers[i].fd);
+        
+        if(pids[i] > 0)
+        {
+            kill(pids[i], SIGTERM);
+            waitpid(pids[i], NULL, 0);
+        }
+        
+        unlink(paths[i]);
+    }
+    
+    g_tile_workers.count = 0;
+    
+    printf("Workers test %s\n", failed ? "FAILED" : "passed");
+    
+    mpf_clear(request.center_x_mp);
+    mpf_clear(request.center_y_mp);
+    freePixels(local, SCREEN_WIDTH * SCREEN_HEIGHT);
+    freePixels(remote, SCREEN_WIDTH * SCREEN_HEIGHT);
+    delete [] tiles;
+    
+    return failed ? 1 : 0;
+}
+
+void *renderThread(void *ctx)
+{
+    RenderRequest   request;
+    TileInfo        *tiles = new TileInfo [kMaxTileCount];
+    unsigned        *pixels;
+#ifdef USE_BIGNUM
+    ReferenceOrbit  reference_orbit;
+    BLATable        bla_table;
+    
+    initReferenceOrbit(&reference_orbit);
+    initBLATable(&bla_table);
+#endif
+    
+    mpf_init2(request.center_x_mp, 64);
+    mpf_init2(request.center_y_mp, 64);
+    
+    request.cost        = new float [kCostColumns * kCostRows];
+    request.generation  = g_render_pipeline.done;
+    request.base_pixels = NULL;
+    
+    initOrbitList(&request.resume);
+    
+    for(;;)
+    {
+        pthread_mutex_lock(&g_render_pipeline.lock);
+        
+        while(!g_render_pipeline.quit && g_render_pipeline.request.generation == request.generation)
+        {
+            pthread_cond_wait(&g_render_pipeline.wake, &g_render_pipeline.lock);
+        }
+        
+        if(g_render_pipeline.quit)
+        {
+            pthread_mutex_unlock(&g_render_pipeline.lock);
+            break;
+        }
+        
+        setRenderRequest(&request, &g_render_pipeline.request);
+        pixels = request.target ? request.target : g_render_pipeline.pixels;
+        
+        pthread_mutex_unlock(&g_render_pipeline.lock);
+        
+        if(request.cancelled != 0.0)
+        {
+            printf("New frame %.1fms after the input that cancelled the last one\n", 1e3 * (getSeconds() - request.cancelled));
+        }
+        
+#ifdef USE_BIGNUM
+        if(renderRequest(&request, pixels, tiles, &reference_orbit, &bla_table))
+#else
+        if(renderRequest(&request, pixels, tiles))
+#endif
+        {
+            __atomic_store_n(&g_render_pipeline.done, request.generation, __ATOMIC_RELEASE);
+            
+            wakeEventLoop();
+        }
+    }
+    
+#ifdef USE_BIGNUM
+    freeReferenceOrbit(&reference_orbit);
+    freeBLATable(&bla_table);
+#endif
+    mpf_clear(request.center_x_mp);
+    mpf_clear(request.center_y_mp);
+    
+    freeOrbitList(&request.resume);
+    freePixels(request.base_pixels, SCREEN_WIDTH * SCREEN_HEIGHT);
+    
+    delete [] request.cost;
+    delete [] tiles;
+    
+    return NULL;
+}
+
+void startRenderThread(void)
+{
+    initTileQueue();
+    
+    g_tile_queue.event          = SDL_RegisterEvents(1);
+    g_tile_queue.wake_pending   = 0;
+    
+    if(g_tile_queue.event == (Uint32)-1)
+    {
+        g_tile_queue.event = 0;
+    }
+    
+    pthread_mutex_init(&g_render_pipeline.lock, NULL);
+    pthread_cond_init(&g_render_pipeline.wake, NULL);
+    
+    mpf_init2(g_render_pipeline.request.center_x_mp, 64);
+    mpf_init2(g_render_pipeline.request.center_y_mp, 64);
+    
+    g_render_pipeline.request.cost          = new float [kCostColumns * kCostRows];
+    g_render_pipeline.request.use_cost      = false;
+    g_render_pipeline.request.target        = NULL;
+    g_render_pipeline.request.orbits        = NULL;
+    g_render_pipeline.request.use_pan       = false;
+    g_render_pipeline.request.base_pixels   = NULL;
+    g_render_pipeline.request.generation    = __atomic_load_n(&g_render_generation, __ATOMIC_RELAXED);
+    g_render_pipeline.done                  = g_render_pipeline.request.generation;
+    g_render_pipeline.quit                  = false;
+    g_render_pipeline.pixels                = allocPixels(SCREEN_WIDTH * SCREEN_HEIGHT);
+    
+    initOrbitList(&g_render_pipeline.request.resume);
+    initOrbitList(&g_render_pipeline.orbits);
+    
+    pthread_create(&g_render_pipeline.thread, NULL, renderThread, NULL);
+}
+
+// waits out the frame in progress, an OpenCL frame or a reference orbit is not cut short
+void stopRenderThread(void)
+{
+    pthread_mutex_lock(&g_render_pipeline.lock);
+    g_render_pipeline.quit = true;
+    cancelRender();
+    pthread_cond_signal(&g_render_pipeline.wake);
+    pthread_mutex_unlock(&g_render_pipeline.lock);
+    
+    pthread_join(g_render_pipeline.thread, NULL);
+    
+    mpf_clear(g_render_pipeline.request.center_x_mp);
+    mpf_clear(g_render_pipeline.request.center_y_mp);
+    
+    delete [] g_render_pipeline.request.cost;
+    
+    freePixels(g_render_pipeline.pixels, SCREEN_WIDTH * SCREEN_HEIGHT);
+    freePixels(g_render_pipeline.request.base_pixels, SCREEN_WIDTH * SCREEN_HEIGHT);
+    freeOrbitList(&g_render_pipeline.request.resume);
+    freeOrbitList(&g_render_pipeline.orbits);
+    
+    g_tile_queue.event = 0;
+}
+
+// off by more than this from a whole pixel it was not a click that moved the view
+#define kPanTolerance       1e-3
+
+// Whether view is from moved by whole pixels at the same zoom, and from's frame
+// is what view's would be where they overlap: the same size, itermax and mode.
+// shift_x,shift_y is the move in pixels of the frame, see setPanFrame. OpenCL
+// and hybrid frames are rendered whole, and so are the frames the workers have
+// a hand in, they take whole tiles.
+static bool getPanShift(const ZoomView *view, const ZoomView *from, unsigned mode, int *shift_x, int *shift_y)
+{
+    if(!g_use_pan_reuse || mode == kRenderModeOpenCL || mode == kRenderModeHybrid || g_tile_workers.count ||
+       !from->pixels_itermax || from->pixels_itermax != view->itermax || from->pixels_mode != mode ||
+       floatExpCompare(from->zoom, view->zoom) || from->xres != view->xres || from->yres != view->yres)
+        return false;
+    
+    mpf_t       offset;
+    double      x, y;
+    
+    mpf_init2(offset, std::max(mpf_get_prec(view->center_x_mp), mpf_get_prec(from->center_x_mp)));
+    
+    mpf_sub(offset, view->center_x_mp, from->center_x_mp);
+    x = getOffsetPixels(offset, view->zoom, view->xres);
+    mpf_sub(offset, view->center_y_mp, from->center_y_mp);
+    y = getOffsetPixels(offset, view->zoom, view->yres);
+    
+    mpf_clear(offset);
+    
+    if(fabs(x) >= view->xres || fabs(y) >= view->yres)
+        return false;
+    
+    *shift_x = (int)lround(x);
+    *shift_y = (int)lround(y);
+    
+    return fabs(x - *shift_x) < kPanTolerance && fabs(y - *shift_y) < kPanTolerance;
+}
+
+// Cancels the frame in progress, if any, and hands view to the render thread in
+// mode, with cost from estimateViewCost or NULL. target is NULL for a frame to
+// show, its tiles go to the window as they finish, or where a speculative frame
+// goes. With resume only the view's pixels still running are carried on, see
+// canResumeView, and a view panned from pan_from, if not NULL, gets what its
+// frame has of the new one, see getPanShift. Returns the generation its tiles
+// and its finish will be marked with.
+static unsigned requestRender(const ZoomView *view, unsigned mode, const float *cost, bool resume,
+                              const ZoomView *pan_from, unsigned *target)
+{
+    RenderRequest *request = &g_render_pipeline.request;
+    
+    pthread_mutex_lock(&g_render_pipeline.lock);
+    
+    bool busy = __atomic_load_n(&g_render_pipeline.done, __ATOMIC_ACQUIRE) != request->generation;
+    
+    cancelRender();
+    
+    mpf_set_prec(request->center_x_mp, mpf_get_prec(view->center_x_mp));
+    mpf_set_prec(request->center_y_mp, mpf_get_prec(view->center_y_mp));
+    mpf_set(request->center_x_mp, view->center_x_mp);
+    mpf_set(request->center_y_mp, view->center_y_mp);
+    
+    request->center_x   = view->center_x;
+    request->center_y   = view->center_y;
+    request->zoom       = view->zoom;
+    request->xres       = view->xres;
+    request->yres       = view->yres;
+    request->itermax    = view->itermax;
+    request->mode       = mode;
+    request->generation = __atomic_load_n(&g_render_generation, __ATOMIC_RELAXED);
+    request->cancelled  = busy ? getSeconds() : 0.0;
+    request->use_cost   = cost != NULL;
+    request->target     = target;
+    request->orbits     = !target && g_use_resume ? &g_render_pipeline.orbits : NULL;
+    request->resume.itermax = 0;
+    request->use_pan    = !resume && pan_from && getPanShift(view, pan_from, mode, &request->pan_x, &request->pan_y);
+    
+    if(resume)
+    {
+        copyOrbitList(&request->resume, &view->orbits);
+    }
+    
+    if(resume || request->use_pan)
+    {
+        const ZoomView *base = resume ? view : pan_from;
+        
+        if(!request->base_pixels)
+        {
+            request->base_pixels = allocPixels(SCREEN_WIDTH * SCREEN_HEIGHT);
+        }
+        
+        memcpy(request->base_pixels, base->pixels, base->xres * base->yres * sizeof(unsigned));
+    }
+    
+    if(cost)
+    {
+        memcpy(request->cost, cost, kCostColumns * kCostRows * sizeof(float));
+    }
+    
+    unsigned generation = request->generation;
+    
+    pthread_cond_signal(&g_render_pipeline.wake);
+    pthread_mutex_unlock(&g_render_pipeline.lock);
+    
+    return generation;
+}
+
+// A double view whose itermax went up since its last frame, which left the
+// orbits of its pixels still running. Those are all that can change, the rest
+// escaped or were found interior, so they are carried on instead of a frame.
+static bool canResumeView(const ZoomView *view, unsigned mode)
+{
+    return g_use_resume && mode == kRenderModeDouble && !g_use_escalation && !g_tile_workers.count &&
+           view->pixels_itermax && view->orbits.itermax == view->pixels_itermax &&
+           view->itermax > view->pixels_itermax;
+}
+
+// a finished frame's list, for the view to keep just as many as there are
+static void setViewOrbits(ZoomView *view, const OrbitList *orbits)
+{
+    freeOrbitList(&view->orbits);
+    
+    if(orbits->itermax)
+    {
+        copyOrbitList(&view->orbits, orbits);
+    }
+}
+
+// one finished tile of pixels colored into draw_surface and copied to the window
+static void drawFractalTile(SDL_Window* window, SDL_Surface *draw_surface, const unsigned *pixels, const Rect *rect,
+                            const ZoomView *view, Palette *palette)
+{
+    SDL_Rect    area;
+    
+    SDL_LockSurface(draw_surface);
+    
+    for(unsigned hy=rect->y0; hy<=rect->y1; hy++)
+    {
+        unsigned        *dst_pixels = (unsigned *)draw_surface->pixels + (draw_surface->pitch >> 2) * hy;
+        const unsigned  *src_pixels = &pixels[hy * view->xres];
+        
+        for(unsigned hx=rect->x0; hx<=rect->x1; hx++)
+        {
+            RGB_Color rgb = genColorFromPalette(src_pixels[hx], view->itermax, palette);
+            
+            dst_pixels[hx] = SDL_MapRGBA(draw_surface->format, rgb.r, rgb.g, rgb.b, 0);
+        }
+    }
+    
+    SDL_UnlockSurface(draw_surface);
+    
+    area.x = rect->x0;
+    area.y = rect->y0;
+    area.w = rect->x1 - rect->x0 + 1;
+    area.h = rect->y1 - rect->y0 + 1;
+    
+    SDL_BlitSurface(draw_surface, &area, SDL_GetWindowSurface(window), &area);
+}
+
+// a bar along the top of the window, done of count
+#define kProgressBarHeight      4
+
+static void drawRenderProgress(SDL_Window* window, unsigned done, unsigned count)
+{
+    SDL_Surface *screen_surface = SDL_GetWindowSurface(window);
+    unsigned    width = (unsigned)((double)screen_surface->w * done / count);
+    
+    for(int hy=0; hy<kProgressBarHeight && hy<screen_surface->h; hy++)
+    {
+        unsigned *dst = (unsigned *)screen_surface->pixels + (screen_surface->pitch >> 2) * hy;
+        
+        for(unsigned hx=0; hx<width; hx++)
+        {
+            dst[hx] = 0xffffffff;
+        }
+    }
+}
+
+// Frames rendered while the window is idle, for the views the next input is
+// likely to ask for: a Z at the center, an I, or a click where the cursor is.
+// They go to the render thread as frames of their own and any real request
+// cancels them like any frame. A hit is swapped into the view and shown at
+// once. The event loop owns all of this, the render thread only sees target.
+#define kSpeculativeFrames      4
+
+enum {
+    kSpeculateZoom,
+    kSpeculateIterations,
+    kSpeculateClick,
+    kSpeculateKinds
+};
+
+enum {
+    kSpeculativeEmpty,
+    kSpeculativeRendering,
+    kSpeculativeReady
+};
+
+typedef struct {
+    ZoomView        view;           // pixels is the frame, allocated once
+    unsigned        mode;
+    unsigned        options;        // getFrameOptions and the kernel flags it was rendered with
+    unsigned        kernel_flags;
+    unsigned        kind;
+    unsigned        state;
+    double          cpu;            // seconds of process cpu it took
+    unsigned        used;           // stamp, the least recently used is replaced
+} SpeculativeFrame;
+
+struct {
+    SpeculativeFrame frames[kSpeculativeFrames + 1];    // the last is where candidates are put together
+    int             rendering;      // frame the render thread is on, -1 for none
+    unsigned        generation;
+    double          started;        // getCPUSeconds
+    unsigned        stamp;
+    unsigned        hits, misses;
+    unsigned        rendered, cancelled, evicted;
+    double          cpu_used;       // of the hits
+    double          cpu_wasted;     // of the cancelled and the replaced
+} g_speculation;
+
+static const char *getSpeculationName(unsigned kind)
+{
+    switch(kind)
+    {
+        case kSpeculateZoom:            return "zoom";
+        case kSpeculateIterations:      return "itermax";
+        case kSpeculateClick:           return "click";
+    }
+    
+    return "?";
+}
+
+// user and system time of the whole process, the calc threads included
+static double getCPUSeconds(void)
+{
+    struct rusage usage;
+    
+    getrusage(RUSAGE_SELF, &usage);
+    
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+}
+
+static void initSpeculation(void)
+{
+    memset(&g_speculation, 0, sizeof(g_speculation));
+    
+    for(unsigned i=0; i<=kSpeculativeFrames; i++)
+    {
+        SpeculativeFrame *frame = &g_speculation.frames[i];
+        
+        mpf_init2(frame->view.center_x_mp, 64);
+        mpf_init2(frame->view.center_y_mp, 64);
+        
+        frame->view.pixels  = allocPixels(SCREEN_WIDTH * SCREEN_HEIGHT);
+        frame->state        = kSpeculativeEmpty;
+    }
+    
+    g_speculation.rendering = -1;
+}
+
+static void printSpeculationStats(void)
+{
+    unsigned asked = g_speculation.hits + g_speculation.misses;
+    
+    printf("Speculation: %u of %u frames hit (%.0f%%), %u rendered, %u cancelled, %u replaced unused, "
+           "%.2fs of cpu used and %.2fs wasted\n", g_speculation.hits, asked, asked ? 100.0 * g_speculation.hits / asked : 0.0,
+           g_speculation.rendered, g_speculation.cancelled, g_speculation.evicted, g_speculation.cpu_used, g_speculation.cpu_wasted);
+}
+
+static void freeSpeculation(void)
+{
+    printSpeculationStats();
+    
+    for(unsigned i=0; i<=kSpeculativeFrames; i++)
+    {
+        mpf_clear(g_speculation.frames[i].view.center_x_mp);
+        mpf_clear(g_speculation.frames[i].view.center_y_mp);
+        
+        freePixels(g_speculation.frames[i].view.pixels, SCREEN_WIDTH * SCREEN_HEIGHT);
+    }
+}
+
+static bool isSpeculativeMatch(const SpeculativeFrame *frame, const ZoomView *view, unsigned mode)
+{
+    return frame->state != kSpeculativeEmpty && frame->mode == mode && frame->options == getFrameOptions() &&
+           frame->kernel_flags == g_kernel_options.flags && !floatExpCompare(frame->view.zoom, view->zoom) &&
+           frame->view.itermax == view->itermax && frame->view.xres == view->xres && frame->view.yres == view->yres &&
+           !mpf_cmp(frame->view.center_x_mp, view->center_x_mp) && !mpf_cmp(frame->view.center_y_mp, view->center_y_mp);
+}
+
+// the frame the render thread is on is dropped, for the real request that cancelled it
+static void stopSpeculation(void)
+{
+    if(g_speculation.rendering < 0)
+        return;
+    
+    SpeculativeFrame *frame = &g_speculation.frames[g_speculation.rendering];
+    
+    frame->state = kSpeculativeEmpty;
+    
+    g_speculation.cancelled++;
+    g_speculation.cpu_wasted += getCPUSeconds() - g_speculation.started;
+    g_speculation.rendering = -1;
+}
+
+// the render thread finished the speculative frame
+static void finishSpeculation(void)
+{
+    SpeculativeFrame *frame = &g_speculation.frames[g_speculation.rendering];
+    
+    frame->state    = kSpeculativeReady;
+    frame->cpu      = getCPUSeconds() - g_speculation.started;
+    
+    g_speculation.rendered++;
+    g_speculation.rendering = -1;
+    
+    printf("Speculative %s frame ready, %.2fs of cpu\n", getSpeculationName(frame->kind), frame->cpu);
+}
+
+// Swaps a ready frame for view into its pixels, the frame takes the view's old
+// buffer. False on a miss. Either way it counts for the hit rate.
+static bool takeSpeculativeFrame(ZoomView *view, unsigned mode)
+{
+    for(unsigned i=0; i<kSpeculativeFrames; i++)
+    {
+        SpeculativeFrame *frame = &g_speculation.frames[i];
+        
+        if(frame->state == kSpeculativeReady && isSpeculativeMatch(frame, view, mode))
+        {
+            std::swap(view->pixels, frame->view.pixels);
+            view->pixels_itermax = view->itermax;
+            view->pixels_mode    = mode;
+            
+            // a speculative frame keeps no orbits
+            freeOrbitList(&view->orbits);
+            
+            frame->state = kSpeculativeEmpty;
+            
+            g_speculation.hits++;
+            g_speculation.cpu_used += frame->cpu;
+            
+            printf("Speculative %s frame shown\n", getSpeculationName(frame->kind));
+            printSpeculationStats();
+            
+            return true;
+        }
+    }
+    
+    g_speculation.misses++;
+    
+    return false;
+}
+
+// Puts the view kind would make of view together in the spare frame, the way
+// the key and click handlers make it. False when there is no such view.
+static bool setSpeculativeView(const ZoomView *view, unsigned kind, double cursor_x, double cursor_y)
+{
+    SpeculativeFrame    *frame = &g_speculation.frames[kSpeculativeFrames];
+    ZoomView            *dst = &frame->view;
+    FloatExp            zoom = kind == kSpeculateZoom ? raiseZoom(view->zoom, false) : view->zoom;
+    unsigned            bits = kind == kSpeculateIterations ? (unsigned)mpf_get_prec(view->center_x_mp) :
+                                                              getZoomViewBits(view, zoom);
+    
+    // a click at the center is no move at all
+    if(kind == kSpeculateClick && (cursor_x < 0.0 || ((int)cursor_x == (int)view->xres / 2 && (int)cursor_y == (int)view->yres / 2)))
+        return false;
+    
+    mpf_set_prec(dst->center_x_mp, bits);
+    mpf_set_prec(dst->center_y_mp, bits);
+    mpf_set(dst->center_x_mp, view->center_x_mp);
+    mpf_set(dst->center_y_mp, view->center_y_mp);
+    
+    dst->next           = NULL;
+    dst->center_x       = view->center_x;
+    dst->center_y       = view->center_y;
+    dst->zoom           = zoom;
+    dst->use_histogram  = view->use_histogram;
+    dst->itermax        = kind == kSpeculateIterations ? view->itermax * 2 : view->itermax;
+    dst->flags          = view->flags;
+    dst->xres           = view->xres;
+    dst->yres           = view->yres;
+    dst->pixels_itermax = 0;
+    
+    if(kind == kSpeculateClick)
+    {
+        double  offset_x, offset_y;
+        int     offset_exponent;
+        
+        getClickOffset(view, (int)cursor_x, (int)cursor_y, &offset_x, &offset_y, &offset_exponent);
+        moveZoomView(dst, offset_x, offset_y, offset_exponent);
+    }
+    
+    frame->kind = kind;
+    
+    return true;
+}
+
+// Starts the first of the likely next views of view that is not cached yet, in
+// the least recently used frame. render_mode is the user's, auto picks per view
+// as it would for the real one. The OpenCL frames cannot be cancelled and are
+// not speculated on. False when there was nothing to do.
+static bool speculateNextView(const ZoomView *view, unsigned render_mode, double cursor_x, double cursor_y, float *cost)
+{
+    SpeculativeFrame *spare = &g_speculation.frames[kSpeculativeFrames];
+    
+    for(unsigned kind=0; kind<kSpeculateKinds; kind++)
+    {
+        if(!setSpeculativeView(view, kind, cursor_x, cursor_y))
+            continue;
+        
+        unsigned mode = render_mode;
+        
+        if(render_mode == kRenderModeAuto)
+        {
+            char reason[192];
+            
+            mode = chooseRenderMode(&spare->view, spare->view.xres, reason, sizeof(reason));
+        }
+        
+        if((mode == kRenderModeOpenCL || mode == kRenderModeHybrid) && kernel)
+            return false;
+        
+        bool cached = false;
+        
+        for(unsigned i=0; i<kSpeculativeFrames && !cached; i++)
+        {
+            cached = isSpeculativeMatch(&g_speculation.frames[i], &spare->view, mode);
+        }
+        
+        if(cached)
+            continue;
+        
+        unsigned victim = 0;
+        
+        for(unsigned i=1; i<kSpeculativeFrames; i++)
+        {
+            SpeculativeFrame *frame = &g_speculation.frames[i];
+            
+            if(frame->state == kSpeculativeEmpty ? g_speculation.frames[victim].state != kSpeculativeEmpty :
+               g_speculation.frames[victim].state != kSpeculativeEmpty && frame->used < g_speculation.frames[victim].used)
+            {
+                victim = i;
             }
         }
         
-        SDL_UpdateWindowSurface( window );
+        if(g_speculation.frames[victim].state == kSpeculativeReady)
+        {
+            g_speculation.evicted++;
+            g_speculation.cpu_wasted += g_speculation.frames[victim].cpu;
+        }
+        
+        std::swap(g_speculation.frames[victim], *spare);
+        
+        SpeculativeFrame *frame = &g_speculation.frames[victim];
+        
+        frame->mode         = mode;
+        frame->options      = getFrameOptions();
+        frame->kernel_flags = g_kernel_options.flags;
+        frame->state        = kSpeculativeRendering;
+        frame->used         = ++g_speculation.stamp;
+        
+        bool use_cost = g_use_cost_model && estimateViewCost(&frame->view, view, cost);
+        
+        g_speculation.rendering     = victim;
+        g_speculation.started       = getCPUSeconds();
+        g_speculation.generation    = requestRender(&frame->view, mode, use_cost ? cost : NULL, false, view,
+                                                    frame->view.pixels);
+        
+        return true;
     }
     
     return false;
@@ -865,7 +6217,6 @@ void updateLoop(SDL_Window* window, SDL_Surface *draw_surface)
 {
     SDL_Surface     *screen_surface;
     SDL_Event       event;
-    ScanLineInfo    *scanline_info;
     ZoomView        *views;
     int             xres, yres;
     double          mouse_x, mouse_y;
@@ -874,54 +6225,65 @@ void updateLoop(SDL_Window* window, SDL_Surface *draw_surface)
     bool            finished;
     bool            draw_lines;
     unsigned        zoom_index;
+    unsigned        frame_mode;         // render_mode, or what auto mode picked for the frame
     unsigned        palette_index;
     Palette         *palettes;
+    char            title[256];
+    bool            rendering;          // a frame was requested and has not been shown yet
+    unsigned        render_generation;  // its generation from requestRender
+    unsigned        render_view;        // the zoom_index it is for
+    unsigned        render_pixels;      // pixels in the tiles drawn so far
+    double          render_started;
+    float           *cost;              // for requestRender, see estimateViewCost
     
     screen_surface  = NULL;
     
     xres       = SCREEN_WIDTH;
     yres       = SCREEN_HEIGHT;
-    mouse_x     = 0.0;
-    mouse_y     = 0.0;
+    mouse_x     = -1.0;     // no click is speculated on until the cursor has moved
+    mouse_y     = -1.0;
     repeat      = 0.0;
     
     update          = true;
     redraw          = false;
     finished        = false;
     draw_lines      = true;
-    render_mode     = kRenderModeOpenCL;
+    render_mode     = g_start_auto ? kRenderModeAuto : kRenderModeOpenCL;
+    frame_mode      = render_mode;
     palette_index   = 0;
     palettes        = new Palette [PALETTE_COUNT];
     
-    views                               = new ZoomView [1024];
+    views                               = new ZoomView [kMaxZoomViews];
     zoom_index                          = 0;
     views[zoom_index].next              = NULL;
     views[zoom_index].xres              = SCREEN_WIDTH;
     views[zoom_index].yres              = SCREEN_HEIGHT;
     views[zoom_index].center_x          = -0.7;
     views[zoom_index].center_y          = 0.0;
-    views[zoom_index].zoom              = 1.0;
-    views[zoom_index].pixels            = new unsigned [SCREEN_WIDTH * SCREEN_HEIGHT];
-    views[zoom_index].itermax           = 256;
+    views[zoom_index].zoom              = floatExpFromDouble(1.0);
     
-    scanline_info = new ScanLineInfo [SCREEN_HEIGHT];
+    mpf_init2(views[zoom_index].center_x_mp, getPrecisionBits(views[zoom_index].zoom, SCREEN_WIDTH));
+    mpf_init2(views[zoom_index].center_y_mp, getPrecisionBits(views[zoom_index].zoom, SCREEN_WIDTH));
+    mpf_set_d(views[zoom_index].center_x_mp, views[zoom_index].center_x);
+    mpf_set_d(views[zoom_index].center_y_mp, views[zoom_index].center_y);
     
-    g_work_queue.next = NULL;
-    g_work_queue.count = 0;
+    views[zoom_index].pixels            = allocPixels(SCREEN_WIDTH * SCREEN_HEIGHT);
+    views[zoom_index].pixels_itermax    = 0;
+    views[zoom_index].pixels_mode       = kRenderModeAuto;
+    views[zoom_index].itermax           = 256;
     
-    pthread_mutex_init(&g_work_queue.queue_lock, NULL);
-    pthread_cond_init(&g_work_queue.cond, NULL);
+    initOrbitList(&views[zoom_index].orbits);
     
-    pthread_t threads[8];
-    pthread_attr_t attr;
+    setRenderFocus(SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2);
     
-    pthread_attr_init(&attr);
-    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    rendering           = false;
+    render_generation   = 0;
+    render_view         = 0;
+    render_pixels       = 0;
+    render_started      = 0.0;
+    cost                = new float [kCostColumns * kCostRows];
     
-    for(int i=0; i<8; i++)
-    {
-        pthread_create(&threads[i], &attr, calcThread, NULL);
-    }
+    startCalcThreads(getCalcThreadCount());
     
     // init globals
     device  = getCLDevice();
@@ -929,7 +6291,6 @@ void updateLoop(SDL_Window* window, SDL_Surface *draw_surface)
     queue   = 0;
 
     cl_program          program = 0;
-    cl_kernel           kernel = 0;
     
     if(device)
     {
@@ -945,9 +6306,29 @@ void updateLoop(SDL_Window* window, SDL_Surface *draw_surface)
             "    unsigned       itermax;\n"
             "    unsigned       sample_count;\n"
             "    int            pitch;\n"
+            "    unsigned       flags;\n"
+            "    double         periodicity_epsilon;\n"
+            "    unsigned       periodicity_interval;\n"
             "} CLWorkInfo;\n"
             "\n"
-            "__kernel void mandelbrot(__global CLWorkInfo *info, __global int *dst)\n",
+            "#define kKernelCardioidCheck 0x1\n"
+            "#define kKernelPeriodicityCheck 0x2\n"
+            "\n"
+            "bool inCardioidOrBulb(double cx, double cy)\n"
+            "{\n"
+            "   double x = cx - 0.25;\n"
+            "   double y2 = cy * cy;\n"
+            "   double q = x * x + y2;\n"
+            "\n"
+            "   if (q * (q + x) <= 0.25 * y2)\n"
+            "       return true;\n"
+            "\n"
+            "   x = cx + 1.0;\n"
+            "\n"
+            "   return x * x + y2 <= 0.0625;\n"
+            "}\n"
+            "\n"
+            "__kernel void mandelbrot(__global CLWorkInfo *info, __global int *dst, __global unsigned *stats)\n",
             "{\n",
             "	int xi = get_global_id(0);\n",
             "	int yi = get_global_id(1);\n",
@@ -955,13 +6336,24 @@ void updateLoop(SDL_Window* window, SDL_Surface *draw_surface)
             "   int itermax = info->itermax;\n"
             "   int pitch = info->pitch;\n"
             "   int done = 0;\n"
+            "   int periodic = 0;\n"
+            "   int window = info->periodicity_interval, window_count = 0;\n"
+            "   double epsilon = info->periodicity_epsilon;\n"
             "   double x, y, xx, cx, cy;\n"
+            "   double saved_x = 0.0, saved_y = 0.0;\n"
             "\n"
             "   cx = info->center_x + 3.0*(xi/info->xres-0.5f)/info->zoom;\n"
             "   cy = info->center_y + 3.0*(yi/info->yres-0.5f)/info->zoom;\n"
             "   x = 0.0; y=0.0;\n"
             "\n"
-            "   for (iteration=1;!done && iteration<itermax;iteration++)\n"
+            "   if ((info->flags & kKernelCardioidCheck) && inCardioidOrBulb(cx, cy))\n"
+            "   {\n"
+            "       dst[yi * pitch + xi] = 0;\n"
+            "       atomic_inc(&stats[0]);\n"
+            "       return;\n"
+            "   }\n"
+            "\n"
+            "   for (iteration=1;!done && !periodic && iteration<itermax;iteration++)\n"
             "   {\n"
             "       xx = x*x-y*y+cx;\n"
             "       y = 2.0*x*y+cy;\n"
@@ -971,6 +6363,27 @@ void updateLoop(SDL_Window* window, SDL_Surface *draw_surface)
             "       {\n"
             "           done = true;\n"
             "       }\n"
+            "       else if (info->flags & kKernelPeriodicityCheck)\n"
+            "       {\n"
+            "           if (fabs(x - saved_x) < epsilon && fabs(y - saved_y) < epsilon)\n"
+            "           {\n"
+            "               unsigned saved = itermax - 1 - iteration;\n"
+            "\n"
+            "               periodic = 1;\n"
+            "               atomic_inc(&stats[1]);\n"
+            "\n"
+            "               // 64 bit count of saved iterations from two 32 bit words\n"
+            "               if (atomic_add(&stats[2], saved) + saved < saved)\n"
+            "                   atomic_inc(&stats[3]);\n"
+            "           }\n"
+            "           else if (++window_count == window)\n"
+            "           {\n"
+            "               saved_x = x;\n"
+            "               saved_y = y;\n"
+            "               window_count = 0;\n"
+            "               window *= 2;\n"
+            "           }\n"
+            "       }\n"
             "   }\n"
             "\n"
             "   if (done)\n"
@@ -1002,14 +6415,21 @@ void updateLoop(SDL_Window* window, SDL_Surface *draw_surface)
         
         kernel = clCreateKernel(program, "mandelbrot", &_err);
         
-        queue = clCreateCommandQueue(context, device, 0, &_err);
+        // profiled, a hybrid frame times the device's part, see finishFrameCL
+        queue = clCreateCommandQueue(context, device, CL_QUEUE_PROFILING_ENABLE, &_err);
     }
     
     palette_index = createPalettes(palettes);
     
+    startRenderThread();
+    initSpeculation();
+    
     while(!finished)
     {
-        while(SDL_PollEvent(&event))
+        // sleeps until there is input or the render thread posts its wake event,
+        // which needs nothing more than the queue and done checks after the switch
+        for(bool more = (update || redraw) ? SDL_PollEvent(&event) : SDL_WaitEvent(&event); more;
+            more = SDL_PollEvent(&event))
         {
             switch(event.type)
             {
@@ -1017,24 +6437,20 @@ void updateLoop(SDL_Window* window, SDL_Surface *draw_surface)
                 {
                     if(event.key.keysym.scancode == SDL_SCANCODE_Z)
                     {
-                        views[zoom_index+1] = views[zoom_index];
-                        zoom_index++;
-                        
-                        views[zoom_index].zoom++;
-                        views[zoom_index].pixels    = new unsigned [SCREEN_WIDTH * SCREEN_HEIGHT];
-                        
-                        if(event.key.repeat)
+                        // nothing once the stack is full
+                        if(zoom_index + 1 < kMaxZoomViews)
                         {
-                            views[zoom_index].zoom *= 2;
+                            pushZoomView(views, zoom_index, raiseZoom(views[zoom_index].zoom, event.key.repeat));
+                            zoom_index++;
+                            
+                            update = true;
                         }
-                        
-                        update = true;
                     }
                     else if(event.key.keysym.scancode == SDL_SCANCODE_O)
                     {
                         if(zoom_index)
                         {
-                            free(views[zoom_index].pixels);
+                            popZoomView(&views[zoom_index]);
                             zoom_index--;
                         }
                         
@@ -1042,11 +6458,18 @@ void updateLoop(SDL_Window* window, SDL_Surface *draw_surface)
                         {
                             if(zoom_index)
                             {
-                                free(views[zoom_index].pixels);
+                                popZoomView(&views[zoom_index]);
                                 zoom_index--;
                             }
                         }
                         
+                        // the views below are all rendered, a frame for a popped one is not wanted
+                        if(rendering && render_view > zoom_index)
+                        {
+                            cancelRender();
+                            rendering = false;
+                        }
+                        
                         redraw = true;
                     }
 #ifdef USE_BIGNUM
@@ -1054,6 +6477,36 @@ void updateLoop(SDL_Window* window, SDL_Surface *draw_surface)
                     {
                         render_mode = kRenderModeBigNUM;
                         
+                        update = true;
+                    }
+                    else if(event.key.keysym.scancode == SDL_SCANCODE_R)
+                    {
+                        render_mode = kRenderModePerturbation;
+                        
+                        update = true;
+                    }
+                    else if(event.key.keysym.scancode == SDL_SCANCODE_A)
+                    {
+                        g_use_bla = !g_use_bla;
+                        
+                        printf("BLA %s\n", g_use_bla ? "on" : "off");
+                        
+                        update = true;
+                    }
+                    else if(event.key.keysym.scancode == SDL_SCANCODE_X)
+                    {
+                        g_use_escalation = !g_use_escalation;
+                        
+                        printf("Escalating unreliable double pixels to bignum %s\n", g_use_escalation ? "on" : "off");
+                        
+                        update = true;
+                    }
+                    else if(event.key.keysym.scancode == SDL_SCANCODE_G)
+                    {
+                        g_use_glitch_correction = !g_use_glitch_correction;
+                        
+                        printf("Glitch correction %s\n", g_use_glitch_correction ? "on" : "off");
+                        
                         update = true;
                     }
 #endif
@@ -1063,12 +6516,38 @@ void updateLoop(SDL_Window* window, SDL_Surface *draw_surface)
                         
                         update = true;
                     }
+                    else if(event.key.keysym.scancode == SDL_SCANCODE_Y)
+                    {
+                        render_mode = kRenderModeHybrid;
+                        
+                        update = true;
+                    }
                     else if(event.key.keysym.scancode == SDL_SCANCODE_D)
                     {
                         render_mode = kRenderModeDouble;
                         
                         update = true;
                     }
+                    else if(event.key.keysym.scancode == SDL_SCANCODE_E)
+                    {
+                        render_mode = kRenderModeDoubleDouble;
+                        
+                        update = true;
+                    }
+                    else if(event.key.keysym.scancode == SDL_SCANCODE_T)
+                    {
+                        render_mode = kRenderModeAuto;
+                        
+                        update = true;
+                    }
+                    else if(event.key.keysym.scancode == SDL_SCANCODE_M)
+                    {
+                        g_use_subdivision = !g_use_subdivision;
+                        
+                        printf("Mariani-Silver subdivision %s\n", g_use_subdivision ? "on" : "off");
+                        
+                        update = true;
+                    }
                     else if(event.key.keysym.scancode == SDL_SCANCODE_H)
                     {
                         views[zoom_index].use_histogram = !views[zoom_index].use_histogram;
@@ -1108,11 +6587,28 @@ void updateLoop(SDL_Window* window, SDL_Surface *draw_surface)
                     {
                         char filename[1024];
                         FILE *fptr;
+                        mpf_t abs_x, abs_y;
+                        FloatExp zoom = views[zoom_index].zoom;
+                        char zoom_string[32];
+                        
+                        // enough digits to find the center pixel again, the doubles run out at depth
+                        int digits = 4 + (int)ceil((zoom.e + log2(zoom.m * xres)) * log10(2.0));
+                        
+                        digits = std::min(digits, kMaxFileNameDigits);
+                        
+                        mpf_init2(abs_x, mpf_get_prec(views[zoom_index].center_x_mp));
+                        mpf_init2(abs_y, mpf_get_prec(views[zoom_index].center_y_mp));
+                        mpf_abs(abs_x, views[zoom_index].center_x_mp);
+                        mpf_abs(abs_y, views[zoom_index].center_y_mp);
+                        formatZoom(zoom_string, sizeof(zoom_string), makeFloatExp(fabs(zoom.m), zoom.e), 16);
                         
-                        snprintf(filename, sizeof(filename), "/tmp/Mandelbrot_%s%1.16g_%s%01.16g_%s%1.16g.tga",
-                                (views[zoom_index].center_x < 0.0 ? "neg_" : ""), fabs(views[zoom_index].center_x),
-                                (views[zoom_index].center_y < 0.0 ? "neg_" : ""), fabs(views[zoom_index].center_y),
-                                (views[zoom_index].zoom < 0.0 ? "neg_" : ""), fabs(views[zoom_index].zoom));
+                        gmp_snprintf(filename, sizeof(filename), "/tmp/Mandelbrot_%s%.*Fg_%s%.*Fg_%s%s.tga",
+                                     (mpf_sgn(views[zoom_index].center_x_mp) < 0 ? "neg_" : ""), digits, abs_x,
+                                     (mpf_sgn(views[zoom_index].center_y_mp) < 0 ? "neg_" : ""), digits, abs_y,
+                                     (zoom.m < 0.0 ? "neg_" : ""), zoom_string);
+                        
+                        mpf_clear(abs_x);
+                        mpf_clear(abs_y);
                         
                         printf("Saving to file %s\n", filename);
                         
@@ -1163,19 +6659,34 @@ void updateLoop(SDL_Window* window, SDL_Surface *draw_surface)
                     break;
                 }
                     
+                case SDL_MOUSEMOTION:
+                {
+                    // the next tiles of the frame in progress are the ones under the cursor
+                    setRenderFocus(event.motion.x, event.motion.y);
+                    
+                    mouse_x = event.motion.x;
+                    mouse_y = event.motion.y;
+                    break;
+                }
+                    
                 case SDL_MOUSEBUTTONDOWN:
                 {
-                    double mouse_x = (double)event.button.x;
-                    double mouse_y = (double)event.button.y;
-                    mouse_x = (((float)mouse_x)/((float)SCREEN_WIDTH)-0.5)/views[zoom_index].zoom*3.0;
-                    mouse_y = (((float)mouse_y)/((float)SCREEN_HEIGHT)-0.5)/views[zoom_index].zoom*3.0;
+                    double  offset_x, offset_y;
+                    int     offset_exponent;
+                    
+                    if(zoom_index + 1 == kMaxZoomViews)
+                        break;
+                    
+                    getClickOffset(&views[zoom_index], event.button.x, event.button.y, &offset_x, &offset_y,
+                                   &offset_exponent);
                     
-                    views[zoom_index+1] = views[zoom_index];
+                    pushZoomView(views, zoom_index, views[zoom_index].zoom);
                     zoom_index++;
                     
-                    views[zoom_index].center_x += mouse_x;
-                    views[zoom_index].center_y += mouse_y;
-                    views[zoom_index].pixels    = new unsigned [SCREEN_WIDTH * SCREEN_HEIGHT];
+                    moveZoomView(&views[zoom_index], offset_x, offset_y, offset_exponent);
+                    
+                    // what was clicked is in the middle now, until the mouse moves again
+                    setRenderFocus(SCREEN_WIDTH / 2, SCREEN_HEIGHT / 2);
                     
                     update = true;
                     break;
@@ -1193,85 +6704,121 @@ void updateLoop(SDL_Window* window, SDL_Surface *draw_surface)
         
         if(update)
         {
-            if(render_mode == kRenderModeOpenCL)
+            frame_mode = render_mode;
+            
+            if(render_mode == kRenderModeAuto)
             {
-                CLWorkInfo  workInfo;
-                cl_mem      input_buffer = 0;
-                cl_mem      output_buffer = 0;
-                cl_int      _err = CL_INVALID_VALUE;
+                char reason[192];
                 
-                workInfo.center_x   = views[zoom_index].center_x;
-                workInfo.center_y   = views[zoom_index].center_y;
-                workInfo.zoom       = views[zoom_index].zoom;
-                workInfo.xres       = xres;
-                workInfo.yres       = yres;
-                workInfo.itermax    = views[zoom_index].itermax;
-                workInfo.pitch      = xres;
+                frame_mode = chooseRenderMode(&views[zoom_index], xres, reason, sizeof(reason));
                 
-                cl_event    kernel_completion;
-                size_t      global_work_size[2] = { (size_t)xres, (size_t)yres };
-                size_t      pbuffer_size = yres * xres * sizeof(unsigned);
-                
-                input_buffer = clCreateBuffer(context, CL_MEM_COPY_HOST_PTR, sizeof(CLWorkInfo), &workInfo, &_err);
-                assert(input_buffer);
-                output_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, pbuffer_size, NULL, &_err);
-                assert(output_buffer);
+                printf("Auto picked %s, %s\n", getRenderModeName(frame_mode), reason);
+                snprintf(title, sizeof(title), "Mandelbrot Explorer - auto: %s, %s", getRenderModeName(frame_mode), reason);
+            }
+            else
+            {
+                snprintf(title, sizeof(title), "Mandelbrot Explorer - %s", getRenderModeName(frame_mode));
+            }
+            
+            SDL_SetWindowTitle(window, title);
+            
+            if(g_use_speculation && takeSpeculativeFrame(&views[zoom_index], frame_mode))
+            {
+                // whatever the render thread is on is of no use now
+                if(rendering || g_speculation.rendering >= 0)
+                {
+                    cancelRender();
+                }
                 
-                clSetKernelArg(kernel, 0, sizeof(input_buffer), &input_buffer);
-                clSetKernelArg(kernel, 1, sizeof(output_buffer), &output_buffer);
+                stopSpeculation();
                 
-                clEnqueueNDRangeKernel(queue, kernel, 2, NULL, global_work_size, NULL, 0, NULL, &kernel_completion);
-                clWaitForEvents(1, &kernel_completion);
-                clReleaseEvent(kernel_completion);
+                rendering   = false;
+                redraw      = true;
+            }
+            else
+            {
+                // the view's last frame, or the last one of the view it came from, says where the work is
+                const ZoomView  *source = views[zoom_index].pixels_itermax ? &views[zoom_index] :
+                                          zoom_index ? &views[zoom_index - 1] : NULL;
+                bool            use_cost = g_use_cost_model && estimateViewCost(&views[zoom_index], source, cost);
                 
-                clEnqueueReadBuffer(queue, output_buffer, CL_TRUE, 0, pbuffer_size, views[zoom_index].pixels, 0, NULL, NULL);
+                // cancelled by the request
+                stopSpeculation();
                 
-                clReleaseMemObject(input_buffer);
-                clReleaseMemObject(output_buffer);
+                // the window keeps the last frame and the new one's tiles are drawn over it
+                render_generation   = requestRender(&views[zoom_index], frame_mode, use_cost ? cost : NULL,
+                                                    canResumeView(&views[zoom_index], frame_mode),
+                                                    zoom_index ? &views[zoom_index - 1] : NULL, NULL);
+                render_view         = zoom_index;
+                render_pixels       = 0;
+                render_started      = getSeconds();
+                rendering           = true;
             }
-            else
+            
+            update = false;
+        }
+        
+        // cleared first, a tile pushed after this posts another wake event
+        __atomic_exchange_n(&g_tile_queue.wake_pending, 0, __ATOMIC_ACQ_REL);
+        
+        {
+            unsigned    generation;
+            Rect        rect;
+            unsigned    drawn = 0;
+            
+            while(popTileQueue(&generation, &rect))
             {
-                for (int hy=0; hy<yres; hy++)
+                if(rendering && generation == render_generation)
                 {
-                    scanline_info[hy].center_x      = views[zoom_index].center_x;
-                    scanline_info[hy].center_y      = views[zoom_index].center_y;
-                    scanline_info[hy].hy            = hy;
-                    scanline_info[hy].itermax       = views[zoom_index].itermax;
-                    scanline_info[hy].xres         = xres;
-                    scanline_info[hy].yres         = yres;
-                    scanline_info[hy].zoom          = views[zoom_index].zoom;
-#ifdef USE_BIGNUM
-                    if(render_mode == kRenderModeBigNUM)
-                    {
-                        scanline_info[hy].flags     |= kUSE_BIGNUM;
-                    }
-#endif
-                    scanline_info[hy].pixels        = &views[zoom_index].pixels[hy * xres];
-                    scanline_info[hy].done          = 0;
-                    
-                    volatile WorkQueueEntry *entry = (WorkQueueEntry *)malloc(sizeof(WorkQueueEntry));
-                    
-                    pthread_mutex_lock(&g_work_queue.queue_lock);
-                    {
-                        entry->scan_info = &scanline_info[hy];
-                        entry->next = g_work_queue.next;
-                        g_work_queue.next = entry;
-                        g_work_queue.count++;
-                        pthread_cond_signal(&g_work_queue.cond);
-                    }
-                    pthread_mutex_unlock(&g_work_queue.queue_lock);
+                    drawFractalTile(window, draw_surface, g_render_pipeline.pixels, &rect,
+                                    &views[render_view], &palettes[palette_index]);
+                    drawn += (rect.x1 - rect.x0 + 1) * (rect.y1 - rect.y0 + 1);
                 }
+            }
+            
+            if(rendering && __atomic_load_n(&g_render_pipeline.done, __ATOMIC_ACQUIRE) == render_generation)
+            {
+                ZoomView *view = &views[render_view];
                 
-                while(g_work_queue.count)
-                {
-                    pthread_mutex_lock(&g_work_queue.queue_lock);
-                    pthread_cond_signal(&g_work_queue.cond);
-                    pthread_mutex_unlock(&g_work_queue.queue_lock);
-                }
+                // the render thread is idle until the next request, which takes its lock
+                std::swap(view->pixels, g_render_pipeline.pixels);
+                
+                view->pixels_itermax = view->itermax;
+                view->pixels_mode    = frame_mode;
+                setViewOrbits(view, &g_render_pipeline.orbits);
+                
+                SDL_SetWindowTitle(window, title);
+                
+                rendering   = false;
+                redraw      = true;
+            }
+            else if(g_speculation.rendering >= 0 &&
+                    __atomic_load_n(&g_render_pipeline.done, __ATOMIC_ACQUIRE) == g_speculation.generation)
+            {
+                finishSpeculation();
+            }
+            else if(drawn)
+            {
+                char        progress[320];
+                double      elapsed = getSeconds() - render_started;
+                
+                unsigned    total = xres * yres;
+                
+                render_pixels = std::min(render_pixels + drawn, total);
+                
+                // the pixels left cost what the ones so far cost, near enough once the order mixes them
+                snprintf(progress, sizeof(progress), "%s - %u%%, %.1fs left", title,
+                         (unsigned)(100ull * render_pixels / total),
+                         elapsed * (total - render_pixels) / render_pixels);
+                
+                SDL_SetWindowTitle(window, progress);
+                
+                drawRenderProgress(window, render_pixels, total);
+                SDL_UpdateWindowSurface(window);
             }
         }
         
-        if(update || redraw)
+        if(redraw)
         {
             int         hx, hy;
             float       color_scale = 1.0;
@@ -1292,20 +6839,32 @@ void updateLoop(SDL_Window* window, SDL_Surface *draw_surface)
                 surface_pixels = (unsigned *)screen_surface->pixels;
                 
                 unsigned draw_color = 0xffffffff;
-                switch(render_mode)
+                switch(frame_mode)
                 {
                     case kRenderModeDouble:
                         draw_color = 0xff;
                         break;
                         
+                    case kRenderModeDoubleDouble:
+                        draw_color = 0xff00ff;
+                        break;
+                        
 #ifdef USE_BIGNUM
                     case kRenderModeBigNUM:
                         draw_color = 0xff00;
                         break;
+                        
+                    case kRenderModePerturbation:
+                        draw_color = 0xffff00;
+                        break;
 #endif
                     case kRenderModeOpenCL:
                         draw_color = 0xff0000;
                         break;
+                        
+                    case kRenderModeHybrid:
+                        draw_color = 0xff8000;
+                        break;
                 }
                 
                 unsigned *dst = &surface_pixels[(yres / 2) * (screen_surface->pitch >> 2)];
@@ -1325,16 +6884,173 @@ void updateLoop(SDL_Window* window, SDL_Surface *draw_surface)
             //Update the surface
             SDL_UpdateWindowSurface( window );
             
-            update = false;
             redraw = false;
         }
+        
+        // idle, the render thread gets one of the views the next input is likely to ask for
+        if(g_use_speculation && !rendering && !update && !finished && g_speculation.rendering < 0)
+        {
+            speculateNextView(&views[zoom_index], render_mode, mouse_x, mouse_y, cost);
+        }
     }
+    
+    stopRenderThread();
+    stopSpeculation();
+    freeSpeculation();
 }
 
 int main(int argc, const char * argv[])
 {
     //The window we'll be rendering to
     SDL_Window* window = NULL;
+    const char  *worker_address = NULL;
+    unsigned    test_workers = 0;
+    
+    for(int i=1; i<argc; i++)
+    {
+        if(!strcmp(argv[i], "-bench"))
+        {
+            benchmarkSIMDKernels();
+            
+            startCalcThreads(getCalcThreadCount());
+            benchmarkWorkQueue();
+            benchmarkScaling();
+            benchmarkTiles();
+            benchmarkFocus();
+            benchmarkCostModel();
+            benchmarkCancel();
+            benchmarkSubdivision();
+            benchmarkResume();
+            benchmarkPan();
+#ifdef USE_BIGNUM
+            benchmarkPerturbation();
+            benchmarkFixedPoint();
+            benchmarkDoubleDouble();
+            benchmarkEscalation();
+#endif
+            
+            return 0;
+        }
+        else if(!strcmp(argv[i], "-auto"))
+        {
+            g_start_auto = true;
+        }
+        else if(!strcmp(argv[i], "-no-subdivision"))
+        {
+            g_use_subdivision = false;
+        }
+        else if(!strcmp(argv[i], "-no-bla"))
+        {
+            g_use_bla = false;
+        }
+        else if(!strcmp(argv[i], "-escalate"))
+        {
+            g_use_escalation = true;
+        }
+        else if(!strcmp(argv[i], "-no-glitch-correction"))
+        {
+            g_use_glitch_correction = false;
+        }
+        else if(!strcmp(argv[i], "-bla-epsilon") && i+1 < argc)
+        {
+            // relative size of the dropped d^2 term a table step may ignore
+            g_bla_epsilon = atof(argv[++i]);
+        }
+        else if(!strcmp(argv[i], "-no-periodicity"))
+        {
+            g_kernel_options.flags &= ~kKernelPeriodicityCheck;
+        }
+        else if(!strcmp(argv[i], "-period-tolerance") && i+1 < argc)
+        {
+            // in pixels, an orbit has to repeat this closely to count as interior
+            g_kernel_options.periodicity_tolerance = atof(argv[++i]);
+        }
+        else if(!strcmp(argv[i], "-period-interval") && i+1 < argc)
+        {
+            int interval = atoi(argv[++i]);
+            
+            g_kernel_options.periodicity_interval = interval > 0 ? interval : 1;
+        }
+        else if(!strcmp(argv[i], "-threads") && i+1 < argc)
+        {
+            // calc threads, 0 for one per cpu
+            g_calc_threads = atoi(argv[++i]);
+        }
+        else if(!strcmp(argv[i], "-pin"))
+        {
+            g_pin_threads = true;
+        }
+        else if(!strcmp(argv[i], "-tile-size") && i+1 < argc)
+        {
+            g_tile_size = std::min(std::max((unsigned)atoi(argv[++i]), (unsigned)kMinTileSize), (unsigned)kMaxTileSize);
+        }
+        else if(!strcmp(argv[i], "-no-focus"))
+        {
+            g_use_focus = false;
+        }
+        else if(!strcmp(argv[i], "-no-cost-model"))
+        {
+            g_use_cost_model = false;
+        }
+        else if(!strcmp(argv[i], "-no-speculation"))
+        {
+            g_use_speculation = false;
+        }
+        else if(!strcmp(argv[i], "-no-resume"))
+        {
+            g_use_resume = false;
+        }
+        else if(!strcmp(argv[i], "-no-pan-reuse"))
+        {
+            g_use_pan_reuse = false;
+        }
+        else if(!strcmp(argv[i], "-log-tile-cost"))
+        {
+            g_log_tile_cost = true;
+        }
+        else if(!strcmp(argv[i], "-worker") && i+1 < argc)
+        {
+            worker_address = argv[++i];
+        }
+        else if(!strcmp(argv[i], "-workers") && i+1 < argc)
+        {
+            setTileWorkers(argv[++i]);
+        }
+        else if(!strcmp(argv[i], "-test-workers") && i+1 < argc)
+        {
+            test_workers = atoi(argv[++i]);
+        }
+        else if(!strcmp(argv[i], "-tile-order") && i+1 < argc)
+        {
+            // rows / morton / hilbert
+            g_tile_order = findTileOrder(argv[++i]);
+        }
+        else if(!strcmp(argv[i], "-simd") && i+1 < argc)
+        {
+            // force a narrower kernel, scalar / sse2 / avx2 / avx512
+            if(!setSIMDLevel(findSIMDLevel(argv[++i])))
+            {
+                printf("SIMD level %s is not supported on this cpu\n", argv[i]);
+            }
+        }
+    }
+
+    printf("Using %s double kernel\n", getSIMDLevelName(getSIMDLevel()));
+
+    // no window for these
+    if(worker_address)
+    {
+        startCalcThreads(getCalcThreadCount());
+        
+        return runTileWorker(worker_address);
+    }
+    
+    if(test_workers)
+    {
+        startCalcThreads(getCalcThreadCount());
+        
+        return testTileWorkers(argv[0], test_workers);
+    }
     
     SDL_Surface *drawSurface = SDL_CreateRGBSurface(0,
                                                     SCREEN_WIDTH, SCREEN_HEIGHT,
@@ -0,0 +1,189 @@
+//
+//  mandelbrot.h
+//  mandelbrot-explorer
+//
+//  Copyright (c) 2014 Sandstorm Software. All rights reserved.
+//
+
+#ifndef mandelbrot_explorer_mandelbrot_h
+#define mandelbrot_explorer_mandelbrot_h
+
+#include <sys/time.h>
+#include <time.h>
+#include <math.h>
+#include <float.h>
+
+#include "floatexp.h"
+
+// KernelOptions flags
+#define kKernelCardioidCheck    0x1
+#define kKernelPeriodicityCheck 0x2
+#define kKernelGlitchCheck      0x4     // perturbation only, see perturbation.h
+#define kKernelErrorCheck       0x8     // iterateDouble only, see simd_kernel.h
+
+// Periodicity checking compares every step against an orbit point saved at the
+// start of a window, the window starts at periodicity_interval steps and doubles
+// each time it runs out (Brent). The tolerance is in pixels so a check can only
+// call a pixel interior once its orbit repeats to well under a pixel.
+#define kDefaultPeriodicityTolerance    1e-3
+#define kDefaultPeriodicityInterval     8
+
+typedef struct {
+    unsigned            flags;
+    double              periodicity_tolerance;  // in pixels
+    unsigned            periodicity_interval;   // first window length in steps
+    double              pixel_spacing;          // set per frame, 3.0/(zoom*xres), see getPixelSpacing
+    const unsigned      *cancel_generation;     // optional, see isKernelCancelled
+    unsigned            generation;
+} KernelOptions;
+
+// A render can be dropped half way: its owner bumps *cancel_generation and the
+// kernels, which compare it with the generation they were started for every
+// kCancelCheckInterval steps, return early and leave junk in the pixels.
+#define kCancelCheckInterval    4096
+
+static inline bool isKernelCancelled(const KernelOptions *options)
+{
+    return options->cancel_generation &&
+           __atomic_load_n(options->cancel_generation, __ATOMIC_RELAXED) != options->generation;
+}
+
+// at every kCancelCheckInterval'th step
+static inline bool isKernelCancelledAt(const KernelOptions *options, unsigned step)
+{
+    return !(step & (kCancelCheckInterval - 1)) && isKernelCancelled(options);
+}
+
+// counters are summed per work item and added to the frame totals with addKernelStats
+typedef struct {
+    unsigned long long  cardioid_skipped;       // pixels found inside the main cardioid or period 2 bulb
+    unsigned long long  periodic_pixels;        // pixels stopped early by the periodicity check
+    unsigned long long  periodicity_saved;      // iterations those pixels did not have to run
+    unsigned long long  subdivision_filled;     // pixels filled from a uniform rectangle border
+    unsigned long long  reference_exhausted;    // perturbation pixels still running when the reference orbit ended
+    unsigned long long  bla_steps;              // BLA table steps taken
+    unsigned long long  bla_skipped;            // iterations those steps saved over single steps
+    unsigned long long  glitched_pixels;        // perturbation pixels flagged kGlitchedPixel
+    unsigned long long  glitch_references;      // secondary references computed for glitched pixels
+    unsigned long long  glitch_passes;          // passes re-rendering glitched pixels
+    unsigned long long  glitch_unresolved;      // pixels still glitched after the last pass
+    unsigned long long  escalated_pixels;       // double pixels flagged kUnreliablePixel and redone in bignum
+} KernelStats;
+
+static inline double getPeriodicityEpsilon(const KernelOptions *options)
+{
+    return options->periodicity_tolerance * options->pixel_spacing;
+}
+
+// Closed form membership test for the two largest components of the set, a
+// pixel in either one never escapes so it can be written as 0 up front.
+static inline bool inCardioidOrBulb(double cx, double cy)
+{
+    double x = cx - 0.25;
+    double y2 = cy * cy;
+    double q = x * x + y2;
+
+    // main cardioid
+    if(q * (q + x) <= 0.25 * y2)
+        return true;
+
+    // period 2 bulb, the circle of radius 1/4 around -1
+    x = cx + 1.0;
+
+    return x * x + y2 <= 0.0625;
+}
+
+// The test takes c rounded to a double. That is only as good as the pixels while
+// they are much further apart than the rounding of |c|, deeper it answers for a
+// patch of pixels at once and gets the ones near the boundary wrong. The kernels
+// whose c is finer than a double leave it off past that, see setFrameOptions.
+#define kCardioidSpacingUlps    1e3
+
+static inline bool isCardioidTestExact(double pixel_spacing, double cx, double cy)
+{
+    return pixel_spacing >= kCardioidSpacingUlps * DBL_EPSILON * (fabs(cx) + fabs(cy));
+}
+
+// A view is 3.0/zoom across. The zoom is a FloatExp so it can go past the top of
+// the double range, which Z held reaches in about a thousand views, and it stops
+// at 2^kMaxZoomExponent. That keeps the bits of the centers, and of the reference
+// orbits and tile jobs made from them, bounded.
+#define kMaxZoomExponent        4096
+
+// d / zoom as a double, 0 once that is under the double range
+static inline double getZoomOffset(double d, FloatExp zoom)
+{
+    return floatExpToDouble(makeFloatExp(d / zoom.m, -zoom.e));
+}
+
+// 3.0/(zoom*xres), 0 past the double range like getZoomOffset
+static inline double getPixelSpacing(FloatExp zoom, unsigned xres)
+{
+    return floatExpToDouble(makeFloatExp(3.0 / (zoom.m * xres), -zoom.e));
+}
+
+// Mantissa bits a frame's c needs: enough for the pixels across |c| < 4 plus
+// kPrecisionGuardBits for the error the iteration piles up, and never under a
+// double's worth. The bignum loops and the reference orbit all use this.
+#define kPrecisionGuardBits     32
+
+static inline unsigned getPrecisionBits(FloatExp zoom, unsigned xres)
+{
+    FloatExp    pixels = floatExpMulDouble(zoom, 4.0 * xres / 3.0);
+    unsigned    bits = kPrecisionGuardBits;
+
+    // ceil(log2(pixels)) past one pixel
+    if(pixels.e > 0 || (pixels.e == 0 && pixels.m > 1.0))
+        bits += pixels.e + (pixels.m > 1.0);
+
+    return bits < 64 ? 64 : bits;
+}
+
+// bits of c that tell the pixels of a frame apart, the largest |c| in it over
+// the pixel spacing, without any guard
+static inline unsigned getSignificantBits(double center_x, double center_y, FloatExp zoom, unsigned xres)
+{
+    // (|c| + 1.5/zoom) / (3.0/(zoom*xres))
+    FloatExp    ratio = floatExpAdd(floatExpMulDouble(zoom, fmax(fabs(center_x), fabs(center_y)) * xres / 3.0),
+                                    floatExpFromDouble(0.5 * xres));
+    double      bits = ceil(ratio.e + log2(ratio.m));
+
+    return bits > 1.0 ? (unsigned)bits : 1;
+}
+
+static inline double getSeconds(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+// cpu time of the calling thread, against getSeconds it tells waiting from spinning
+static inline double getThreadSeconds(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static inline void addKernelStats(KernelStats *dst, const KernelStats *src)
+{
+    __sync_fetch_and_add(&dst->cardioid_skipped, src->cardioid_skipped);
+    __sync_fetch_and_add(&dst->periodic_pixels, src->periodic_pixels);
+    __sync_fetch_and_add(&dst->periodicity_saved, src->periodicity_saved);
+    __sync_fetch_and_add(&dst->subdivision_filled, src->subdivision_filled);
+    __sync_fetch_and_add(&dst->reference_exhausted, src->reference_exhausted);
+    __sync_fetch_and_add(&dst->bla_steps, src->bla_steps);
+    __sync_fetch_and_add(&dst->bla_skipped, src->bla_skipped);
+    __sync_fetch_and_add(&dst->glitched_pixels, src->glitched_pixels);
+    __sync_fetch_and_add(&dst->glitch_references, src->glitch_references);
+    __sync_fetch_and_add(&dst->glitch_passes, src->glitch_passes);
+    __sync_fetch_and_add(&dst->glitch_unresolved, src->glitch_unresolved);
+    __sync_fetch_and_add(&dst->escalated_pixels, src->escalated_pixels);
+}
+
+#endif
@@ -0,0 +1,694 @@
+//
+//  perturbation.cpp
+//  mandelbrot-explorer
+//
+//  Copyright (c) 2014 Sandstorm Software. All rights reserved.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "gmp.h"
+
+#include "perturbation.h"
+#include "simd_kernel.h"
+#include "bla.h"
+#include "floatexp.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define USE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+void initReferenceOrbit(ReferenceOrbit *orbit)
+{
+    memset(orbit, 0, sizeof(*orbit));
+}
+
+void freeReferenceOrbit(ReferenceOrbit *orbit)
+{
+    delete [] orbit->x;
+    delete [] orbit->y;
+
+    initReferenceOrbit(orbit);
+}
+
+void computeReferenceOrbit(ReferenceOrbit *orbit, mpf_srcptr center_x, mpf_srcptr center_y,
+                           double offset_x, double offset_y, int offset_exponent, unsigned bits,
+                           unsigned itermax)
+{
+    double      start = getSeconds();
+    unsigned    n;
+
+    if(itermax > orbit->capacity)
+    {
+        delete [] orbit->x;
+        delete [] orbit->y;
+
+        orbit->x        = new double [itermax];
+        orbit->y        = new double [itermax];
+        orbit->capacity = itermax;
+    }
+
+    orbit->precision    = bits;
+
+    mpf_t   _x, _y;
+    mpf_t   _cx, _cy;
+    mpf_t   _xx, _yy, _xy;
+
+    mpf_init2(_x, bits);
+    mpf_init2(_y, bits);
+    mpf_init2(_cx, bits);
+    mpf_init2(_cy, bits);
+    mpf_init2(_xx, bits);
+    mpf_init2(_yy, bits);
+    mpf_init2(_xy, bits);
+
+    setScaledOffset(_cx, offset_x, offset_exponent);
+    setScaledOffset(_cy, offset_y, offset_exponent);
+    mpf_add(_cx, _cx, center_x);
+    mpf_add(_cy, _cy, center_y);
+
+    orbit->center_x     = mpf_get_d(_cx);
+    orbit->center_y     = mpf_get_d(_cy);
+
+    orbit->x[0] = 0.0;
+    orbit->y[0] = 0.0;
+
+    for(n=1; n<itermax; n++)
+    {
+        // x = x*x-y*y+cx; y = 2.0*x*y+cy;
+        mpf_mul(_xx, _x, _x);
+        mpf_mul(_yy, _y, _y);
+        mpf_mul(_xy, _x, _y);
+
+        mpf_sub(_x, _xx, _yy);
+        mpf_add(_x, _x, _cx);
+        mpf_mul_2exp(_xy, _xy, 1);
+        mpf_add(_y, _xy, _cy);
+
+        double x = mpf_get_d(_x);
+        double y = mpf_get_d(_y);
+
+        orbit->x[n] = x;
+        orbit->y[n] = y;
+
+        if(x*x+y*y > 100.0)
+        {
+            n++;
+            break;
+        }
+    }
+
+    orbit->length = n;
+
+    mpf_clear(_x);
+    mpf_clear(_y);
+    mpf_clear(_cx);
+    mpf_clear(_cy);
+    mpf_clear(_xx);
+    mpf_clear(_yy);
+    mpf_clear(_xy);
+
+    orbit->elapsed = getSeconds() - start;
+}
+
+// Runs a pixel on once the reference has no Z_n+1 left. By then the pixel has
+// followed an escaping reference for most of the way, the absolute doubles only
+// have to carry it the last few steps. With the glitch check the pixel is left
+// for another reference instead, c rounded to doubles is off at depth.
+static unsigned finishDirect(unsigned flags, const ReferenceOrbit *orbit, double dx, double dy, double dcx, double dcy,
+                             unsigned n, unsigned itermax, KernelStats *stats)
+{
+    double  x = orbit->x[n] + dx;
+    double  y = orbit->y[n] + dy;
+    double  cx = orbit->center_x + dcx;
+    double  cy = orbit->center_y + dcy;
+
+    stats->reference_exhausted++;
+
+    if(flags & kKernelGlitchCheck)
+    {
+        stats->glitched_pixels++;
+        return kGlitchedPixel | n;
+    }
+
+    while(n + 1 < itermax)
+    {
+        double xx = x*x-y*y+cx;
+
+        y = 2.0*x*y+cy;
+        x = xx;
+        n++;
+
+        if(x*x+y*y > 100.0)
+            return n + 1;
+    }
+
+    return 0;
+}
+
+// Pauldelbrot's test, z = Z + d against Z
+static inline __attribute__((always_inline)) bool isGlitched(double x, double y, double zx, double zy)
+{
+    return x*x+y*y < kGlitchTolerance * (zx*zx+zy*zy);
+}
+
+// With a BLA table a pixel takes its first step, d_1 = dc as Z_0 = 0, and then as
+// many table steps as hold before it goes on one step at a time. Returns true with
+// the pixel value in *value when that already finished it.
+static inline __attribute__((always_inline)) bool startPerturbation(unsigned flags, const ReferenceOrbit *orbit,
+                                                                    const BLATable *bla, double dcx, double dcy,
+                                                                    double *dx, double *dy, unsigned *n, unsigned itermax,
+                                                                    unsigned *value, KernelStats *stats)
+{
+    unsigned last = orbit->length - 1;
+
+    *dx = 0.0;
+    *dy = 0.0;
+    *n  = 0;
+
+    if(!bla || !bla->levels || itermax < 2)
+        return false;
+
+    *dx = dcx;
+    *dy = dcy;
+    *n  = skipBLA(bla, dx, dy, dcx, dcy, 1, itermax - 1 < last ? itermax - 1 : last, stats);
+
+    double x = orbit->x[*n] + *dx;
+    double y = orbit->y[*n] + *dy;
+
+    if(x*x+y*y > 100.0)
+    {
+        *value = *n + 1;
+        return true;
+    }
+
+    if((flags & kKernelGlitchCheck) && isGlitched(x, y, orbit->x[*n], orbit->y[*n]))
+    {
+        stats->glitched_pixels++;
+        *value = kGlitchedPixel | *n;
+        return true;
+    }
+
+    if(*n + 1 >= itermax)
+    {
+        *value = 0;
+        return true;
+    }
+
+    if(*n == last)
+    {
+        *value = finishDirect(flags, orbit, *dx, *dy, dcx, dcy, *n, itermax, stats);
+        return true;
+    }
+
+    return false;
+}
+
+// n is the number of steps taken, a pixel that escapes on step n gets n + 1 like
+// the loop in calcPixelBigNUM. The periodicity check is not used here, at the
+// depths this mode is for a pixel of tolerance is far below what Z + d resolves.
+static void iteratePerturbationScalar(const KernelOptions *options, const ReferenceOrbit *orbit, const BLATable *bla,
+                                      const double *dcx, const double *dcy, unsigned count, unsigned itermax,
+                                      unsigned *pixels, KernelStats *stats)
+{
+    const double    *zx = orbit->x;
+    const double    *zy = orbit->y;
+    unsigned        last = orbit->length - 1;
+    bool            glitch_check = options->flags & kKernelGlitchCheck;
+    unsigned        steps = 0;
+
+    for(unsigned i=0; i<count; i++)
+    {
+        double      dx, dy;
+        double      cx = dcx[i], cy = dcy[i];
+        unsigned    n;
+        unsigned    value = 0;
+
+        if((options->flags & kKernelCardioidCheck) && inCardioidOrBulb(orbit->center_x + cx, orbit->center_y + cy))
+        {
+            pixels[i] = 0;
+            stats->cardioid_skipped++;
+            continue;
+        }
+
+        if(startPerturbation(options->flags, orbit, bla, cx, cy, &dx, &dy, &n, itermax, &value, stats))
+        {
+            pixels[i] = value;
+            continue;
+        }
+
+        while(n + 1 < itermax)
+        {
+            if(isKernelCancelledAt(options, ++steps))
+                return;
+
+            if(n == last)
+            {
+                value = finishDirect(options->flags, orbit, dx, dy, cx, cy, n, itermax, stats);
+                break;
+            }
+
+            // d = 2*Z*d + d*d + dc
+            double x = zx[n], y = zy[n];
+            double xx = 2.0*(x*dx - y*dy) + (dx*dx - dy*dy) + cx;
+
+            dy = 2.0*(x*dy + y*dx) + 2.0*dx*dy + cy;
+            dx = xx;
+            n++;
+
+            x = zx[n] + dx;
+            y = zy[n] + dy;
+
+            if(x*x+y*y > 100.0)
+            {
+                value = n + 1;
+                break;
+            }
+
+            if(glitch_check && isGlitched(x, y, zx[n], zy[n]))
+            {
+                stats->glitched_pixels++;
+                value = kGlitchedPixel | n;
+                break;
+            }
+        }
+
+        pixels[i] = value;
+    }
+}
+
+// Same steps as iteratePerturbationScalar. Z_n is still a double, it is d, dc
+// and the BLA steps on them that need the exponent range. Z + d and the finish
+// after the reference only need d to the precision of Z, so those use doubles.
+// There is no cardioid / bulb test, past kFloatExpZoom the center plus dc is
+// the center.
+void iteratePerturbationFloatExp(const KernelOptions *options, const ReferenceOrbit *orbit, const BLATable *bla,
+                                 const double *dcx, const double *dcy, int dc_exponent, unsigned count,
+                                 unsigned itermax, unsigned *pixels, KernelStats *stats)
+{
+    const double    *zx = orbit->x;
+    const double    *zy = orbit->y;
+    unsigned        last = orbit->length - 1;
+    bool            glitch_check = options->flags & kKernelGlitchCheck;
+    FloatExp        zero = floatExpFromDouble(0.0);
+    unsigned        steps = 0;
+
+    for(unsigned i=0; i<count; i++)
+    {
+        FloatExp    cx = makeFloatExp(dcx[i], dc_exponent);
+        FloatExp    cy = makeFloatExp(dcy[i], dc_exponent);
+        FloatExp    dx = zero, dy = zero;
+        unsigned    n = 0;
+        unsigned    value = 0;
+
+        if(bla && bla->levels && itermax >= 2)
+        {
+            dx = cx;
+            dy = cy;
+            n  = skipBLAFloatExp(bla, &dx, &dy, cx, cy, 1, itermax - 1 < last ? itermax - 1 : last, stats);
+
+            double x = zx[n] + floatExpToDouble(dx);
+            double y = zy[n] + floatExpToDouble(dy);
+
+            if(x*x+y*y > 100.0)
+            {
+                pixels[i] = n + 1;
+                continue;
+            }
+
+            if(glitch_check && isGlitched(x, y, zx[n], zy[n]))
+            {
+                stats->glitched_pixels++;
+                pixels[i] = kGlitchedPixel | n;
+                continue;
+            }
+        }
+
+        while(n + 1 < itermax)
+        {
+            if(isKernelCancelledAt(options, ++steps))
+                return;
+
+            if(n == last)
+            {
+                value = finishDirect(options->flags, orbit, floatExpToDouble(dx), floatExpToDouble(dy),
+                                     floatExpToDouble(cx), floatExpToDouble(cy), n, itermax, stats);
+                break;
+            }
+
+            // d = (2Z + d) * d + dc
+            FloatExp tx = floatExpAdd(floatExpFromDouble(2.0*zx[n]), dx);
+            FloatExp ty = floatExpAdd(floatExpFromDouble(2.0*zy[n]), dy);
+            FloatExp xx = floatExpAdd(floatExpSub(floatExpMul(tx, dx), floatExpMul(ty, dy)), cx);
+
+            dy = floatExpAdd(floatExpAdd(floatExpMul(tx, dy), floatExpMul(ty, dx)), cy);
+            dx = xx;
+            n++;
+
+            double x = zx[n] + floatExpToDouble(dx);
+            double y = zy[n] + floatExpToDouble(dy);
+
+            if(x*x+y*y > 100.0)
+            {
+                value = n + 1;
+                break;
+            }
+
+            if(glitch_check && isGlitched(x, y, zx[n], zy[n]))
+            {
+                stats->glitched_pixels++;
+                value = kGlitchedPixel | n;
+                break;
+            }
+        }
+
+        pixels[i] = value;
+    }
+}
+
+#ifdef USE_X86_SIMD
+// Same lane scheme as simd_kernel.cpp, a lane that finishes is written back and
+// given the next pixel. Each lane is at its own step so Z_n comes from a gather.
+// An empty lane has step 0, so n stays 0 and never reaches a limit, and live
+// masks it out of the retire test. The helpers are forced inline for the same
+// sse / avx transition reason as there.
+typedef struct {
+    unsigned            count;
+    unsigned            next;
+    unsigned            active;
+    unsigned            live;
+    unsigned            flags;
+    unsigned            itermax;
+    const ReferenceOrbit *orbit;
+    const BLATable      *bla;
+    const double        *dcx, *dcy;
+    unsigned            *pixels;
+    KernelStats         *stats;
+} PerturbationFeed;
+
+typedef struct {
+    int     index[8];
+    double  dx[8] __attribute__((aligned(64)));
+    double  dy[8] __attribute__((aligned(64)));
+    double  dcx[8] __attribute__((aligned(64)));
+    double  dcy[8] __attribute__((aligned(64)));
+    double  n[8] __attribute__((aligned(64)));
+    double  step[8] __attribute__((aligned(64)));
+} PerturbationLanes;
+
+static inline __attribute__((always_inline)) void refillPerturbationLane(PerturbationFeed *feed, PerturbationLanes *lanes, int lane)
+{
+    lanes->dx[lane] = 0.0;
+    lanes->dy[lane] = 0.0;
+    lanes->n[lane]  = 0.0;
+
+    while(feed->next < feed->count)
+    {
+        unsigned    i = feed->next++;
+        unsigned    n, value;
+
+        if((feed->flags & kKernelCardioidCheck) &&
+           inCardioidOrBulb(feed->orbit->center_x + feed->dcx[i], feed->orbit->center_y + feed->dcy[i]))
+        {
+            feed->pixels[i] = 0;
+            feed->stats->cardioid_skipped++;
+            continue;
+        }
+
+        if(startPerturbation(feed->flags, feed->orbit, feed->bla, feed->dcx[i], feed->dcy[i], &lanes->dx[lane], &lanes->dy[lane],
+                             &n, feed->itermax, &value, feed->stats))
+        {
+            feed->pixels[i] = value;
+            continue;
+        }
+
+        lanes->n[lane] = n;
+
+        if(lanes->index[lane] < 0)
+        {
+            feed->active++;
+        }
+
+        lanes->index[lane]  = i;
+        lanes->dcx[lane]    = feed->dcx[i];
+        lanes->dcy[lane]    = feed->dcy[i];
+        lanes->step[lane]   = 1.0;
+        feed->live          |= 1 << lane;
+
+        return;
+    }
+
+    if(lanes->index[lane] >= 0)
+    {
+        feed->active--;
+    }
+
+    lanes->index[lane]  = -1;
+    lanes->dcx[lane]    = 0.0;
+    lanes->dcy[lane]    = 0.0;
+    lanes->step[lane]   = 0.0;
+    feed->live          &= ~(1 << lane);
+}
+
+static inline __attribute__((always_inline)) void retirePerturbationLanes(PerturbationFeed *feed, PerturbationLanes *lanes,
+                                                                          unsigned mask, unsigned escaped, unsigned glitched)
+{
+    while(mask)
+    {
+        int         lane = __builtin_ctz(mask);
+        int         index = lanes->index[lane];
+        unsigned    n = (unsigned)lanes->n[lane];
+
+        mask &= mask - 1;
+
+        if(escaped & (1 << lane))
+        {
+            feed->pixels[index] = n + 1;
+        }
+        else if(glitched & (1 << lane))
+        {
+            feed->stats->glitched_pixels++;
+            feed->pixels[index] = kGlitchedPixel | n;
+        }
+        else if(n + 1 >= feed->itermax)
+        {
+            feed->pixels[index] = 0;
+        }
+        else
+        {
+            feed->pixels[index] = finishDirect(feed->flags, feed->orbit, lanes->dx[lane], lanes->dy[lane],
+                                               lanes->dcx[lane], lanes->dcy[lane], n, feed->itermax, feed->stats);
+        }
+
+        refillPerturbationLane(feed, lanes, lane);
+    }
+}
+
+static void initPerturbationLanes(PerturbationFeed *feed, PerturbationLanes *lanes, int count,
+                                  const KernelOptions *options, const ReferenceOrbit *orbit, const BLATable *bla,
+                                  const double *dcx, const double *dcy, unsigned pixel_count, unsigned itermax,
+                                  unsigned *pixels, KernelStats *stats)
+{
+    feed->count     = pixel_count;
+    feed->next      = 0;
+    feed->active    = 0;
+    feed->live      = 0;
+    feed->flags     = options->flags;
+    feed->itermax   = itermax;
+    feed->orbit     = orbit;
+    feed->bla       = bla;
+    feed->dcx       = dcx;
+    feed->dcy       = dcy;
+    feed->pixels    = pixels;
+    feed->stats     = stats;
+
+    for(int lane=0; lane<count; lane++)
+    {
+        lanes->index[lane] = -1;
+        refillPerturbationLane(feed, lanes, lane);
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void iteratePerturbationAVX2(const KernelOptions *options, const ReferenceOrbit *orbit, const BLATable *bla,
+                                    const double *dcx, const double *dcy, unsigned count, unsigned itermax,
+                                    unsigned *pixels, KernelStats *stats)
+{
+    PerturbationFeed    feed;
+    PerturbationLanes   lanes;
+    unsigned            steps = 0;
+
+    initPerturbationLanes(&feed, &lanes, 4, options, orbit, bla, dcx, dcy, count, itermax, pixels, stats);
+
+    __m256d dx      = _mm256_load_pd(lanes.dx);
+    __m256d dy      = _mm256_load_pd(lanes.dy);
+    __m256d vcx     = _mm256_load_pd(lanes.dcx);
+    __m256d vcy     = _mm256_load_pd(lanes.dcy);
+    __m256d n       = _mm256_load_pd(lanes.n);
+    __m256d step    = _mm256_load_pd(lanes.step);
+    __m256d bailout = _mm256_set1_pd(100.0);
+    __m256d limit   = _mm256_set1_pd((double)itermax - 1.0);
+    __m256d last    = _mm256_set1_pd((double)orbit->length - 1.0);
+    __m256d glitch  = _mm256_set1_pd((options->flags & kKernelGlitchCheck) ? kGlitchTolerance : 0.0);
+
+    while(feed.active)
+    {
+        if(isKernelCancelledAt(options, ++steps))
+            return;
+
+        // d = 2*Z*d + d*d + dc
+        __m128i index   = _mm256_cvttpd_epi32(n);
+        __m256d zx      = _mm256_i32gather_pd(orbit->x, index, 8);
+        __m256d zy      = _mm256_i32gather_pd(orbit->y, index, 8);
+        __m256d tx      = _mm256_add_pd(zx, dx);
+        __m256d ty      = _mm256_add_pd(zy, dy);
+
+        // 2Zd + d^2 = (2Z + d) * d
+        tx = _mm256_add_pd(tx, zx);
+        ty = _mm256_add_pd(ty, zy);
+
+        __m256d xx = _mm256_fmsub_pd(tx, dx, _mm256_fmsub_pd(ty, dy, vcx));
+
+        dy = _mm256_fmadd_pd(tx, dy, _mm256_fmadd_pd(ty, dx, vcy));
+        dx = xx;
+        n  = _mm256_add_pd(n, step);
+
+        index   = _mm256_cvttpd_epi32(n);
+        zx      = _mm256_i32gather_pd(orbit->x, index, 8);
+        zy      = _mm256_i32gather_pd(orbit->y, index, 8);
+        tx      = _mm256_add_pd(zx, dx);
+        ty      = _mm256_add_pd(zy, dy);
+
+        // a tolerance of 0 turns the glitch test off
+        __m256d mag     = _mm256_fmadd_pd(tx, tx, _mm256_mul_pd(ty, ty));
+        __m256d zmag    = _mm256_fmadd_pd(zx, zx, _mm256_mul_pd(zy, zy));
+        __m256d escaped = _mm256_cmp_pd(mag, bailout, _CMP_GT_OQ);
+        __m256d glitched = _mm256_cmp_pd(mag, _mm256_mul_pd(zmag, glitch), _CMP_LT_OQ);
+        __m256d stop    = _mm256_or_pd(_mm256_cmp_pd(n, limit, _CMP_GE_OQ), _mm256_cmp_pd(n, last, _CMP_GE_OQ));
+
+        unsigned mask = _mm256_movemask_pd(_mm256_or_pd(_mm256_or_pd(escaped, glitched), stop)) & feed.live;
+
+        if(mask)
+        {
+            _mm256_store_pd(lanes.dx, dx); _mm256_store_pd(lanes.dy, dy);
+            _mm256_store_pd(lanes.dcx, vcx); _mm256_store_pd(lanes.dcy, vcy);
+            _mm256_store_pd(lanes.n, n); _mm256_store_pd(lanes.step, step);
+
+            retirePerturbationLanes(&feed, &lanes, mask, _mm256_movemask_pd(escaped), _mm256_movemask_pd(glitched));
+
+            dx = _mm256_load_pd(lanes.dx); dy = _mm256_load_pd(lanes.dy);
+            vcx = _mm256_load_pd(lanes.dcx); vcy = _mm256_load_pd(lanes.dcy);
+            n = _mm256_load_pd(lanes.n); step = _mm256_load_pd(lanes.step);
+        }
+    }
+}
+
+__attribute__((target("avx512f")))
+static void iteratePerturbationAVX512(const KernelOptions *options, const ReferenceOrbit *orbit, const BLATable *bla,
+                                      const double *dcx, const double *dcy, unsigned count, unsigned itermax,
+                                      unsigned *pixels, KernelStats *stats)
+{
+    PerturbationFeed    feed;
+    PerturbationLanes   lanes;
+    unsigned            steps = 0;
+
+    initPerturbationLanes(&feed, &lanes, 8, options, orbit, bla, dcx, dcy, count, itermax, pixels, stats);
+
+    __m512d dx      = _mm512_load_pd(lanes.dx);
+    __m512d dy      = _mm512_load_pd(lanes.dy);
+    __m512d vcx     = _mm512_load_pd(lanes.dcx);
+    __m512d vcy     = _mm512_load_pd(lanes.dcy);
+    __m512d n       = _mm512_load_pd(lanes.n);
+    __m512d step    = _mm512_load_pd(lanes.step);
+    __m512d bailout = _mm512_set1_pd(100.0);
+    __m512d limit   = _mm512_set1_pd((double)itermax - 1.0);
+    __m512d last    = _mm512_set1_pd((double)orbit->length - 1.0);
+    __m512d glitch  = _mm512_set1_pd((options->flags & kKernelGlitchCheck) ? kGlitchTolerance : 0.0);
+
+    while(feed.active)
+    {
+        if(isKernelCancelledAt(options, ++steps))
+            return;
+
+        // d = 2*Z*d + d*d + dc, with 2Zd + d^2 = (2Z + d) * d
+        __m256i index   = _mm512_cvttpd_epi32(n);
+        __m512d zx      = _mm512_i32gather_pd(index, orbit->x, 8);
+        __m512d zy      = _mm512_i32gather_pd(index, orbit->y, 8);
+        __m512d tx      = _mm512_add_pd(_mm512_add_pd(zx, zx), dx);
+        __m512d ty      = _mm512_add_pd(_mm512_add_pd(zy, zy), dy);
+
+        __m512d xx = _mm512_fmsub_pd(tx, dx, _mm512_fmsub_pd(ty, dy, vcx));
+
+        dy = _mm512_fmadd_pd(tx, dy, _mm512_fmadd_pd(ty, dx, vcy));
+        dx = xx;
+        n  = _mm512_add_pd(n, step);
+
+        index   = _mm512_cvttpd_epi32(n);
+        zx      = _mm512_i32gather_pd(index, orbit->x, 8);
+        zy      = _mm512_i32gather_pd(index, orbit->y, 8);
+        tx      = _mm512_add_pd(zx, dx);
+        ty      = _mm512_add_pd(zy, dy);
+
+        // a tolerance of 0 turns the glitch test off
+        __m512d     mag     = _mm512_fmadd_pd(tx, tx, _mm512_mul_pd(ty, ty));
+        __m512d     zmag    = _mm512_fmadd_pd(zx, zx, _mm512_mul_pd(zy, zy));
+        __mmask8    escaped = _mm512_cmp_pd_mask(mag, bailout, _CMP_GT_OQ);
+        __mmask8    glitched = _mm512_cmp_pd_mask(mag, _mm512_mul_pd(zmag, glitch), _CMP_LT_OQ);
+        __mmask8    stop    = _mm512_cmp_pd_mask(n, limit, _CMP_GE_OQ) | _mm512_cmp_pd_mask(n, last, _CMP_GE_OQ);
+
+        unsigned mask = (escaped | glitched | stop) & feed.live;
+
+        if(mask)
+        {
+            _mm512_store_pd(lanes.dx, dx); _mm512_store_pd(lanes.dy, dy);
+            _mm512_store_pd(lanes.dcx, vcx); _mm512_store_pd(lanes.dcy, vcy);
+            _mm512_store_pd(lanes.n, n); _mm512_store_pd(lanes.step, step);
+
+            retirePerturbationLanes(&feed, &lanes, mask, escaped, glitched);
+
+            dx = _mm512_load_pd(lanes.dx); dy = _mm512_load_pd(lanes.dy);
+            vcx = _mm512_load_pd(lanes.dcx); vcy = _mm512_load_pd(lanes.dcy);
+            n = _mm512_load_pd(lanes.n); step = _mm512_load_pd(lanes.step);
+        }
+    }
+}
+#endif // #ifdef USE_X86_SIMD
+
+void iteratePerturbationLevel(unsigned level, const KernelOptions *options, const ReferenceOrbit *orbit,
+                              const BLATable *bla, const double *dcx, const double *dcy, unsigned count,
+                              unsigned itermax, unsigned *pixels, KernelStats *stats)
+{
+    // the vector loops need a step to take and a Z_n+1 after it
+    if(itermax < 2 || orbit->length < 2)
+    {
+        level = kSIMDLevelScalar;
+    }
+
+    switch(level)
+    {
+#ifdef USE_X86_SIMD
+        case kSIMDLevelAVX512:
+            iteratePerturbationAVX512(options, orbit, bla, dcx, dcy, count, itermax, pixels, stats);
+            break;
+
+        // gathers need avx2, sse2 uses the scalar loop
+        case kSIMDLevelAVX2:
+            iteratePerturbationAVX2(options, orbit, bla, dcx, dcy, count, itermax, pixels, stats);
+            break;
+#endif
+        default:
+            iteratePerturbationScalar(options, orbit, bla, dcx, dcy, count, itermax, pixels, stats);
+            break;
+    }
+}
+
+void iteratePerturbation(const KernelOptions *options, const ReferenceOrbit *orbit, const BLATable *bla,
+                         const double *dcx, const double *dcy, unsigned count, unsigned itermax,
+                         unsigned *pixels, KernelStats *stats)
+{
+    iteratePerturbationLevel(getSIMDLevel(), options, orbit, bla, dcx, dcy, count, itermax, pixels, stats);
+}
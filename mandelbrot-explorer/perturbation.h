@@ -0,0 +1,81 @@
+//
+//  perturbation.h
+//  mandelbrot-explorer
+//
+//  Copyright (c) 2014 Sandstorm Software. All rights reserved.
+//
+
+#ifndef mandelbrot_explorer_perturbation_h
+#define mandelbrot_explorer_perturbation_h
+
+#include "gmp.h"
+
+#include "mandelbrot.h"
+
+// Z_n of one orbit iterated with gmp at the reference point and rounded to doubles.
+// length is the number of Z_n stored starting with Z_0 = 0, it is under itermax
+// when the reference escapes, the last value stored is then the escaping one.
+typedef struct {
+    double      center_x, center_y;     // the reference point rounded to doubles
+    unsigned    length;
+    unsigned    capacity;
+    unsigned    precision;      // mpf bits the orbit was iterated with
+    double      elapsed;        // seconds computeReferenceOrbit took
+    double      *x, *y;
+} ReferenceOrbit;
+
+void        initReferenceOrbit(ReferenceOrbit *orbit);
+void        freeReferenceOrbit(ReferenceOrbit *orbit);
+
+// dst = offset * 2^exponent, offsets past the bottom of the double range come as
+// a mantissa and exponent, see getZoomOffset
+static inline void setScaledOffset(mpf_ptr dst, double offset, int exponent)
+{
+    mpf_set_d(dst, offset);
+
+    if(exponent < 0)
+        mpf_div_2exp(dst, dst, -exponent);
+    else
+        mpf_mul_2exp(dst, dst, exponent);
+}
+
+// the reference point is center + offset * 2^offset_exponent, added up in gmp at
+// bits from getPrecisionBits
+void        computeReferenceOrbit(ReferenceOrbit *orbit, mpf_srcptr center_x, mpf_srcptr center_y,
+                                  double offset_x, double offset_y, int offset_exponent, unsigned bits,
+                                  unsigned itermax);
+
+struct BLATable_t;
+
+// Past this zoom the pixel offsets get too close to the bottom of the double
+// range, the perturbation renderer switches to iteratePerturbationFloatExp.
+#define kFloatExpZoom   1e290
+
+// With kKernelGlitchCheck a pixel whose Z + d gets small against Z has lost the
+// precision of d (Pauldelbrot), |Z + d|^2 < kGlitchTolerance |Z|^2. The kernels
+// stop it and write kGlitchedPixel | n, n the step it was found at, for the
+// renderer to redo with another reference. A pixel still running when the
+// reference ends is flagged the same way instead of being finished in doubles.
+#define kGlitchTolerance    1e-6
+#define kGlitchedPixel      0x80000000
+
+// Like iterateDouble, but dcx / dcy are the offsets of each pixel from the reference
+// point and only the offset of the orbit is iterated, d' = 2Zd + d^2 + dc. A pixel
+// still running when the reference runs out goes on with plain doubles. bla is
+// optional, see bla.h.
+void        iteratePerturbation(const KernelOptions *options, const ReferenceOrbit *orbit, const struct BLATable_t *bla,
+                                const double *dcx, const double *dcy, unsigned count, unsigned itermax,
+                                unsigned *pixels, KernelStats *stats);
+void        iteratePerturbationLevel(unsigned level, const KernelOptions *options, const ReferenceOrbit *orbit,
+                                     const struct BLATable_t *bla, const double *dcx, const double *dcy, unsigned count,
+                                     unsigned itermax, unsigned *pixels, KernelStats *stats);
+
+// iteratePerturbation with d and dc as FloatExp, see floatexp.h. The offsets are
+// passed as doubles scaled by 2^-dc_exponent, the pixel at dcx[i] is really
+// dcx[i] * 2^dc_exponent from the reference. Scalar only.
+void        iteratePerturbationFloatExp(const KernelOptions *options, const ReferenceOrbit *orbit,
+                                        const struct BLATable_t *bla, const double *dcx, const double *dcy,
+                                        int dc_exponent, unsigned count, unsigned itermax,
+                                        unsigned *pixels, KernelStats *stats);
+
+#endif
@@ -0,0 +1,865 @@
+//
+//  simd_kernel.cpp
+//  mandelbrot-explorer
+//
+//  Copyright (c) 2014 Sandstorm Software. All rights reserved.
+//
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "simd_kernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define USE_X86_SIMD
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+static unsigned     g_simd_level = kSIMDLevelCount;
+
+static const char   *g_simd_level_names[kSIMDLevelCount] = {
+    "scalar",
+    "sse2",
+    "avx2",
+    "avx512"
+};
+
+static unsigned     g_simd_level_widths[kSIMDLevelCount] = {
+    1,
+    2,
+    4,
+    8
+};
+
+#ifdef USE_X86_SIMD
+static uint64_t readXCR0(void)
+{
+    uint32_t eax, edx;
+
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+
+    return ((uint64_t)edx << 32) | eax;
+}
+#endif
+
+unsigned detectSIMDLevel(void)
+{
+    unsigned level = kSIMDLevelScalar;
+
+#ifdef USE_X86_SIMD
+    unsigned eax, ebx, ecx, edx;
+
+    if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return level;
+
+    if(edx & bit_SSE2)
+        level = kSIMDLevelSSE2;
+
+    // the os has to save the ymm / zmm state for us to use it
+    if(!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX) || !(ecx & bit_FMA))
+        return level;
+
+    uint64_t xcr0 = readXCR0();
+
+    if((xcr0 & 0x6) != 0x6)
+        return level;
+
+    if(!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+        return level;
+
+    if(ebx & bit_AVX2)
+        level = kSIMDLevelAVX2;
+
+    if((ebx & bit_AVX512F) && (xcr0 & 0xe0) == 0xe0)
+        level = kSIMDLevelAVX512;
+#endif
+
+    return level;
+}
+
+unsigned getSIMDLevel(void)
+{
+    if(g_simd_level == kSIMDLevelCount)
+    {
+        g_simd_level = detectSIMDLevel();
+    }
+
+    return g_simd_level;
+}
+
+bool setSIMDLevel(unsigned level)
+{
+    if(level > detectSIMDLevel())
+        return false;
+
+    g_simd_level = level;
+
+    return true;
+}
+
+unsigned findSIMDLevel(const char *name)
+{
+    for(unsigned i=0; i<kSIMDLevelCount; i++)
+    {
+        if(!strcmp(name, g_simd_level_names[i]))
+            return i;
+    }
+
+    return kSIMDLevelCount;
+}
+
+const char *getSIMDLevelName(unsigned level)
+{
+    if(level >= kSIMDLevelCount)
+        return "unknown";
+
+    return g_simd_level_names[level];
+}
+
+unsigned getSIMDLevelWidth(unsigned level)
+{
+    if(level >= kSIMDLevelCount)
+        return 1;
+
+    return g_simd_level_widths[level];
+}
+
+// rounding of one step against |z|^2 + |c|, a few roundings of 2^-53 each
+#define kStepRounding           0x1p-52
+
+// the error bound stops here, well past any tolerance, so it never reaches inf
+#define kErrorCeiling           1e100
+
+// kKernelErrorCheck at the end of an orbit, err is the rounding bound of z = x + iy
+static inline __attribute__((always_inline)) bool isUnreliable(double err, double x, double y)
+{
+    return err * err > kErrorTolerance * kErrorTolerance * (x * x + y * y);
+}
+
+static void iterateDoubleScalar(const KernelOptions *options, const double *cx, const double *cy, OrbitState *orbits,
+                                unsigned count, unsigned itermax, unsigned *pixels, KernelStats *stats)
+{
+    bool    check_period = options->flags & kKernelPeriodicityCheck;
+    bool    check_error = options->flags & kKernelErrorCheck;
+    double  epsilon = getPeriodicityEpsilon(options);
+    unsigned steps = 0;
+
+    for(unsigned i=0; i<count; i++)
+    {
+        bool        done = false;
+        bool        periodic = false;
+        unsigned    iteration;
+        unsigned    start = orbits ? orbits->iterations[i] : 0;
+        unsigned    window = options->periodicity_interval, window_count = 0;
+        double      x, y, xx;
+        double      saved_x, saved_y;
+        double      err = 0.0;
+
+        if((options->flags & kKernelCardioidCheck) && inCardioidOrBulb(cx[i], cy[i]))
+        {
+            pixels[i] = 0;
+            stats->cardioid_skipped++;
+
+            if(orbits)
+                orbits->iterations[i] = kOrbitFinal;
+
+            continue;
+        }
+
+        if(start)
+        {
+            x = orbits->x[i]; y = orbits->y[i];
+        }
+        else
+        {
+            x = 0.0; y = 0.0;
+        }
+
+        saved_x = x; saved_y = y;
+
+        for (iteration=start+1;!done && !periodic && iteration<itermax;iteration++)
+        {
+            if(isKernelCancelledAt(options, ++steps))
+                return;
+
+            if(check_error)
+            {
+                err = fmin(2.0*sqrt(x*x+y*y)*err + kStepRounding*(x*x+y*y+fabs(cx[i])+fabs(cy[i])), kErrorCeiling);
+            }
+
+            xx = x*x-y*y+cx[i];
+            y = 2.0*x*y+cy[i];
+            x = xx;
+
+            if (x*x+y*y>100.0)
+            {
+                done = true;
+            }
+            else if(check_period)
+            {
+                // Brent, compare against the orbit point saved at the start of
+                // the window and double the window each time it runs out
+                if(fabs(x - saved_x) < epsilon && fabs(y - saved_y) < epsilon)
+                {
+                    periodic = true;
+                    stats->periodic_pixels++;
+                    stats->periodicity_saved += itermax - 1 - iteration;
+                }
+                else if(++window_count == window)
+                {
+                    saved_x = x;
+                    saved_y = y;
+                    window_count = 0;
+                    window *= 2;
+                }
+            }
+        }
+
+        pixels[i] = done ? iteration : 0;
+
+        if(orbits && (done || periodic))
+        {
+            orbits->iterations[i] = kOrbitFinal;
+        }
+        else if(orbits)
+        {
+            orbits->x[i] = x;
+            orbits->y[i] = y;
+            orbits->iterations[i] = iteration - 1;
+        }
+
+        if(check_error && !periodic && isUnreliable(err, x, y))
+        {
+            pixels[i] |= kUnreliablePixel;
+        }
+    }
+}
+
+// Vector lanes are refilled from the point list as soon as they escape, turn
+// out to be periodic or run out of iterations, so a slow pixel never holds up
+// the rest of its vector. A lane with no point left gets c = 0 and a step count
+// of -inf so it never reaches itermax, and live masks it out of the retire test
+// as z = 0 would pass the periodicity check on every step. The loop ends when
+// every lane is empty.
+// Points that pass the cardioid / bulb test are written here and never take a lane.
+//
+// The lane helpers are forced inline, as an out of line call they are compiled
+// without avx and every retire pays an sse / avx transition, halving throughput.
+typedef struct {
+    unsigned        count;
+    unsigned        next;
+    unsigned        active;
+    unsigned        live;           // lanes with a point, bit per lane
+    unsigned        flags;
+    unsigned        itermax;
+    double          interval;
+    const double    *cx, *cy;
+    OrbitState      *orbits;        // NULL to start every point at z = 0
+    unsigned        *pixels;
+    KernelStats     *stats;
+} LaneFeed;
+
+// spilled vector state while lanes are retired and refilled, wn / wl are the
+// steps taken in the current periodicity window and its length, err is only
+// kept up with kKernelErrorCheck
+typedef struct {
+    int     index[8];
+    double  x[8] __attribute__((aligned(64)));
+    double  y[8] __attribute__((aligned(64)));
+    double  cx[8] __attribute__((aligned(64)));
+    double  cy[8] __attribute__((aligned(64)));
+    double  n[8] __attribute__((aligned(64)));
+    double  sx[8] __attribute__((aligned(64)));
+    double  sy[8] __attribute__((aligned(64)));
+    double  wn[8] __attribute__((aligned(64)));
+    double  wl[8] __attribute__((aligned(64)));
+    double  err[8] __attribute__((aligned(64)));
+} LaneState;
+
+static inline __attribute__((always_inline)) void refillLane(LaneFeed *feed, LaneState *lanes, int lane)
+{
+    lanes->x[lane]  = 0.0;
+    lanes->y[lane]  = 0.0;
+    lanes->sx[lane] = 0.0;
+    lanes->sy[lane] = 0.0;
+    lanes->wn[lane] = 0.0;
+    lanes->wl[lane] = feed->interval;
+    lanes->err[lane] = 0.0;
+
+    while(feed->next < feed->count)
+    {
+        unsigned i = feed->next++;
+
+        if((feed->flags & kKernelCardioidCheck) && inCardioidOrBulb(feed->cx[i], feed->cy[i]))
+        {
+            feed->pixels[i] = 0;
+            feed->stats->cardioid_skipped++;
+
+            if(feed->orbits)
+                feed->orbits->iterations[i] = kOrbitFinal;
+
+            continue;
+        }
+
+        unsigned start = feed->orbits ? feed->orbits->iterations[i] : 0;
+
+        // a lane always takes a step, one with none left stays as it is
+        if(start && start >= feed->itermax - 1)
+        {
+            feed->pixels[i] = 0;
+            continue;
+        }
+
+        if(lanes->index[lane] < 0)
+        {
+            feed->active++;
+        }
+
+        lanes->index[lane] = i;
+        lanes->cx[lane] = feed->cx[i];
+        lanes->cy[lane] = feed->cy[i];
+        lanes->n[lane]  = start;
+        feed->live      |= 1 << lane;
+
+        if(start)
+        {
+            lanes->x[lane]  = feed->orbits->x[i];
+            lanes->y[lane]  = feed->orbits->y[i];
+            lanes->sx[lane] = lanes->x[lane];
+            lanes->sy[lane] = lanes->y[lane];
+        }
+
+        return;
+    }
+
+    if(lanes->index[lane] >= 0)
+    {
+        feed->active--;
+    }
+
+    lanes->index[lane] = -1;
+    lanes->cx[lane] = 0.0;
+    lanes->cy[lane] = 0.0;
+    lanes->n[lane]  = -INFINITY;
+    feed->live      &= ~(1 << lane);
+}
+
+// writes back the lanes set in mask and refills them, n is the step count
+// so a lane that escaped on step n gets n + 1 like the scalar loop
+static inline __attribute__((always_inline)) void retireLanes(LaneFeed *feed, LaneState *lanes, unsigned mask,
+                                                              unsigned escaped, unsigned periodic)
+{
+    while(mask)
+    {
+        int lane = __builtin_ctz(mask);
+        int index = lanes->index[lane];
+
+        mask &= mask - 1;
+
+        if(index >= 0)
+        {
+            if(escaped & (1 << lane))
+            {
+                feed->pixels[index] = (unsigned)lanes->n[lane] + 1;
+            }
+            else
+            {
+                feed->pixels[index] = 0;
+
+                if(periodic & (1 << lane))
+                {
+                    feed->stats->periodic_pixels++;
+                    feed->stats->periodicity_saved += feed->itermax - 1 - (unsigned)lanes->n[lane];
+                }
+            }
+
+            if(feed->orbits && ((escaped | periodic) & (1 << lane)))
+            {
+                feed->orbits->iterations[index] = kOrbitFinal;
+            }
+            else if(feed->orbits)
+            {
+                // ran out of iterations, n is itermax - 1
+                feed->orbits->x[index] = lanes->x[lane];
+                feed->orbits->y[index] = lanes->y[lane];
+                feed->orbits->iterations[index] = (unsigned)lanes->n[lane];
+            }
+
+            if((feed->flags & kKernelErrorCheck) && !(periodic & (1 << lane)) &&
+               isUnreliable(lanes->err[lane], lanes->x[lane], lanes->y[lane]))
+            {
+                feed->pixels[index] |= kUnreliablePixel;
+            }
+        }
+
+        refillLane(feed, lanes, lane);
+    }
+}
+
+static void initLanes(LaneFeed *feed, LaneState *lanes, int count)
+{
+    feed->active = 0;
+    feed->live = 0;
+
+    for(int lane=0; lane<count; lane++)
+    {
+        lanes->index[lane] = -1;
+        refillLane(feed, lanes, lane);
+    }
+}
+
+static void initLaneFeed(LaneFeed *feed, const KernelOptions *options, const double *cx, const double *cy,
+                         OrbitState *orbits, unsigned count, unsigned itermax, unsigned *pixels, KernelStats *stats)
+{
+    feed->count     = count;
+    feed->next      = 0;
+    feed->active    = 0;
+    feed->live      = 0;
+    feed->flags     = options->flags;
+    feed->itermax   = itermax;
+    feed->interval  = options->periodicity_interval;
+    feed->cx        = cx;
+    feed->cy        = cy;
+    feed->orbits    = orbits;
+    feed->pixels    = pixels;
+    feed->stats     = stats;
+}
+
+#ifdef USE_X86_SIMD
+__attribute__((target("sse2")))
+static void iterateDoubleSSE2(const KernelOptions *options, const double *cx, const double *cy, OrbitState *orbits,
+                               unsigned count, unsigned itermax, unsigned *pixels, KernelStats *stats)
+{
+    LaneFeed    feed;
+    LaneState   lanes;
+    unsigned    steps = 0;
+    bool        check_period = options->flags & kKernelPeriodicityCheck;
+
+    initLaneFeed(&feed, options, cx, cy, orbits, count, itermax, pixels, stats);
+    initLanes(&feed, &lanes, 2);
+
+    __m128d x       = _mm_load_pd(lanes.x);
+    __m128d y       = _mm_load_pd(lanes.y);
+    __m128d vcx     = _mm_load_pd(lanes.cx);
+    __m128d vcy     = _mm_load_pd(lanes.cy);
+    __m128d n       = _mm_load_pd(lanes.n);
+    __m128d sx      = _mm_load_pd(lanes.sx);
+    __m128d sy      = _mm_load_pd(lanes.sy);
+    __m128d wn      = _mm_load_pd(lanes.wn);
+    __m128d wl      = _mm_load_pd(lanes.wl);
+    __m128d one     = _mm_set1_pd(1.0);
+    __m128d bailout = _mm_set1_pd(100.0);
+    __m128d limit   = _mm_set1_pd((double)itermax - 1.0);
+    __m128d epsilon = _mm_set1_pd(getPeriodicityEpsilon(options));
+    __m128d abs     = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL));
+
+    while(feed.active)
+    {
+        if(isKernelCancelledAt(options, ++steps))
+            return;
+
+        // xx = x*x-y*y+cx; y = 2.0*x*y+cy; x = xx;
+        __m128d xy  = _mm_mul_pd(x, y);
+        __m128d xx  = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(x, x), _mm_mul_pd(y, y)), vcx);
+
+        y = _mm_add_pd(_mm_add_pd(xy, xy), vcy);
+        x = xx;
+        n = _mm_add_pd(n, one);
+
+        __m128d mag     = _mm_add_pd(_mm_mul_pd(x, x), _mm_mul_pd(y, y));
+        __m128d escaped = _mm_cmpgt_pd(mag, bailout);
+        __m128d maxed   = _mm_cmpge_pd(n, limit);
+        __m128d periodic = _mm_setzero_pd();
+
+        if(check_period)
+        {
+            __m128d dx = _mm_and_pd(_mm_sub_pd(x, sx), abs);
+            __m128d dy = _mm_and_pd(_mm_sub_pd(y, sy), abs);
+
+            periodic = _mm_and_pd(_mm_cmplt_pd(dx, epsilon), _mm_cmplt_pd(dy, epsilon));
+
+            wn = _mm_add_pd(wn, one);
+
+            __m128d save = _mm_cmpge_pd(wn, wl);
+
+            sx = _mm_or_pd(_mm_and_pd(save, x), _mm_andnot_pd(save, sx));
+            sy = _mm_or_pd(_mm_and_pd(save, y), _mm_andnot_pd(save, sy));
+            wl = _mm_add_pd(wl, _mm_and_pd(save, wl));
+            wn = _mm_andnot_pd(save, wn);
+        }
+
+        unsigned mask = _mm_movemask_pd(_mm_or_pd(_mm_or_pd(escaped, maxed), periodic)) & feed.live;
+
+        if(mask)
+        {
+            _mm_store_pd(lanes.x, x); _mm_store_pd(lanes.y, y);
+            _mm_store_pd(lanes.cx, vcx); _mm_store_pd(lanes.cy, vcy);
+            _mm_store_pd(lanes.n, n);
+            _mm_store_pd(lanes.sx, sx); _mm_store_pd(lanes.sy, sy);
+            _mm_store_pd(lanes.wn, wn); _mm_store_pd(lanes.wl, wl);
+
+            retireLanes(&feed, &lanes, mask, _mm_movemask_pd(escaped), _mm_movemask_pd(periodic));
+
+            x = _mm_load_pd(lanes.x); y = _mm_load_pd(lanes.y);
+            vcx = _mm_load_pd(lanes.cx); vcy = _mm_load_pd(lanes.cy);
+            n = _mm_load_pd(lanes.n);
+            sx = _mm_load_pd(lanes.sx); sy = _mm_load_pd(lanes.sy);
+            wn = _mm_load_pd(lanes.wn); wl = _mm_load_pd(lanes.wl);
+        }
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void iterateDoubleAVX2(const KernelOptions *options, const double *cx, const double *cy, OrbitState *orbits,
+                               unsigned count, unsigned itermax, unsigned *pixels, KernelStats *stats)
+{
+    LaneFeed    feed;
+    LaneState   lanes;
+    unsigned    steps = 0;
+    bool        check_period = options->flags & kKernelPeriodicityCheck;
+    bool        check_error = options->flags & kKernelErrorCheck;
+
+    initLaneFeed(&feed, options, cx, cy, orbits, count, itermax, pixels, stats);
+    initLanes(&feed, &lanes, 4);
+
+    __m256d x       = _mm256_load_pd(lanes.x);
+    __m256d y       = _mm256_load_pd(lanes.y);
+    __m256d vcx     = _mm256_load_pd(lanes.cx);
+    __m256d vcy     = _mm256_load_pd(lanes.cy);
+    __m256d n       = _mm256_load_pd(lanes.n);
+    __m256d sx      = _mm256_load_pd(lanes.sx);
+    __m256d sy      = _mm256_load_pd(lanes.sy);
+    __m256d wn      = _mm256_load_pd(lanes.wn);
+    __m256d wl      = _mm256_load_pd(lanes.wl);
+    __m256d err     = _mm256_load_pd(lanes.err);
+    __m256d one     = _mm256_set1_pd(1.0);
+    __m256d bailout = _mm256_set1_pd(100.0);
+    __m256d limit   = _mm256_set1_pd((double)itermax - 1.0);
+    __m256d epsilon = _mm256_set1_pd(getPeriodicityEpsilon(options));
+    __m256d rounding = _mm256_set1_pd(kStepRounding);
+    __m256d ceiling = _mm256_set1_pd(kErrorCeiling);
+    __m256d abs     = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+
+    while(feed.active)
+    {
+        if(isKernelCancelledAt(options, ++steps))
+            return;
+
+        if(check_error)
+        {
+            // as in iterateDoubleScalar, from z before the step
+            __m256d zz      = _mm256_fmadd_pd(x, x, _mm256_mul_pd(y, y));
+            __m256d cabs    = _mm256_add_pd(_mm256_and_pd(vcx, abs), _mm256_and_pd(vcy, abs));
+            __m256d zabs    = _mm256_sqrt_pd(zz);
+
+            err = _mm256_fmadd_pd(_mm256_add_pd(zabs, zabs), err, _mm256_mul_pd(rounding, _mm256_add_pd(zz, cabs)));
+            err = _mm256_min_pd(err, ceiling);
+        }
+
+        // xx = x*x-y*y+cx; y = 2.0*x*y+cy; x = xx;
+        __m256d x2  = _mm256_add_pd(x, x);
+        __m256d xx  = _mm256_fmadd_pd(x, x, _mm256_fnmadd_pd(y, y, vcx));
+
+        y = _mm256_fmadd_pd(x2, y, vcy);
+        x = xx;
+        n = _mm256_add_pd(n, one);
+
+        __m256d mag     = _mm256_fmadd_pd(x, x, _mm256_mul_pd(y, y));
+        __m256d escaped = _mm256_cmp_pd(mag, bailout, _CMP_GT_OQ);
+        __m256d maxed   = _mm256_cmp_pd(n, limit, _CMP_GE_OQ);
+        __m256d periodic = _mm256_setzero_pd();
+
+        if(check_period)
+        {
+            __m256d dx = _mm256_and_pd(_mm256_sub_pd(x, sx), abs);
+            __m256d dy = _mm256_and_pd(_mm256_sub_pd(y, sy), abs);
+
+            periodic = _mm256_and_pd(_mm256_cmp_pd(dx, epsilon, _CMP_LT_OQ), _mm256_cmp_pd(dy, epsilon, _CMP_LT_OQ));
+
+            wn = _mm256_add_pd(wn, one);
+
+            __m256d save = _mm256_cmp_pd(wn, wl, _CMP_GE_OQ);
+
+            sx = _mm256_blendv_pd(sx, x, save);
+            sy = _mm256_blendv_pd(sy, y, save);
+            wl = _mm256_add_pd(wl, _mm256_and_pd(save, wl));
+            wn = _mm256_andnot_pd(save, wn);
+        }
+
+        unsigned mask = _mm256_movemask_pd(_mm256_or_pd(_mm256_or_pd(escaped, maxed), periodic)) & feed.live;
+
+        if(mask)
+        {
+            _mm256_store_pd(lanes.x, x); _mm256_store_pd(lanes.y, y);
+            _mm256_store_pd(lanes.cx, vcx); _mm256_store_pd(lanes.cy, vcy);
+            _mm256_store_pd(lanes.n, n);
+            _mm256_store_pd(lanes.sx, sx); _mm256_store_pd(lanes.sy, sy);
+            _mm256_store_pd(lanes.wn, wn); _mm256_store_pd(lanes.wl, wl);
+            _mm256_store_pd(lanes.err, err);
+
+            retireLanes(&feed, &lanes, mask, _mm256_movemask_pd(escaped), _mm256_movemask_pd(periodic));
+
+            x = _mm256_load_pd(lanes.x); y = _mm256_load_pd(lanes.y);
+            vcx = _mm256_load_pd(lanes.cx); vcy = _mm256_load_pd(lanes.cy);
+            n = _mm256_load_pd(lanes.n);
+            sx = _mm256_load_pd(lanes.sx); sy = _mm256_load_pd(lanes.sy);
+            wn = _mm256_load_pd(lanes.wn); wl = _mm256_load_pd(lanes.wl);
+            err = _mm256_load_pd(lanes.err);
+        }
+    }
+}
+
+__attribute__((target("avx512f")))
+static void iterateDoubleAVX512(const KernelOptions *options, const double *cx, const double *cy, OrbitState *orbits,
+                                 unsigned count, unsigned itermax, unsigned *pixels, KernelStats *stats)
+{
+    LaneFeed    feed;
+    LaneState   lanes;
+    unsigned    steps = 0;
+    bool        check_period = options->flags & kKernelPeriodicityCheck;
+    bool        check_error = options->flags & kKernelErrorCheck;
+
+    initLaneFeed(&feed, options, cx, cy, orbits, count, itermax, pixels, stats);
+    initLanes(&feed, &lanes, 8);
+
+    __m512d x       = _mm512_load_pd(lanes.x);
+    __m512d y       = _mm512_load_pd(lanes.y);
+    __m512d vcx     = _mm512_load_pd(lanes.cx);
+    __m512d vcy     = _mm512_load_pd(lanes.cy);
+    __m512d n       = _mm512_load_pd(lanes.n);
+    __m512d sx      = _mm512_load_pd(lanes.sx);
+    __m512d sy      = _mm512_load_pd(lanes.sy);
+    __m512d wn      = _mm512_load_pd(lanes.wn);
+    __m512d wl      = _mm512_load_pd(lanes.wl);
+    __m512d err     = _mm512_load_pd(lanes.err);
+    __m512d one     = _mm512_set1_pd(1.0);
+    __m512d bailout = _mm512_set1_pd(100.0);
+    __m512d limit   = _mm512_set1_pd((double)itermax - 1.0);
+    __m512d epsilon = _mm512_set1_pd(getPeriodicityEpsilon(options));
+    __m512d rounding = _mm512_set1_pd(kStepRounding);
+    __m512d ceiling = _mm512_set1_pd(kErrorCeiling);
+
+    while(feed.active)
+    {
+        if(isKernelCancelledAt(options, ++steps))
+            return;
+
+        if(check_error)
+        {
+            // as in iterateDoubleScalar, from z before the step
+            __m512d zz      = _mm512_fmadd_pd(x, x, _mm512_mul_pd(y, y));
+            __m512d cabs    = _mm512_add_pd(_mm512_abs_pd(vcx), _mm512_abs_pd(vcy));
+            __m512d zabs    = _mm512_sqrt_pd(zz);
+
+            err = _mm512_fmadd_pd(_mm512_add_pd(zabs, zabs), err, _mm512_mul_pd(rounding, _mm512_add_pd(zz, cabs)));
+            err = _mm512_min_pd(err, ceiling);
+        }
+
+        // xx = x*x-y*y+cx; y = 2.0*x*y+cy; x = xx;
+        __m512d x2  = _mm512_add_pd(x, x);
+        __m512d xx  = _mm512_fmadd_pd(x, x, _mm512_fnmadd_pd(y, y, vcx));
+
+        y = _mm512_fmadd_pd(x2, y, vcy);
+        x = xx;
+        n = _mm512_add_pd(n, one);
+
+        __m512d     mag      = _mm512_fmadd_pd(x, x, _mm512_mul_pd(y, y));
+        __mmask8    escaped  = _mm512_cmp_pd_mask(mag, bailout, _CMP_GT_OQ);
+        __mmask8    maxed    = _mm512_cmp_pd_mask(n, limit, _CMP_GE_OQ);
+        __mmask8    periodic = 0;
+
+        if(check_period)
+        {
+            __m512d dx = _mm512_abs_pd(_mm512_sub_pd(x, sx));
+            __m512d dy = _mm512_abs_pd(_mm512_sub_pd(y, sy));
+
+            periodic = _mm512_cmp_pd_mask(dx, epsilon, _CMP_LT_OQ) & _mm512_cmp_pd_mask(dy, epsilon, _CMP_LT_OQ);
+
+            wn = _mm512_add_pd(wn, one);
+
+            __mmask8 save = _mm512_cmp_pd_mask(wn, wl, _CMP_GE_OQ);
+
+            sx = _mm512_mask_blend_pd(save, sx, x);
+            sy = _mm512_mask_blend_pd(save, sy, y);
+            wl = _mm512_mask_add_pd(wl, save, wl, wl);
+            wn = _mm512_mask_blend_pd(save, wn, _mm512_setzero_pd());
+        }
+
+        unsigned mask = (escaped | maxed | periodic) & feed.live;
+
+        if(mask)
+        {
+            _mm512_store_pd(lanes.x, x); _mm512_store_pd(lanes.y, y);
+            _mm512_store_pd(lanes.cx, vcx); _mm512_store_pd(lanes.cy, vcy);
+            _mm512_store_pd(lanes.n, n);
+            _mm512_store_pd(lanes.sx, sx); _mm512_store_pd(lanes.sy, sy);
+            _mm512_store_pd(lanes.wn, wn); _mm512_store_pd(lanes.wl, wl);
+            _mm512_store_pd(lanes.err, err);
+
+            retireLanes(&feed, &lanes, mask, escaped, periodic);
+
+            x = _mm512_load_pd(lanes.x); y = _mm512_load_pd(lanes.y);
+            vcx = _mm512_load_pd(lanes.cx); vcy = _mm512_load_pd(lanes.cy);
+            n = _mm512_load_pd(lanes.n);
+            sx = _mm512_load_pd(lanes.sx); sy = _mm512_load_pd(lanes.sy);
+            wn = _mm512_load_pd(lanes.wn); wl = _mm512_load_pd(lanes.wl);
+            err = _mm512_load_pd(lanes.err);
+        }
+    }
+}
+#endif // #ifdef USE_X86_SIMD
+
+void iterateDoubleLevel(unsigned level, const KernelOptions *options, const double *cx, const double *cy,
+                        OrbitState *orbits, unsigned count, unsigned itermax, unsigned *pixels, KernelStats *stats)
+{
+    // the vector loops count steps, so they need at least one to take
+    if(itermax < 2)
+    {
+        level = kSIMDLevelScalar;
+    }
+
+    // the sse2 loop leaves the error check to the scalar one
+    if((options->flags & kKernelErrorCheck) && level == kSIMDLevelSSE2)
+    {
+        level = kSIMDLevelScalar;
+    }
+
+    switch(level)
+    {
+#ifdef USE_X86_SIMD
+        case kSIMDLevelAVX512:
+            iterateDoubleAVX512(options, cx, cy, orbits, count, itermax, pixels, stats);
+            break;
+
+        case kSIMDLevelAVX2:
+            iterateDoubleAVX2(options, cx, cy, orbits, count, itermax, pixels, stats);
+            break;
+
+        case kSIMDLevelSSE2:
+            iterateDoubleSSE2(options, cx, cy, orbits, count, itermax, pixels, stats);
+            break;
+#endif
+        default:
+            iterateDoubleScalar(options, cx, cy, orbits, count, itermax, pixels, stats);
+            break;
+    }
+}
+
+void iterateDouble(const KernelOptions *options, const double *cx, const double *cy, unsigned count,
+                   unsigned itermax, unsigned *pixels, KernelStats *stats)
+{
+    iterateDoubleLevel(getSIMDLevel(), options, cx, cy, NULL, count, itermax, pixels, stats);
+}
+
+void iterateDoubleOrbits(const KernelOptions *options, const double *cx, const double *cy, OrbitState *orbits,
+                         unsigned count, unsigned itermax, unsigned *pixels, KernelStats *stats)
+{
+    iterateDoubleLevel(getSIMDLevel(), options, cx, cy, orbits, count, itermax, pixels, stats);
+}
+
+void benchmarkSIMDKernels(void)
+{
+    // default view, center_x=-0.7 zoom 1, mostly interior so the loop dominates
+    const unsigned  xres = 512, yres = 512;
+    const unsigned  itermax = 1024;
+    const unsigned  count = xres * yres;
+    double          *cx = new double [count];
+    double          *cy = new double [count];
+    unsigned        *reference = new unsigned [count];
+    unsigned        *pixels = new unsigned [count];
+    double          scalar_rate = 0.0;
+    double          raw_elapsed = 0.0;
+    KernelOptions   options;
+    KernelStats     stats;
+    static const struct {
+        const char  *name;
+        unsigned    flags;
+    } checks[] = {
+        { "cardioid / bulb test",   kKernelCardioidCheck },
+        { "periodicity check",      kKernelPeriodicityCheck },
+        { "both",                   kKernelCardioidCheck | kKernelPeriodicityCheck },
+    };
+
+    options.flags                   = 0;
+    options.periodicity_tolerance   = kDefaultPeriodicityTolerance;
+    options.periodicity_interval    = kDefaultPeriodicityInterval;
+    options.cancel_generation       = NULL;
+    options.generation              = 0;
+    options.pixel_spacing           = 3.0 / xres;
+
+    for(unsigned hy=0; hy<yres; hy++)
+    {
+        for(unsigned hx=0; hx<xres; hx++)
+        {
+            cx[hy * xres + hx] = -0.7 + 3.0*((double)hx/xres-0.5);
+            cy[hy * xres + hx] =  0.0 + 3.0*((double)hy/yres-0.5);
+        }
+    }
+
+    printf("SIMD kernel benchmark %ux%u itermax %u, detected %s\n", xres, yres, itermax, getSIMDLevelName(detectSIMDLevel()));
+
+    for(unsigned level=kSIMDLevelScalar; level<=detectSIMDLevel(); level++)
+    {
+        unsigned *dst = (level == kSIMDLevelScalar) ? reference : pixels;
+        double start = getSeconds();
+
+        memset(&stats, 0, sizeof(stats));
+
+        // raw loop throughput, the interior tests would skip most of the work
+        options.flags = 0;
+        iterateDoubleLevel(level, &options, cx, cy, NULL, count, itermax, dst, &stats);
+
+        double elapsed = getSeconds() - start;
+        double iterations = 0.0;
+        unsigned mismatches = 0;
+
+        for(unsigned i=0; i<count; i++)
+        {
+            iterations += dst[i] ? dst[i] - 1 : itermax - 1;
+
+            if(dst[i] != reference[i])
+                mismatches++;
+        }
+
+        double rate = iterations / elapsed * 1e-6;
+
+        if(level == kSIMDLevelScalar)
+            scalar_rate = rate;
+
+        if(level == getSIMDLevel())
+            raw_elapsed = elapsed;
+
+        printf("    %-8s %2u lanes %10.1f Mpixel-iterations/s  %5.2fx scalar  %u pixels differ\n",
+               getSIMDLevelName(level), getSIMDLevelWidth(level), rate, rate / scalar_rate, mismatches);
+    }
+
+    for(unsigned i=0; i<sizeof(checks)/sizeof(*checks); i++)
+    {
+        double start = getSeconds();
+
+        memset(&stats, 0, sizeof(stats));
+        options.flags = checks[i].flags;
+        iterateDouble(&options, cx, cy, count, itermax, pixels, &stats);
+
+        double elapsed = getSeconds() - start;
+        unsigned mismatches = 0;
+
+        for(unsigned j=0; j<count; j++)
+        {
+            if(pixels[j] != reference[j])
+                mismatches++;
+        }
+
+        printf("    %-8s %-22s %.3fs vs %.3fs, %llu pixels skipped, %llu periodic saving %llu iterations, %u pixels differ\n",
+               getSIMDLevelName(getSIMDLevel()), checks[i].name, elapsed, raw_elapsed,
+               stats.cardioid_skipped, stats.periodic_pixels, stats.periodicity_saved, mismatches);
+    }
+
+    delete [] cx;
+    delete [] cy;
+    delete [] reference;
+    delete [] pixels;
+}
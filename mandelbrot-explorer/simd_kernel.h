@@ -0,0 +1,66 @@
+//
+//  simd_kernel.h
+//  mandelbrot-explorer
+//
+//  Copyright (c) 2014 Sandstorm Software. All rights reserved.
+//
+
+#ifndef mandelbrot_explorer_simd_kernel_h
+#define mandelbrot_explorer_simd_kernel_h
+
+#include "mandelbrot.h"
+
+enum {
+    kSIMDLevelScalar,
+    kSIMDLevelSSE2,
+    kSIMDLevelAVX2,
+    kSIMDLevelAVX512,
+    kSIMDLevelCount
+};
+
+// best level the cpu and os support, found with cpuid / xgetbv
+unsigned    detectSIMDLevel(void);
+
+// level used by iterateDouble, defaults to detectSIMDLevel()
+unsigned    getSIMDLevel(void);
+bool        setSIMDLevel(unsigned level);
+unsigned    findSIMDLevel(const char *name);
+
+const char  *getSIMDLevelName(unsigned level);
+unsigned    getSIMDLevelWidth(unsigned level);
+
+// With kKernelErrorCheck every lane also carries a bound on the rounding error
+// of z, which grows by 2|z| a step and picks up each step's own rounding. The
+// escape step is only certain while the error is a small part of |z|, past
+// kErrorTolerance of it at the end the value gets kUnreliablePixel. The bound
+// is the worst case, so the tolerance is loose, chaotic orbits still blow it.
+#define kUnreliablePixel        0x40000000
+#define kErrorTolerance         0.1
+
+// Orbits to carry on, parallel to cx / cy: z = (x[i], y[i]) after iterations[i]
+// steps, 0 steps for z = 0. A point that runs out of iterations is left with
+// where it stopped, itermax - 1 steps, and every other point gets kOrbitFinal,
+// so a higher itermax only has to run the ones still going. The periodicity
+// window starts over where an orbit picks up. Not with kKernelErrorCheck, the
+// error bound is not kept.
+#define kOrbitFinal             0xffffffff
+
+typedef struct {
+    double      *x, *y;
+    unsigned    *iterations;
+} OrbitState;
+
+// iterates c = (cx[i], cy[i]) for count points and writes the same value the
+// scalar loop in calcThread does, escape iteration or 0 if it never escaped
+void        iterateDouble(const KernelOptions *options, const double *cx, const double *cy, unsigned count,
+                          unsigned itermax, unsigned *pixels, KernelStats *stats);
+// the same from and into orbits, NULL for z = 0
+void        iterateDoubleOrbits(const KernelOptions *options, const double *cx, const double *cy, OrbitState *orbits,
+                                unsigned count, unsigned itermax, unsigned *pixels, KernelStats *stats);
+void        iterateDoubleLevel(unsigned level, const KernelOptions *options, const double *cx, const double *cy,
+                               OrbitState *orbits, unsigned count, unsigned itermax, unsigned *pixels, KernelStats *stats);
+
+// times every supported level against the scalar loop and prints Mpixel-iterations/s
+void        benchmarkSIMDKernels(void);
+
+#endif
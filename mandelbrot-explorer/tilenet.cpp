@@ -0,0 +1,285 @@
+//
+//  tilenet.cpp
+//  mandelbrot-explorer
+//
+//  Copyright (c) 2014 Sandstorm Software. All rights reserved.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "tilenet.h"
+
+// host and port of "host:port", an empty host for ":port"
+static bool splitAddress(const char *address, std::string *host, std::string *port)
+{
+    const char *colon = strrchr(address, ':');
+
+    if(!colon || !colon[1])
+        return false;
+
+    host->assign(address, colon - address);
+    port->assign(colon + 1);
+
+    return true;
+}
+
+static int openUnixSocket(const char *path, bool listening)
+{
+    struct sockaddr_un  addr;
+    int                 fd;
+
+    if(strlen(path) >= sizeof(addr.sun_path))
+    {
+        printf("Socket path %s is too long\n", path);
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if(fd < 0)
+        return -1;
+
+    if(listening)
+    {
+        // a worker that was killed leaves its socket behind
+        unlink(path);
+
+        if(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0 && listen(fd, 16) == 0)
+            return fd;
+    }
+    else if(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+    {
+        return fd;
+    }
+
+    close(fd);
+
+    return -1;
+}
+
+static int openTCPSocket(const char *address, bool listening)
+{
+    struct addrinfo hints, *list = NULL;
+    std::string     host, port;
+    int             fd = -1;
+
+    if(!splitAddress(address, &host, &port))
+    {
+        printf("Address %s is not host:port or a socket path\n", address);
+        return -1;
+    }
+
+    // no AI_PASSIVE, an empty host is loopback for a worker as well, see tilenet.h
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    int error = getaddrinfo(host.empty() ? NULL : host.c_str(), port.c_str(), &hints, &list);
+
+    if(error)
+    {
+        printf("Address %s: %s\n", address, gai_strerror(error));
+        return -1;
+    }
+
+    for(struct addrinfo *ai = list; ai; ai = ai->ai_next)
+    {
+        int one = 1;
+
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+
+        if(fd < 0)
+            continue;
+
+        // jobs and results are small and answered one by one, Nagle would hold them back
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        if(listening)
+        {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+            if(bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, 16) == 0)
+                break;
+        }
+        else if(connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+        {
+            break;
+        }
+
+        close(fd);
+        fd = -1;
+    }
+
+    freeaddrinfo(list);
+
+    return fd;
+}
+
+int listenTileSocket(const char *address)
+{
+    // a coordinator that goes away mid result is an error on the write, not a signal
+    signal(SIGPIPE, SIG_IGN);
+
+    return strchr(address, '/') ? openUnixSocket(address, true) : openTCPSocket(address, true);
+}
+
+int connectTileSocket(const char *address)
+{
+    signal(SIGPIPE, SIG_IGN);
+
+    return strchr(address, '/') ? openUnixSocket(address, false) : openTCPSocket(address, false);
+}
+
+void closeTileSocket(int fd)
+{
+    if(fd >= 0)
+        close(fd);
+}
+
+static bool sendAll(int fd, const void *data, size_t size)
+{
+    const char *p = (const char *)data;
+
+    while(size)
+    {
+        ssize_t n = send(fd, p, size, 0);
+
+        if(n < 0 && errno == EINTR)
+            continue;
+
+        if(n <= 0)
+            return false;
+
+        p    += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+static bool recvAll(int fd, void *data, size_t size)
+{
+    char *p = (char *)data;
+
+    while(size)
+    {
+        ssize_t n = recv(fd, p, size, 0);
+
+        if(n < 0 && errno == EINTR)
+            continue;
+
+        // 0 is the peer hanging up
+        if(n <= 0)
+            return false;
+
+        p    += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+bool sendTileJob(int fd, const TileJob *job, const std::string &center_x, const std::string &center_y)
+{
+    TileJob header = *job;
+
+    header.magic            = kTileJobMagic;
+    header.center_x_length  = (uint32_t)center_x.size();
+    header.center_y_length  = (uint32_t)center_y.size();
+
+    return sendAll(fd, &header, sizeof(header)) &&
+           sendAll(fd, center_x.data(), center_x.size()) &&
+           sendAll(fd, center_y.data(), center_y.size());
+}
+
+bool recvTileJob(int fd, TileJob *job, std::string *center_x, std::string *center_y)
+{
+    if(!recvAll(fd, job, sizeof(*job)))
+        return false;
+
+    if(job->magic != kTileJobMagic)
+    {
+        printf("Tile job with magic %08x, not %08x\n", job->magic, kTileJobMagic);
+        return false;
+    }
+
+    if(job->center_x_length > kMaxWireCenterLength || job->center_y_length > kMaxWireCenterLength)
+        return false;
+
+    center_x->resize(job->center_x_length);
+    center_y->resize(job->center_y_length);
+
+    return recvAll(fd, &(*center_x)[0], center_x->size()) && recvAll(fd, &(*center_y)[0], center_y->size());
+}
+
+bool sendTileResult(int fd, const TileResult *result, const unsigned *pixels)
+{
+    TileResult header = *result;
+
+    header.magic = kTileResultMagic;
+
+    if(header.status != kTileStatusOK)
+        header.pixels = 0;
+
+    return sendAll(fd, &header, sizeof(header)) && sendAll(fd, pixels, header.pixels * sizeof(unsigned));
+}
+
+bool recvTileResult(int fd, TileResult *result, unsigned *pixels, unsigned capacity)
+{
+    if(!recvAll(fd, result, sizeof(*result)))
+        return false;
+
+    if(result->magic != kTileResultMagic || result->pixels > capacity)
+        return false;
+
+    return recvAll(fd, pixels, result->pixels * sizeof(unsigned));
+}
+
+// every bit of the mpf, in hex so nothing is lost to a decimal round trip
+void getWireCenter(std::string *dst, mpf_srcptr center)
+{
+    mp_exp_t    exponent;
+    char        *digits = mpf_get_str(NULL, &exponent, 16, 0, center);
+    char        buffer[32];
+    const char  *mantissa = digits;
+
+    dst->clear();
+
+    if(*mantissa == '-')
+    {
+        dst->push_back('-');
+        mantissa++;
+    }
+
+    snprintf(buffer, sizeof(buffer), "@%ld", (long)exponent);
+
+    dst->append("0.");
+    dst->append(*mantissa ? mantissa : "0");
+    dst->append(buffer);
+
+    void (*free_func)(void *, size_t);
+
+    mp_get_memory_functions(NULL, NULL, &free_func);
+    free_func(digits, strlen(digits) + 1);
+}
+
+bool setWireCenter(mpf_ptr dst, const std::string &src)
+{
+    // base -16, a hex mantissa and a decimal exponent
+    return mpf_set_str(dst, src.c_str(), -16) == 0;
+}
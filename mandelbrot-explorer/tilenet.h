@@ -0,0 +1,84 @@
+//
+//  tilenet.h
+//  mandelbrot-explorer
+//
+//  Copyright (c) 2014 Sandstorm Software. All rights reserved.
+//
+
+#ifndef mandelbrot_explorer_tilenet_h
+#define mandelbrot_explorer_tilenet_h
+
+#include <stdint.h>
+#include <string>
+
+#include "gmp.h"
+#include "mandelbrot.h"
+
+// Tiles rendered by other processes. A coordinator connects to a worker and
+// sends it jobs, the worker answers every job with a result on the same
+// connection and in the same order, so a coordinator can keep a few in flight.
+//
+// job      TileJob, then center_x_length and center_y_length bytes of the view
+//          center as mantissa and exponent in hex, "-0.1b7f@-3" (see
+//          getWireCenter), no terminators
+// result   TileResult, then the iteration counts of the tile row by row as
+//          uint32s, none if status is not kTileStatusOK
+//
+// Fields are in the sender's byte order, a worker on the other order sees the
+// wrong magic and hangs up. Addresses are "host:port", ":port" for loopback
+// only, or a path with a '/' in it for a unix socket. There is no
+// authentication, a worker takes jobs from whoever reaches it, so it listens
+// on every interface only when asked to with "0.0.0.0:port".
+#define kTileJobMagic           0x4d424a33      // "MBJ3"
+#define kTileResultMagic        0x4d425232      // "MBR2"
+#define kTileStatusOK           0
+#define kTileStatusBadJob       1               // a mode or size the worker does not render
+#define kMaxWireCenterLength    65536           // hex digits, far past any zoom the renderers reach
+
+// the coordinator's options that change the pixels, a worker's own -no-* flags do not apply to jobs
+#define kTileJobSubdivision     0x1
+#define kTileJobBLA             0x2
+#define kTileJobGlitchCorrection 0x4     // within the job, its pixels can differ from a local frame's
+#define kTileJobEscalation      0x8
+
+typedef struct {
+    uint32_t    magic;
+    uint32_t    id;                 // the coordinator's, echoed in the result
+    uint32_t    mode;               // a cpu kRenderMode of the same build, not OpenCL, hybrid or auto
+    uint32_t    options;            // kTileJob*
+    uint32_t    xres, yres;         // the whole frame
+    uint32_t    itermax;
+    uint32_t    precision;          // mpf bits of the center
+    uint32_t    x0, y0, x1, y1;     // the tile in the frame, inclusive
+    uint32_t    center_x_length;
+    uint32_t    center_y_length;
+    FloatExp    zoom;               // m and e, 4 bytes of padding after e
+    double      bla_epsilon;
+    double      periodicity_tolerance;
+    uint32_t    periodicity_interval;
+    uint32_t    kernel_flags;       // KernelOptions flags
+} TileJob;
+
+typedef struct {
+    uint32_t    magic;
+    uint32_t    id;
+    uint32_t    status;             // kTileStatus*
+    uint32_t    pixels;             // count that follows
+    double      elapsed;            // seconds the worker spent on the tile, setup included
+    KernelStats stats;              // of the tile, for the coordinator's frame totals
+} TileResult;
+
+int         listenTileSocket(const char *address);
+int         connectTileSocket(const char *address);
+void        closeTileSocket(int fd);
+
+bool        sendTileJob(int fd, const TileJob *job, const std::string &center_x, const std::string &center_y);
+bool        recvTileJob(int fd, TileJob *job, std::string *center_x, std::string *center_y);
+bool        sendTileResult(int fd, const TileResult *result, const unsigned *pixels);
+// pixels has room for capacity counts, more than that is a broken peer
+bool        recvTileResult(int fd, TileResult *result, unsigned *pixels, unsigned capacity);
+
+void        getWireCenter(std::string *dst, mpf_srcptr center);
+bool        setWireCenter(mpf_ptr dst, const std::string &src);
+
+#endif